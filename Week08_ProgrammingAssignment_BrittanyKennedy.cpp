@@ -17,13 +17,91 @@ Description:
 // ===================== INCLUDES =====================
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
 #include <iomanip>
 #include <fstream>
-#include <windows.h>   // Used to change console text color (Windows only)
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <new>
+#include <exception>
+#include <utility>
+#include <bit>          // bit_width for the sparse table levels
+#include <filesystem>
+#include <coroutine>    // Interactive sessions are coroutines (C++20)
+
+#ifndef _WIN32
+#include <fcntl.h>      // open() / mmap() for memory-mapped batch input
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <csignal>
+#include <sys/epoll.h>  // Event loop for server mode
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>   // Crash injection test for the journal, background snapshot writer
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>     // mallinfo2() measures idle multiplexed sessions in --bench
+#define TRACKER_HAS_MALLINFO 1
+#endif
+
+// SIMD headers for the columnar macro kernel (x86 only, scalar fallback elsewhere)
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>   // Console backend for consoleFrame and setConsoleColor()
+#include <io.h>        // _commit() for the journal
+#endif
 
 using namespace std;
 
 
+// ===================== BUILD OPTIONS =====================
+// Per-stage timers and counters. Build with TRACKER_INSTRUMENTATION=0 to
+//    compile every TRACK_STAGE / COUNT_EVENT out of the program.
+#ifndef TRACKER_INSTRUMENTATION
+#define TRACKER_INSTRUMENTATION 1
+#endif
+
+// Benchmark-only: replaces global operator new with one that counts calls,
+//    so --bench can report allocations/op and check the batch pipeline
+//    makes none. Off by default, since every allocation then pays for an
+//    atomic add.
+#ifndef TRACKER_COUNT_ALLOCATIONS
+#define TRACKER_COUNT_ALLOCATIONS 0
+#endif
+
+
 // ===================== CONSTANTS =====================
 const double PROTEIN_PERCENT = 0.30;
 const double CARB_PERCENT = 0.40;
@@ -34,6 +112,12 @@ const int CALORIES_PER_GRAM_CARBS = 4;
 const int CALORIES_PER_GRAM_FAT = 9;
 
 const int NUMBER_OF_DAYS = 7;
+const int DERIVED_VALUE_COUNT = NUMBER_OF_DAYS + 3;   // Sessions, history, macro targets, meal plan
+const char* const DAY_LABELS[NUMBER_OF_DAYS] = { "Day 1", "Day 2", "Day 3", "Day 4",
+    "Day 5", "Day 6", "Day 7" };
+
+const int ROLLING_WINDOW_COUNT = 3;
+const int ROLLING_WINDOWS[ROLLING_WINDOW_COUNT] = { 7, 30, 90 };   // Days tracked incrementally
 
 const double ACTIVITY_HIGH = 5.0;
 const double ACTIVITY_MEDIUM = 3.0;
@@ -46,13 +130,19 @@ const int CAL_LOW = 1800;
 const int MEALS_PER_DAY_HIGH = 6;
 const int MEALS_PER_DAY_MEDIUM = 4;
 const int MEALS_PER_DAY_LOW = 2;
+const int MAX_MEALS_PER_DAY = 12;   // Larger answers are asked again; the meal plan holds every meal of the week
 
 const int MEALS_PER_WEEK_HIGH = MEALS_PER_DAY_HIGH * NUMBER_OF_DAYS;
 const int MEALS_PER_WEEK_MEDIUM = MEALS_PER_DAY_MEDIUM * NUMBER_OF_DAYS;
 const int MEALS_PER_WEEK_LOW = MEALS_PER_DAY_LOW * NUMBER_OF_DAYS;
 
 const int CONSOLE_WIDTH = 75;
-const int INPUT_IGNORE_LIMIT = 1000;
+const int REPORT_LABEL_WIDTH = 50;   // Labels are padded with '.' to this width
+
+const double BENCH_MIN_SECONDS = 0.2;   // Each benchmark repeats until it has run this long
+
+const int LATENCY_BUCKET_COUNT = 40;   // Histogram bucket i holds latencies in [2^i, 2^(i+1)) ns
+const char METRICS_FILE[] = "perf_stats.txt";
 
 const int COLOR_DEFAULT = 15;  // White
 const int COLOR_HEADER = 3;   // Aqua
@@ -60,885 +150,10323 @@ const int COLOR_SUB_HEADING = 2;   // Green
 const int COLOR_RECIPE = 14;  // Yellow
 const int COLOR_ERROR = 12;  // Red
 
+const int BATCH_FIELD_COUNT = 6 + NUMBER_OF_DAYS;   // Profile fields + one calorie entry per day
+const size_t BATCH_BLOCK_BYTES = 256 * 1024;        // Input bytes per parallel task (one macro kernel call)
+const int BATCH_BLOCKS_PER_WORKER = 2;              // Blocks mapped ahead per worker before processing
+const size_t BATCH_MIN_ROW_BYTES = 2 * BATCH_FIELD_COUNT;   // One character and a delimiter per field
+const size_t REPORT_NAMES_MIN_SLOTS = 64;
+const size_t REPORT_NAMES_MAX_RESERVED = 1 << 20;   // Names reserved up front; a larger run grows by doubling
+const size_t REPORT_NAME_RESERVE_BYTES = 16;        // Typical report name length, for reserving text
+
+const char RECIPE_CATALOG_FILE[] = "recipes.csv";
+const int RECIPE_FIELD_COUNT = 7;   // name, protein source, protein, carbs, fat, ingredients, method
+const int RECIPE_MATCH_COUNT = 3;   // Recipes shown by the nutrition check
+
+const char ADVICE_RULES_FILE[] = "advice_rules.csv";
+const int ADVICE_RULE_FIELD_COUNT = 8;   // category, min/max hours, min/max calories, min/max meals per week, advice
+const uint16_t ADVICE_NONE = 0xFFFF;     // Advice ID when no rule in the category matches
+const size_t ADVICE_TABLE_MAX_CELLS = 1 << 22;   // Bucket combinations a compiled rule table may hold
+
+const int MEAL_PLAN_MAX_FOODS = 3;           // Catalog foods combined in one meal
+const int MEAL_PLAN_MAX_HALF_SERVINGS = 4;   // Portions from 1/2 to 2 servings
+const int MEAL_PLAN_VARIETY = 4;             // Best distinct meals kept per target, rotated through the week
+const int MEAL_PLAN_NEIGHBORS = 8;           // Nearest foods gathered per portion/share of the target
+const float MEAL_PLAN_TOLERANCE = 5.0f;      // Grams per macro for a meal to count as on target
+const size_t MEAL_PLAN_MEMO_LIMIT = 4096;    // Targets memoized; a new one past this replaces an old one
+const int MEAL_PLAN_MEMO_KEY_BITS = 21;      // Key bits per macro; larger targets are solved without the memo
+
+const int MACRO_CACHE_SHARDS = 16;           // Independently locked parts of the cache
+const size_t MACRO_CACHE_CAPACITY = 8192;    // Profiles kept across all shards
+const size_t MACRO_CACHE_TEXT_BYTES = 320;   // Room for the rendered target and advice columns
+
+const int SESSION_STORE_SHARD_BITS = 6;      // 64 independently locked shards of users
+const size_t PROTEIN_POOL_MAX_STRINGS = 4096;   // Distinct protein sources shared; later new ones are kept per user
+const size_t PROTEIN_POOL_MAX_LENGTH = 64;      // Longer protein text is kept per user, never pooled
+const int SESSION_STORE_SHARDS = 1 << SESSION_STORE_SHARD_BITS;
+const size_t KERNEL_CHECK_ROWS = 100003;      // Odd, so the SIMD kernels also run their scalar tail
+const size_t PIPELINE_BENCH_ROWS = 20000;    // More distinct profiles than the macro cache holds
+const size_t PIPELINE_BENCH_REJECT_EVERY = 50;   // The report-folder pass adds a malformed row after this many
+const size_t STORE_BENCH_USERS = 100000;     // Users resident during the session store stress test
+const int STORE_BENCH_WRITE_PERCENT = 10;    // Calorie appends; the rest render summaries
+
+const char SERVER_DEFAULT_SOCKET[] = "nutrition_tracker.sock";
+const char MENU_SERVER_DEFAULT_SOCKET[] = "nutrition_menus.sock";   // --serve-menus: one menu session per connection
+const size_t MULTIPLEX_BENCH_SESSIONS = 10000;       // Idle sessions parked at the menu by --bench
+const size_t SERVER_MAX_LINE = 4096;                 // Longest request line accepted
+const size_t SERVER_MAX_PENDING_OUTPUT = 1 << 20;    // Stop reading a connection until this much is sent
+const size_t SERVER_READ_BYTES = 64 * 1024;
+const int SERVER_MAX_EVENTS = 64;
+
+const char JOURNAL_FILE[] = "tracker_journal.bin";    // Interactive sessions' write-ahead log
+const char SERVER_JOURNAL_SUFFIX[] = ".journal";       // Server mode logs to <socket path>.journal
+const size_t JOURNAL_HEADER_BYTES = 8;                 // Payload length, then the payload's CRC-32
+const size_t JOURNAL_FIXED_BYTES = 23;                 // Payload before the name and protein text
+const char JOURNAL_MAGIC[] = "NTJRNL01";               // A compacted journal starts with this, then its base offset
+const size_t JOURNAL_BASE_HEADER_BYTES = 16;
+const size_t JOURNAL_BENCH_BURST = 64;                 // Records a bench writer appends per durable wait
+const int JOURNAL_CRASH_TRIALS = 200;                  // Torn tails and flipped bytes tried by --bench
+const int JOURNAL_CRASH_RECORDS = 2000;
+
+const char SERVER_SNAPSHOT_SUFFIX[] = ".snapshot";    // Server mode snapshots to <socket path>.snapshot
+const int SERVER_SNAPSHOT_SECONDS = 300;               // Snapshot interval while users are changing
+const char SNAPSHOT_MAGIC[] = "NTSNAP01";              // First 8 bytes of a snapshot file
+const size_t SNAPSHOT_HEADER_BYTES = 64;
+const size_t SNAPSHOT_RECORD_BYTES = 92;               // Fixed part of one user, ending in its CRC-32
+
+const int MENU_NEW_SESSION = 7;
+const int MENU_EXIT = 12;   // Always the last option
+
+const char LOADGEN_RESULTS_FILE[] = "loadgen_results.json";
+const int LOADGEN_MIN_MENU_CHOICES = 3;                // Menu choices per simulated session, before exiting
+const int LOADGEN_MAX_MENU_CHOICES = 12;
+// Menu choices drawn uniformly from this list, so views outnumber reports and edits
+const int LOADGEN_MENU_MIX[] = { 1, 1, 1, 2, 3, 3, 4, 4, 4, 5, 5, 6, 6, 8, 10, 10, 11 };
+
+const char REPLAY_TIMING_PREFIX[] = "Plan built in ";   // Line whose number changes run to run
+
 
 // ===================== ENUM =====================
 // Goal type for the lifter
-enum GoalType { FAT_LOSS, MAINTENANCE, MUSCLE_GAIN };
+enum GoalType : uint8_t { FAT_LOSS, MAINTENANCE, MUSCLE_GAIN };
+
+// Derived tracker state an edit can leave stale (bit flags)
+enum DerivedState : uint8_t { DERIVED_HISTORY = 1, DERIVED_MEAL_PLAN = 2 };
+
+
+// Instrumented stages of a session (timed with TRACK_STAGE)
+enum TrackerStage
+{
+    STAGE_USER_INPUT, STAGE_CALORIE_LOG_INPUT, STAGE_CALCULATE_MACROS, STAGE_FILL_SESSIONS,
+    STAGE_HISTORY_FILE, STAGE_REPORT_RENDER, STAGE_REPORT_FILE_IO,
+    STAGE_MENU_DAILY_MACROS, STAGE_MENU_REPORT, STAGE_MENU_NUTRITION_CHECK, STAGE_MENU_CALORIE_LOG,
+    STAGE_MENU_SESSIONS, STAGE_MENU_MACROS_2D, STAGE_MENU_RANGE_QUERY, STAGE_MENU_OTHER,
+    STAGE_MEAL_PLAN, STAGE_MENU_MEAL_PLAN, STAGE_MENU_EDIT_INPUT,
+    STAGE_COUNT
+};
+
+// Instrumented event counters (incremented with COUNT_EVENT)
+enum TrackerCounter
+{
+    COUNTER_STRING_RETRIES, COUNTER_INT_RETRIES, COUNTER_DOUBLE_RETRIES, COUNTER_GOAL_RETRIES,
+    COUNTER_CALORIE_RETRIES, COUNTER_MENU_RETRIES, COUNTER_REPORTS_WRITTEN, COUNTER_REPORT_BYTES,
+    COUNTER_FRAMES_PRESENTED, COUNTER_FRAME_WRITES, COUNTER_FRAME_BYTES,
+    COUNTER_DERIVED_RECOMPUTED, COUNTER_DERIVED_KEPT, COUNTER_JOURNAL_RECORDS, COUNTER_JOURNAL_SYNCS,
+    COUNTER_COUNT
+};
+
+// Kinds of change written to the journal
+enum JournalRecordType : uint8_t
+{
+    JOURNAL_PROFILE = 1,         // Name, protein, calorie target, meals/day, hours and goal
+    JOURNAL_LOG_DAY = 2,         // One day of the week's log, as first entered
+    JOURNAL_EDIT_DAY = 3,        // setDayCalories()
+    JOURNAL_MEALS_PER_DAY = 4,   // setMealsPerDay()
+    JOURNAL_APPEND = 5,          // appendDailyCalories()
+    JOURNAL_WEEK_SAVED = 6       // Console: the week reached <name>_sessions.bin
+};
 
 
 // ===================== STRUCT =====================
-// Represents a daily nutrition session, including calories and macro totals.
+// Represents a daily nutrition session. The macro targets are the same
+//    every day, so they stay in the tracker (dailyProteinGrams etc.).
 struct nutritionSession
 {
-    string date;           // Day label (e.g., "Day 1")
     int calories;          // Actual calories for that day
-    int protein;           // Daily protein grams (target)
-    int carbs;             // Daily carb grams (target)
-    int fats;              // Daily fat grams (target)
+    uint8_t day;           // Index into DAY_LABELS (e.g., "Day 1")
     bool metCalorieGoal;   // True if daily calories <= target
 };
 
+// Bytes one resident user costs, split by where they live
+struct trackerMemory
+{
+    size_t objectBytes = 0;     // sizeof(nutritionTracker)
+    size_t nameBytes = 0;       // Heap text of names too long for the inline buffer
+    size_t historyBytes = 0;    // calorieHistory days, rolling windows and range index
+    size_t mealPlanBytes = 0;
+    size_t users = 0;
 
-// ===================== UTILITY FUNCTION PROTOTYPES =====================
-void setConsoleColor(int color);
-void clearInputStream();
-void printSectionBreakLine();
-
+    size_t total() const { return objectBytes + nameBytes + historyBytes + mealPlanBytes; }
+};
 
-// ===================== CLASS DEFINITION =====================
-// Treating the class as the Owner of all the data and logic rather than main
-class nutritionTracker
+// Stores each distinct string once; interned views stay valid for the life
+//    of the program. Read-mostly, so lookups share the lock. Entries are
+//    never freed, so the pool stops growing at maxStrings strings, and text
+//    longer than maxLength is never added; callers keep such text themselves.
+class stringPool
 {
 public:
-    // Constructor
-    nutritionTracker();
-
-    // ***** Program Flow *****
-    void displayIntroBanner();
-    void collectUserInput();   // New function to gather all user input for 1 session & store it inside the class obj
-    void calculateMacros();
+    stringPool(size_t maxStrings, size_t maxLength);
 
-    // ***** Data Population *****
-    void fillDailyCaloriesArray();
-    void fillSessionsFromCalories();
-    void fillMacrosPerMeal2D();  // New function to fill 2D arrray added to program
+    // False (interned untouched) if text isn't pooled and the pool can't take it
+    bool tryIntern(string_view text, string_view& interned);
 
-    // ***** Menu & Display *****
-    void displayMenu() const;
-    void displayDailyMacros() const;
-    void generateReport() const;
-    void displayWeeklyCalorieLog() const;
-    void displayWeeklySessions() const;
-    void displayNutritionCheckAndRecipe() const;
-    void displayMacrosPerMeal2D() const;
+    size_t size() const;
+    size_t getBytes() const;   // Text plus per-string bookkeeping
+    long long getRefused() const { return refused.load(memory_order_relaxed); }
 
 private:
-    // ***** User Info *****
-    string name;
-    string favoriteProtein;
-    GoalType goal;
+    mutable shared_mutex lock;
+    deque<string> strings;   // deque never moves existing elements
+    unordered_set<string_view> index;
+    size_t stringLimit;
+    size_t lengthLimit;
+    atomic<long long> refused{ 0 };
+};
 
-    // ***** Core User Targets *****
-    int dailyCalories;
-    int weeklyCalories;
-    int mealsPerDay;
-    double weeklyWorkoutHours;
+stringPool& getProteinPool();   // Protein sources shared by every user
 
-    // ***** Daily Macro Targets *****
-    int dailyProteinGrams;
-    int dailyCarbGrams;
-    int dailyFatGrams;
+// Options for headless batch mode (filled from the command line)
+struct batchOptions
+{
+    string inputPath;
+    string outputPath;
+    string reportFile;        // All reports concatenated into one file (optional)
+    string reportDirectory;   // One <name>.txt report per user (optional)
+    string rulesPath;         // Advice rules to use instead of advice_rules.csv (optional)
+    int threadCount = 0;
+};
 
-    // ***** Weekly Macro Totals *****
-    int totalProteinGrams;
-    int totalCarbGrams;
-    int totalFatGrams;
+// Column-oriented (structure of arrays) profile storage so macro targets
+//    for a whole population can be recomputed in one pass
+struct profileColumns
+{
+    // ***** Inputs *****
+    vector<int> dailyCalories;
+    vector<int> mealsPerDay;
+    vector<double> weeklyWorkoutHours;
+    vector<int> goal;
+
+    // ***** Outputs from calculateMacrosColumns() *****
+    vector<int> dailyProteinGrams;
+    vector<int> dailyCarbGrams;
+    vector<int> dailyFatGrams;
+    vector<int> proteinPerMeal;
+    vector<int> carbsPerMeal;
+    vector<int> fatsPerMeal;
+
+    // ***** Outputs from adviceRules::classifyColumns() *****
+    vector<uint16_t> nutritionAdvice;   // Advice IDs
+    vector<uint16_t> mealAdvice;
+
+    void resize(size_t count);
+    size_t size() const { return dailyCalories.size(); }
+};
 
-    // ***** Per-Meal Targets *****
-    int proteinPerMeal;
-    int carbsPerMeal;
-    int fatsPerMeal;
+// One block of batch input (a parallel task): mapped bytes in, CSV rows out
+struct batchBlock
+{
+    // ***** Input (whole lines inside the mapped file) *****
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    uint64_t fileOffset = 0;   // Byte offset of begin, used in error messages
+
+    // ***** Parsed profiles *****
+    profileColumns columns;
+    vector<string_view> names;      // Point into the mapped file (no copies)
+    vector<string_view> proteins;
+    vector<int> caloriesLog;   // NUMBER_OF_DAYS entries per profile
+    size_t count = 0;
+
+    // ***** Output (merged in block order) *****
+    string output;
+    string reports;             // Concatenated reports when batchOptions::reportFile is set
+    string errors;
+    long long rejectedCount = 0;
+    long long reportFailures = 0;
+    double reportSeconds = 0.0;   // Time spent rendering and writing reports
+    vector<long long> adviceCounts;   // Profiles given each advice ID; the last entry counts ADVICE_NONE
+
+    void reserveRows(size_t rows);   // Grows (never shrinks) the per-profile arrays
+};
 
-    // ***** Data Structures *****
-    int dailyCaloriesLog[NUMBER_OF_DAYS];   // Weekly calorie log array (one entry per day)
-    nutritionSession weeklySessions[NUMBER_OF_DAYS];   // Struct array (one entry per day) to complement dailyCaloriesLog
-    int macrosPerMeal2D[3][NUMBER_OF_DAYS];   // New 2D Array display option
+// Range-query index over a calorie history: prefix sums answer range sum/mean
+//    and sparse tables answer range max/min, all in O(1). Appending a day adds
+//    one entry per sparse table level (O(log n)) instead of rebuilding.
+class calorieRangeIndex
+{
+public:
+    void clear();
+    void append(int calories);
+    // Patches the prefix sums after index and the blocks that contain it,
+    //    so changing one of the last few days costs O(log n)
+    void replaceDay(size_t index, int calories);
 
-    // ***** Private Helper Functions *****
-    string getValidatedStringInput(string requestInput);
-    int getValidatedIntInput(string requestInput);
-    double getValidatedDoubleInput(string requestInput);
-    GoalType getUserGoal();
-    double calculateAverageCalories() const;
-    double calculateAverageFromArray(const int values[], int size) const;
-    int findHighestCalories() const;
-    void evaluateMealFrequency(int mealsPerWeek) const;
-    void displaySmoothieRecipe() const;
-    void evaluateNutrition() const;
-};
+    size_t size() const { return prefixSums.empty() ? 0 : prefixSums.size() - 1; }
+    size_t getHeapBytes() const;
 
+    // Days are 0-based and inclusive; requires first <= last < size()
+    long long rangeSum(size_t first, size_t last) const;
+    double rangeMean(size_t first, size_t last) const;
+    int rangeMax(size_t first, size_t last) const;
+    int rangeMin(size_t first, size_t last) const;
 
-// ===================== MAIN =====================
-// Main function controlling program flow and user interaction
-int main()
+private:
+    vector<long long> prefixSums;   // prefixSums[i] = sum of days [0, i)
+    vector<vector<int>> maxTable;   // maxTable[k][i] = max of days [i, i + 2^k)
+    vector<vector<int>> minTable;   // minTable[k][i] = min of days [i, i + 2^k)
+
+    static int floorLog2(size_t value);
+};
+
+// Growable calorie history (any number of days) whose rolling 7/30/90-day
+//    sum, mean and max are updated on append, so reading them is O(1)
+class calorieHistory
 {
-    nutritionTracker tracker;
+public:
+    calorieHistory();
 
-    char startNewSession = 'n';
+    void clear();
+    void reserve(size_t dayCount) { days.reserve(dayCount); }
+    void append(int calories);
+    void replaceLastDays(const int calories[], int count);   // Patches only the days that changed
 
-    // Main session loop so user can restart with new inputs
-    do
-    {
-        tracker.displayIntroBanner();
+    size_t size() const { return days.size(); }
+    int day(size_t index) const { return days[index]; }
+    long long totalSum() const { return allDaysSum; }
+    const calorieRangeIndex& ranges() const { return rangeIndex; }   // Arbitrary day ranges
+    size_t getHeapBytes() const;
 
-        tracker.collectUserInput();
-        tracker.fillDailyCaloriesArray();
+    // Covers the last min(window, size()) days: O(1) for ROLLING_WINDOWS, which
+    //    are kept up to date, and from the range index for any other length
+    long long windowSum(int window) const;
+    double windowMean(int window) const;
+    int windowMax(int window) const;
 
-        tracker.calculateMacros();
+private:
+    // Running sum plus a monotonic queue of indexes whose values decrease
+    //    from front to back, so the front is always the window's max
+    struct rollingWindow
+    {
+        int length = 0;
+        uint32_t queueHead = 0;
+        uint32_t queueCount = 0;
+        long long sum = 0;
+        vector<uint32_t> maxQueue;   // Ring buffer of day indexes, grown on demand up to length
+    };
+
+    vector<int> days;
+    long long allDaysSum = 0;
+    rollingWindow windows[ROLLING_WINDOW_COUNT];
+    calorieRangeIndex rangeIndex;
+
+    const rollingWindow* findWindow(int window) const;   // nullptr if that length isn't tracked
+    size_t windowStart(int window) const;                 // First day of the last window days
+    void rebuildMaxQueue(rollingWindow& window);          // From the days now in the window
+};
 
-        tracker.fillSessionsFromCalories();
-        tracker.fillMacrosPerMeal2D();
+// Reusable text buffer that renders report lines with to_chars and
+//    precomputed padding instead of stream manipulators
+class reportBuffer
+{
+public:
+    void clear() { text.clear(); }
+    const string& str() const { return text; }
 
-        int menuChoice = 0;
+    void append(string_view value) { text.append(value.data(), value.size()); }
+    void appendInt(long long value);
+    void appendFixed2(double value);         // Same as fixed << setprecision(2)
+    void appendLeader(string_view label);    // Same as left << setw(50) << setfill('.')
+    void appendRule();                       // Line of CONSOLE_WIDTH '*' characters
 
-        // ------------------------ Menu Loop -----------------------------
-        // Displays the main menu and allows the user to explore all features
-        //    until they choose to exit or start a new session
-        do
-        {
-            tracker.displayMenu();
-            cin >> menuChoice;
-            cout << endl;
+private:
+    string text;
+};
 
-            // If menu input is invalid, clear the stream and continue
-            if (cin.fail())
-            {
-                clearInputStream();
-                setConsoleColor(COLOR_ERROR);
-                cout << "Invalid choice. Please enter a number from 1 to 8.\n\n";
-                setConsoleColor(COLOR_DEFAULT);
-                continue;   
-            }
+// Read-only memory mapping of a file, one window at a time so memory use
+//    stays flat no matter how large the file is
+class mappedFile
+{
+public:
+    mappedFile() = default;
+    ~mappedFile();
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
 
+    bool open(const string& path);
+    uint64_t size() const { return fileSize; }
 
-            switch (menuChoice)
-            {
-            case 1:
-                // Show suggested daily macros and per meal breakdown
-                tracker.displayDailyMacros();
-                break;
+    // Maps [offset, offset + length) and returns a pointer to offset.
+    //    The previous window is unmapped.
+    const char* map(uint64_t offset, size_t length);
 
-            case 2:
-                // Write a formatted report to report.txt
-                tracker.generateReport();
-                break;
+private:
+    uint64_t fileSize = 0;
+    char* view = nullptr;
+    size_t viewLength = 0;
+
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#else
+    int fileDescriptor = -1;
+#endif
+
+    void unmap();
+};
 
-            case 3:
-                // Check calorie intake vs activity and show smoothie recipe
-                tracker.displayNutritionCheckAndRecipe();
-                break;
+// One catalog entry; macros are grams per serving
+struct recipeEntry
+{
+    string name;
+    string proteinSource;
+    float protein;
+    float carbs;
+    float fat;
+    string ingredients;   // Separated by ';'
+    string method;
+};
 
-            case 4:
-                // View weekly calorie log (array)
-                tracker.displayWeeklyCalorieLog();
-                break;
+// Vegetarian recipe/food catalog indexed on (protein, carbs, fat). The whole
+//    catalog and each protein source get their own implicit k-d tree, so
+//    filtered and unfiltered nearest lookups both take O(log n) on average.
+class recipeCatalog
+{
+public:
+    bool load(const string& path);   // Appends every valid CSV row; false if the file can't be read
+    void add(const recipeEntry& recipe);
+    void build();                    // Rebuilds the trees; call after the last add()/load()
 
-            case 5:
-                // View weekly nutrition sessions (using struct array)
-                tracker.displayWeeklySessions();
-                break;
+    size_t size() const { return recipes.size(); }
+    const recipeEntry& operator[](size_t index) const { return recipes[index]; }
 
-            case 6:
-                // Display macros per meal as a grid
-                tracker.displayMacrosPerMeal2D();
-                break;
+    // Fills results with up to k (at most 4 * RECIPE_MATCH_COUNT) recipes
+    //    closest to the target macros, nearest first, and returns how many
+    //    were found. A protein source the catalog doesn't know searches the
+    //    whole catalog.
+    size_t findNearest(double protein, double carbs, double fat, string_view proteinSource,
+        size_t k, uint32_t results[]) const;
+    bool hasProteinSource(string_view proteinSource) const { return findSourceId(proteinSource) >= 0; }
 
-            case 7:
-                // Start a new session with fresh inputs
-                setConsoleColor(COLOR_SUB_HEADING);
-                cout << "Starting a new session...\n\n";
-                setConsoleColor(COLOR_DEFAULT);
-                break;
+private:
+    struct treeRange
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    vector<recipeEntry> recipes;
+    vector<float> points;          // protein, carbs, fat for each recipe
+    vector<uint32_t> sourceIds;    // Index into sourceNames for each recipe
+    vector<string> sourceNames;    // Lowercase, one per distinct protein source
+    vector<uint32_t> treeOrder;    // Every tree, each stored in its own range
+    treeRange allRecipes = { 0, 0 };
+    vector<treeRange> sourceTrees;
+
+    void buildTree(size_t begin, size_t end, int axis);
+    void searchTree(size_t begin, size_t end, int axis, const float target[], size_t k,
+        uint32_t results[], float distances[], size_t& found) const;
+    int findSourceId(string_view proteinSource) const;
+};
 
-            case 8:
-                // Exit the program
-                setConsoleColor(COLOR_SUB_HEADING);
-                cout << "Thanks for using the program! Keep lifting strong!\n";
-                printSectionBreakLine();
-                setConsoleColor(COLOR_DEFAULT);
-                break;
+const recipeCatalog& getRecipeCatalog();   // recipes.csv, or the built-in smoothie if it is missing
 
-            default:
-                setConsoleColor(COLOR_ERROR);
-                cout << "Invalid choice. Please select 18.\n\n";
-                setConsoleColor(COLOR_DEFAULT);
-                break;
-            }
 
-        } while (menuChoice != 7 && menuChoice != 8);
+// ===================== ADVICE RULES =====================
+enum AdviceCategory : uint8_t { ADVICE_NUTRITION, ADVICE_MEAL_FREQUENCY, ADVICE_CATEGORY_COUNT };
+enum AdviceAxis : uint8_t { AXIS_WORKOUT_HOURS, AXIS_DAILY_CALORIES, AXIS_MEALS_PER_WEEK, ADVICE_AXIS_COUNT };
 
-        // Clear leftover newline from menu input
-        clearInputStream();
+// One row of the decision table: the advice applies when every input is in
+//    [minimum, maximum). Within a category the first matching rule wins.
+struct adviceRule
+{
+    AdviceCategory category;
+    double minimum[ADVICE_AXIS_COUNT];   // -HUGE_VAL when unbounded
+    double maximum[ADVICE_AXIS_COUNT];   // HUGE_VAL when unbounded
+    string text;
+};
 
-        // Check if user decided to start a new session (6 = new session)
-        startNewSession = (menuChoice == 7) ? 'y' : 'n';
+// Nutrition and meal-frequency advice as a decision table instead of
+//    if/else chains. compile() cuts each input at every bound the rules use
+//    and stores the winning rule for every combination of buckets in one
+//    flat array. A value's bucket is the count of cuts at or below it, so
+//    classifying is a few compares added up and one load, with no branches
+//    that depend on the profile. Advice IDs are rule indexes.
+class adviceRules
+{
+public:
+    void loadDefaults();             // The rules the tracker has always given
+    // Replaces the rules with the file's. Reports each bad row as path:line on
+    //    cerr and returns false if any row is bad or the file is unreadable.
+    bool load(const string& path);
+    void add(const adviceRule& rule);
+    bool compile();                  // Call after the last add(); false if the table would be too large
 
-    } while (startNewSession == 'y');
+    uint16_t classify(AdviceCategory category, double workoutHours, int dailyCalories, int mealsPerWeek) const;
+    void classifyColumns(profileColumns& columns, size_t begin, size_t end) const;   // Fills both advice ID columns
 
-    cout << "\nProgram ended. Have a great day!\n";
+    size_t size() const { return rules.size(); }
+    const adviceRule& operator[](size_t adviceId) const { return rules[adviceId]; }
+    const char* getText(uint16_t adviceId) const { return (adviceId == ADVICE_NONE) ? "" : rules[adviceId].text.c_str(); }
+    const string& getSource() const { return source; }   // File the rules came from, or "built-in"
 
-    return 0;
-}
+private:
+    vector<adviceRule> rules;
+    string source;
+    vector<double> cuts[ADVICE_AXIS_COUNT];   // Sorted finite bounds per axis
+    size_t cellCount = 0;                     // Bucket combinations per category
+    vector<uint16_t> table;                   // [category][hours bucket][calories bucket][meals bucket]
 
+    size_t findCell(double workoutHours, double dailyCalories, double mealsPerWeek) const;
+};
 
-// ================================= FUNCTION DEFINITIONS ==============================================
+// advice_rules.csv, or the built-in rules if it is missing. Batch mode's
+//    --rules replaces them before any advice is read.
+adviceRules& getAdviceRules();
 
-// --------------------- Utility Functions ---------------------
-void setConsoleColor(int color)
+// One food in a meal: a catalog entry and how many half servings of it
+struct mealPortion
 {
-    // Handle is a Windows data type that references the console
-    // GetSTDHandle is a Windows function that retrieves the console/output device
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-
-    // SetConsoleTextAttribute is a Windows function to allow changing the text color in the console
-    SetConsoleTextAttribute(hConsole, color);
-}
+    uint32_t recipe;
+    uint8_t halfServings;
+};
 
-void clearInputStream()
+// A meal built from catalog foods, with its totals and distance from the target
+struct mealSolution
 {
-    cin.clear();
-    cin.ignore(INPUT_IGNORE_LIMIT, '\n');
-}
+    mealPortion portions[MEAL_PLAN_MAX_FOODS];
+    int portionCount = 0;
+    float protein = 0.0f;
+    float carbs = 0.0f;
+    float fat = 0.0f;
+    float error = 0.0f;   // Sum of |total - target| over the three macros, in grams
+};
 
-void printSectionBreakLine()
+
+// ===================== MACRO CACHE =====================
+// Macro targets and advice depend only on these four inputs
+struct macroCacheKey
 {
-    cout << setfill('*') << setw(CONSOLE_WIDTH) << '*' << "\n";
-    cout << setfill(' ');
-}
+    int dailyCalories;
+    int mealsPerDay;
+    uint64_t workoutHoursBits;   // Bit pattern of the double, so 3.0 and 3.00 match
+    int goal;
 
+    bool operator==(const macroCacheKey& other) const
+    {
+        return dailyCalories == other.dailyCalories && mealsPerDay == other.mealsPerDay &&
+            workoutHoursBits == other.workoutHoursBits && goal == other.goal;
+    }
+};
 
-// --------------------- Constructor ---------------------
-nutritionTracker::nutritionTracker()
+struct macroCacheKeyHash
 {
-    name = "";
-    favoriteProtein = "";
-    dailyCalories = 0;
-    weeklyCalories = 0;
-    mealsPerDay = 0;
-    weeklyWorkoutHours = 0.0;
+    size_t operator()(const macroCacheKey& key) const;
+};
 
-    dailyProteinGrams = 0;
-    dailyCarbGrams = 0;
-    dailyFatGrams = 0;
+// Everything calculateMacros() and the advice rules produce for one key.
+//    Fixed size, so copying one out of the cache never allocates.
+struct macroCacheEntry
+{
+    int dailyProteinGrams;
+    int dailyCarbGrams;
+    int dailyFatGrams;
+    int proteinPerMeal;
+    int carbsPerMeal;
+    int fatsPerMeal;
+    const char* nutritionAdvice;
+    const char* goalAdvice;
+    const char* mealFrequencyAdvice;
+    size_t resultLength;
+    char resultColumns[MACRO_CACHE_TEXT_BYTES];   // Target and advice columns of a batch result row
+};
 
-    totalProteinGrams = 0;
-    totalCarbGrams = 0;
-    totalFatGrams = 0;
+// Bounded, thread-safe cache of macroCacheEntry. Keys hash to one of
+//    MACRO_CACHE_SHARDS shards, each with its own reader/writer lock and
+//    counters. Replacement is CLOCK: a hit only sets its slot's referenced
+//    bit under the shared lock, so lookups never wait for each other. An
+//    insert into a full shard sweeps the clock hand, clearing bits, and
+//    reuses the first slot that wasn't referenced since the last sweep.
+class macroCache
+{
+public:
+    explicit macroCache(size_t capacity = MACRO_CACHE_CAPACITY);
 
-    proteinPerMeal = 0;
-    carbsPerMeal = 0;
-    fatsPerMeal = 0;
+    bool find(const macroCacheKey& key, macroCacheEntry& entry);   // Copies the entry out on a hit
+    void insert(const macroCacheKey& key, const macroCacheEntry& entry);
 
-    goal = MAINTENANCE;
+    long long getHits() const;
+    long long getMisses() const;
+    long long getEvictions() const;
 
-    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+private:
+    struct cacheSlot
     {
-        dailyCaloriesLog[i] = 0;
-    }
+        macroCacheKey key;
+        macroCacheEntry entry;
+    };
 
-    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    struct cacheShard
     {
-        weeklySessions[i].date = "";
-        weeklySessions[i].calories = 0;
-        weeklySessions[i].protein = 0;
-        weeklySessions[i].carbs = 0;
-        weeklySessions[i].fats = 0;
-        weeklySessions[i].metCalorieGoal = false;
-    }
+        mutable shared_mutex lock;
+        vector<cacheSlot> slots;   // Grows to slotLimit, then slots are reused
+        unique_ptr<atomic<bool>[]> referenced;   // One CLOCK bit per slot, set by hits
+        unordered_map<macroCacheKey, uint32_t, macroCacheKeyHash> index;
+        uint32_t hand = 0;         // Next slot the clock looks at
+        atomic<long long> hits{ 0 };
+        atomic<long long> misses{ 0 };
+        long long evictions = 0;   // Changed under the exclusive lock only
+    };
+
+    size_t slotLimit;   // Per shard
+    unique_ptr<cacheShard[]> shards;
+
+    cacheShard& getShard(const macroCacheKey& key);
+};
 
-    for (int row = 0; row < 3; row++)
-    {
-        for (int col = 0; col < NUMBER_OF_DAYS; col++)
-        {
-            macrosPerMeal2D[row][col] = 0;
-        }
-    }
-}
+macroCache& getMacroCache();   // Shared by batch mode and server mode
+macroCacheKey makeMacroCacheKey(int dailyCalories, int mealsPerDay, double workoutHours, int goal);
 
 
-// --------------------- Input ---------------------
-void nutritionTracker::collectUserInput()
+// ===================== INSTRUMENTATION =====================
+// Totals, max and a log2 latency histogram per stage, plus event counters.
+//    Relaxed atomics so recording is cheap and safe from any thread.
+struct stageMetrics
 {
-    name = getValidatedStringInput("What is your name? ");
-    cout << "Hi " << name << "!\n\n";
-
-    favoriteProtein = getValidatedStringInput("What is your favorite vegetarian protein source? ");
-    dailyCalories = getValidatedIntInput("How many calories are you targeting each day? ");
-    mealsPerDay = getValidatedIntInput("How many meals do you eat per day? ");
-    weeklyWorkoutHours = getValidatedDoubleInput("How many hours per week do you weightlift? ");
-    goal = getUserGoal();
-}
+    atomic<long long> calls;
+    atomic<long long> totalNs;
+    atomic<long long> maxNs;
+    atomic<long long> buckets[LATENCY_BUCKET_COUNT];
+};
 
-string nutritionTracker::getValidatedStringInput(string requestInput)
+struct trackerMetrics
 {
-    string value;
+    stageMetrics stages[STAGE_COUNT];
+    atomic<long long> counters[COUNTER_COUNT];
 
-    cout << requestInput;
-    getline(cin, value);
-    cout << endl;
+    void recordStage(TrackerStage stage, long long elapsedNs);
+    void printStats(ostream& out, bool includeHistograms) const;
+};
 
-    // Repeat until the user enters a non-empty string
-    while (value.length() == 0)
-    {
-        setConsoleColor(COLOR_ERROR);
-        cout << "That is not a valid answer. Please try again: ";
-        setConsoleColor(COLOR_DEFAULT);
+extern trackerMetrics metrics;   // Zero-initialized global
+
+// Times the enclosing scope and records it under one stage
+class scopedStageTimer
+{
+public:
+    explicit scopedStageTimer(TrackerStage timedStage)
+        : stage(timedStage), startTime(chrono::steady_clock::now()) {}
 
-        getline(cin, value);
-        cout << endl;
+    ~scopedStageTimer()
+    {
+        metrics.recordStage(stage, chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - startTime).count());
     }
 
-    return value;
-}
+private:
+    TrackerStage stage;
+    chrono::steady_clock::time_point startTime;
+};
 
-int nutritionTracker::getValidatedIntInput(string requestInput)
+// Every timed operation of simulated sessions (--loadgen), by stage.
+//    Kept apart from metrics so percentiles are exact, and in any build.
+struct sessionLatencies
 {
-    int value;
+    vector<long long> samples[STAGE_COUNT];   // Nanoseconds
+};
 
-    cout << requestInput;
-    cin >> value;
-    cout << endl;
+// Adds the enclosing scope's time to latencies, if there are any
+class scopedLatencySample
+{
+public:
+    scopedLatencySample(sessionLatencies* sampleLatencies, TrackerStage timedStage)
+        : latencies(sampleLatencies), stage(timedStage)
+    {
+        if (latencies != nullptr)
+            startTime = chrono::steady_clock::now();
+    }
 
-    // Loop continues until the user enters a valid positive integer
-    while (cin.fail() || value <= 0)
+    ~scopedLatencySample()
+    {
+        if (latencies != nullptr)
+        {
+            latencies->samples[stage].push_back(chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - startTime).count());
+        }
+    }
+
+private:
+    sessionLatencies* latencies;
+    TrackerStage stage;
+    chrono::steady_clock::time_point startTime;
+};
+
+const char* getStageName(TrackerStage stage);
+const char* getCounterName(TrackerCounter counter);
+TrackerStage getMenuStage(int menuChoice);
+
+#if TRACKER_INSTRUMENTATION
+#define TRACK_STAGE_JOIN(name, line) name##line
+#define TRACK_STAGE_NAME(line) TRACK_STAGE_JOIN(stageTimer, line)
+#define TRACK_STAGE(stage) scopedStageTimer TRACK_STAGE_NAME(__LINE__)(stage)
+#define COUNT_EVENT(counter, amount) metrics.counters[counter].fetch_add((amount), memory_order_relaxed)
+#else
+#define TRACK_STAGE(stage) ((void)0)
+#define COUNT_EVENT(counter, amount) ((void)0)
+#endif
+
+
+// ===================== SESSION FILE FORMAT =====================
+// Binary session history (little-endian, version 1):
+//    header: "NUTRSESS" | uint32 version | uint32 record size | uint64 record count
+//    record: uint32 day number | uint32 calories | uint16 protein | uint16 carbs |
+//            uint16 fats (bits 0-14) + met-calorie-goal flag (bit 15)
+const char SESSION_FILE_MAGIC[8] = { 'N', 'U', 'T', 'R', 'S', 'E', 'S', 'S' };
+const uint32_t SESSION_FILE_VERSION = 1;
+const size_t SESSION_HEADER_SIZE = 24;
+const size_t SESSION_RECORD_SIZE = 14;
+const uint16_t SESSION_GOAL_FLAG = 0x8000;
+
+// One decoded record; plain integers only, so reading one never allocates
+struct sessionRecord
+{
+    uint32_t dayNumber;   // 1 = "Day 1"
+    uint32_t calories;
+    uint16_t protein;
+    uint16_t carbs;
+    uint16_t fats;
+    bool metCalorieGoal;
+};
+
+// Read-only view of a session file mapped into memory; records are decoded
+//    on demand straight from the mapping
+class sessionFileView
+{
+public:
+    bool open(const string& path);
+    size_t size() const { return recordCount; }
+    sessionRecord operator[](size_t index) const;
+
+private:
+    mappedFile file;
+    const char* records = nullptr;
+    size_t recordCount = 0;
+};
+
+bool encodeSessionRecord(const sessionRecord& record, char bytes[]);
+void writeLittleEndian(char bytes[], uint64_t value, int byteCount);
+uint64_t readLittleEndian(const char bytes[], int byteCount);
+bool appendSessionRecords(const string& path, const sessionRecord records[], size_t count);
+bool seekFileOffset(FILE* file, uint64_t offset);   // fseek without the 2 GB long limit
+
+
+// ===================== CONSOLE FRAME =====================
+// How finished frames reach the screen, picked once per run
+enum ConsoleMode
+{
+    CONSOLE_PLAIN,        // Redirected to a file or pipe: text only
+    CONSOLE_ANSI,         // Terminal that understands ANSI color escapes
+    CONSOLE_ATTRIBUTES    // Older Windows console: SetConsoleTextAttribute between segments
+};
+
+// One screen of output. Text and color changes are collected in memory and
+//    written with a single write when the frame is presented or destroyed.
+class consoleFrame : public ostringstream
+{
+public:
+    ~consoleFrame() { present(); }
+
+    void setColor(int color);   // Applies from the current end of the frame
+    void present();
+
+private:
+    struct colorChange
+    {
+        size_t offset;
+        int color;
+    };
+
+    vector<colorChange> colorChanges;
+};
+
+ConsoleMode getConsoleMode();
+void appendAnsiColor(string& text, int color);
+long long writeConsole(const char* text, size_t length);   // Returns the number of write calls
+bool isConsoleCaptured();   // cout redirected away from the console (replay mode)
+
+
+// ===================== SESSION COROUTINES =====================
+// The interactive flow is written as C++20 coroutines. Every prompt
+//    co_awaits its answer from a sessionInput; when the answer hasn't been
+//    typed yet, the whole session (the chain of coroutines awaiting each
+//    other) suspends until more input is fed to it. The console runs one
+//    session and feeds it lines from cin; --serve-menus runs one per
+//    connection on a single thread.
+atomic<long long> sessionFrameBytes(0);   // Bytes of coroutine frames alive right now
+
+// A coroutine of the interactive flow. It starts when awaited (or start()ed)
+//    and resumes whoever awaited it when it finishes.
+class sessionTask
+{
+public:
+    struct promise_type;
+
+    struct finalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        coroutine_handle<> await_suspend(coroutine_handle<promise_type> finished) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type
+    {
+        coroutine_handle<> continuation;   // The coroutine awaiting this one, if any
+        exception_ptr failure;
+
+        sessionTask get_return_object();
+        suspend_always initial_suspend() const noexcept { return {}; }
+        finalAwaiter final_suspend() const noexcept { return {}; }
+        void return_void() const {}
+        void unhandled_exception() { failure = current_exception(); }
+
+        // Frames are counted so --bench can report what an idle session holds
+        static void* operator new(size_t size);
+        static void operator delete(void* frame, size_t size);
+    };
+
+    sessionTask() = default;
+    explicit sessionTask(coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+    sessionTask(sessionTask&& other) noexcept;
+    sessionTask& operator=(sessionTask&& other) noexcept;
+    sessionTask(const sessionTask&) = delete;
+    sessionTask& operator=(const sessionTask&) = delete;
+    ~sessionTask();   // Destroys the coroutine, and any it is awaiting, even mid-prompt
+
+    // co_await runs the task; the awaiting coroutine continues when it finishes
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept;
+    void await_resume() const { checkFailure(); }
+
+    void start();               // Runs a top-level session until it first waits for input
+    bool done() const;
+    void checkFailure() const;  // Rethrows an exception that ended the coroutine
+
+private:
+    coroutine_handle<promise_type> handle;
+};
+
+enum InputReadKind : uint8_t { INPUT_LINE, INPUT_INT, INPUT_DOUBLE, INPUT_SKIP_LINE };
+
+class sessionInput;
+
+// What co_await input.readInt(value) and the other reads wait on: ready at
+//    once if enough has been typed, otherwise the session waits in the input
+struct inputRead
+{
+    sessionInput& input;
+    InputReadKind kind;
+    void* target;   // string*, int* or double*, by kind
+
+    bool await_ready() const;
+    void await_suspend(coroutine_handle<> session);
+    bool await_resume();   // The read's result
+};
+
+// Typed answers for one session. Each read behaves like the cin call beside
+//    it, so the prompts validate a replayed transcript or a socket exactly
+//    the way they validate typing. Numbers are parsed in place with from_chars.
+class sessionInput
+{
+public:
+    sessionInput() = default;
+    explicit sessionInput(string_view script);   // Everything typed up front, then the end of input
+
+    void feed(string_view typed);   // More keystrokes (whole or partial lines)
+    void finish();                   // No more input will arrive: waiting reads fail
+    void resume();                   // Continues the waiting session if its read can now finish
+    bool isWaiting() const { return static_cast<bool>(waiting); }
+    size_t getCapacity() const { return buffer.capacity(); }
+    size_t getUnreadBytes() const { return buffer.size() - position; }   // Typed but not yet read
+
+    inputRead readLine(string& line) { return { *this, INPUT_LINE, &line }; }     // getline(cin, line)
+    inputRead readInt(int& value) { return { *this, INPUT_INT, &value }; }        // cin >> value; false if it failed
+    inputRead readDouble(double& value) { return { *this, INPUT_DOUBLE, &value }; }   // cin >> value; false if it failed
+    inputRead skipLine() { return { *this, INPUT_SKIP_LINE, nullptr }; }          // cin.clear(), then skip the line
+    bool atEnd() const { return finished && position >= buffer.size(); }         // Nothing left, nothing coming
+
+private:
+    friend struct inputRead;
+
+    string buffer;
+    size_t position = 0;
+    bool failed = false;     // Like cin's failbit: reads fail until skipLine()
+    bool finished = false;
+    coroutine_handle<> waiting;
+    InputReadKind waitingKind = INPUT_LINE;
+
+    bool canRead(InputReadKind kind) const;   // True once the read can't need more input
+    bool parseLine(string& line);
+    bool parseInt(int& value);
+    bool parseDouble(double& value);
+    void discardLine();
+    void skipSpaces();
+};
+
+
+// Thrown by a prompt when input ends before a valid answer, so no caller
+//    goes on with a value the prompt never accepted
+class sessionInputEnded : public exception
+{
+public:
+    const char* what() const noexcept override { return "input ended before a valid answer"; }
+};
+
+
+// ===================== UTILITY FUNCTION PROTOTYPES =====================
+void setConsoleColor(int color);
+void printSectionBreakLine(ostream& out = cout);
+void appendSafeFileName(string& path, string_view name);   // Keeps letters, digits and '-'
+
+
+// ===================== BATCH MODE PROTOTYPES =====================
+struct batchWorker;
+
+// Headless mode: reads profiles from a CSV/TSV file and writes results without prompting
+int runBatchMode(const batchOptions& options);
+bool parseBatchInt(string_view field, int& value);
+string_view skipBatchPlusSign(string_view field);   // "+5" parses as 5, "+-5" still fails
+bool parseBatchDouble(string_view field, double& value);
+void appendBatchText(string& output, string_view text);
+string_view trimBatchField(string_view field);
+const void* memrchr_portable(const void* data, int value, size_t length);
+bool parseBatchLine(string_view line, uint64_t byteOffset, batchBlock& block);
+bool isBatchHeader(string_view line);   // A "name" column and no calorie number: column titles, not a profile
+const char* parseBatchFields(string_view line, batchBlock& block);   // Returns the problem, or nullptr
+
+// Report file names already written by this batch run. A name that another
+//    profile's name sanitizes to (or a repeated name) gets _2, _3, ... so no
+//    report overwrites another. Compared without case, as Windows does.
+//    The names are kept back to back in one string with an open-addressing
+//    table over them, so a claim only allocates when the table grows.
+class reportFileNames
+{
+public:
+    void reserve(size_t names);   // Room for this many names before the table grows
+    void clear();                 // Forgets every name but keeps the memory
+    // Adds a suffix to path[nameStart..] if it is taken. name is the caller's
+    //    scratch buffer for the lowercase name and its suffixed candidates.
+    void claim(string& path, size_t nameStart, string& name);
+    long long getRenamed() const;
+
+private:
+    struct nameSlot
+    {
+        size_t offset = 0;     // Into text
+        uint32_t length = 0;
+        int lastSuffix = 0;    // Highest suffix given to this name
+        bool used = false;
+    };
+
+    mutable mutex lock;
+    string text;               // Lowercase names in use, back to back
+    vector<nameSlot> slots;    // Power of two, at most half full
+    size_t count = 0;
+    long long renamed = 0;
+
+    size_t find(string_view name) const;   // The name's slot, or the empty slot it would go in
+    void insert(size_t slot, string_view name);
+    void grow(size_t slotCount);
+};
+
+// reportNames is required with batchOptions::reportDirectory
+size_t processBatchBlock(batchBlock& block, batchWorker& worker, const batchOptions& options,
+    reportFileNames* reportNames = nullptr);
+bool writeReportFile(const string& path, const string& text);
+
+// Same formulas as nutritionTracker::calculateMacros() for rows [begin, end);
+//    mealsPerDay must be positive (batch validation guarantees it)
+void calculateMacrosColumns(profileColumns& columns, size_t begin, size_t end);
+void calculateMacrosColumnsScalar(profileColumns& columns, size_t begin, size_t end);
+
+
+// ===================== CLASS DEFINITION =====================
+struct benchmarkResult;   // Benchmark helpers below are friends of the class
+class sessionStore;
+class sessionNameClaims;
+struct journalEntry;
+
+// Treating the class as the Owner of all the data and logic rather than main
+class nutritionTracker
+{
+public:
+    // Constructor
+    nutritionTracker();
+
+    // ***** Program Flow *****
+    void displayIntroBanner();
+    sessionTask collectUserInput(sessionInput& input, sessionNameClaims& claims);   // New function to gather all user input for 1 session & store it inside the class obj
+    void calculateMacros();
+
+    // ***** Data Population *****
+    sessionTask fillDailyCaloriesArray(sessionInput& input);
+    void fillSessionsFromCalories();
+    void fillMacrosPerMeal2D(int grid[3][NUMBER_OF_DAYS]) const;  // New function to fill 2D arrray added to program
+    void planWeeklyMeals();      // Builds mealPlan, whose foods then fill the 2D array
+
+    // ***** Session History File *****
+    void restoreSessionHistory();   // Loads <name>_sessions.bin into the history
+    bool saveWeeklySessions() const;   // Appends this week's sessions to <name>_sessions.bin; false after an error
+
+    // ***** Menu & Display *****
+    void displayMenu() const;
+    void displayDailyMacros() const;
+    void generateReport(bool writeFile = true) const;   // false: show the report instead of writing report.txt
+    void renderReport(reportBuffer& report) const;   // Text of report.txt, no file I/O
+    void displayWeeklyCalorieLog() const;
+    void displayWeeklySessions() const;
+    void displayNutritionCheckAndRecipe() const;
+    void displayMacrosPerMeal2D() const;
+    sessionTask displayCalorieRangeQuery(sessionInput& input);   // Prompts for a day range, then shows its stats
+    void displayPerformanceStats(bool writeFile = true) const;   // Shows stage timings and writes perf_stats.txt
+    void displayMealPlan() const;
+    sessionTask editWeeklyInput(sessionInput& input);   // Changes one day's calories or meals per day without restarting
+
+    // ***** Incremental Edits *****
+    // Mark only the derived state that depends on the edited input
+    void setDayCalories(int day, int calories);
+    void setMealsPerDay(int meals);
+
+    // ***** Batch Processing *****
+    // Same data the prompts collect, supplied directly (values already validated)
+    void loadProfile(string_view userName, string_view protein, int calories,
+        int meals, double hours, GoalType userGoal);
+    void loadDailyCalories(const int calories[]);
+    void loadMacroTargets(const profileColumns& columns, size_t index);   // Replaces calculateMacros()
+    void loadMacroTargets(const macroCacheEntry& cached);
+    // False if the rendered text doesn't fit. scratch is reused between calls.
+    bool fillMacroCacheEntry(macroCacheEntry& entry, string& scratch) const;
+    void appendBatchResult(string& output) const;   // Adds one CSV result row
+    void appendBatchResult(string& output, const macroCacheEntry& cached) const;   // Same row, cached targets and advice
+    const string& getName() const { return name; }
+
+    // ***** Server Mode *****
+    void appendDailyCalories(int calories);   // Logs one more day to the history
+
+    // ***** Journal *****
+    // Writes this change to getJournal(); returns the sequence number to wait
+    //    for, or 0 when no journal is open
+    uint64_t appendToJournal(JournalRecordType type, int day = 0, int calories = 0) const;
+    void waitForJournal(uint64_t sequence) const;   // Warns if the change didn't reach the journal
+    void applyJournalEntry(const journalEntry& entry);   // Recovery: repeats one recorded change
+
+    // ***** Snapshot *****
+    // Adds this user's fixed record, history and text to a snapshot being built
+    void appendSnapshotRecord(string& records, string& historyValues, string& text) const;
+    // Loads a record whose offsets trackerSnapshot has checked; nothing is recomputed
+    void loadSnapshotRecord(const char record[], const char historyValues[], const char text[]);
+    const calorieHistory& getHistory() const;   // Rebuilt first if an edit left it stale
+    void addMemoryUsage(trackerMemory& memory) const;
+
+    // Rebuilds whatever edits left stale. sessionStore calls it while it holds
+    //    the tracker exclusively, so readers sharing the lock never write.
+    void refreshDerivedState();
+
+private:
+    // ***** User Info *****
+    string name;
+    string_view favoriteProtein;   // Interned in getProteinPool(), or points into unpooledProtein
+    unique_ptr<string> unpooledProtein;   // Only for protein text the pool refused
+
+    void setFavoriteProtein(string_view protein);
+
+    // ***** Core User Targets *****
+    double weeklyWorkoutHours;
+    int dailyCalories;
+    int weeklyCalories;
+    int mealsPerDay;
+    GoalType goal;
+
+    // Advice IDs loadMacroTargets() copied from a classified block
+    uint16_t nutritionAdviceId = ADVICE_NONE;
+    uint16_t mealAdviceId = ADVICE_NONE;
+    bool adviceLoaded = false;   // Cleared by loadProfile()
+
+    // ***** Daily Macro Targets *****
+    // Weekly totals and per-meal targets are derived from these on demand
+    int dailyProteinGrams;
+    int dailyCarbGrams;
+    int dailyFatGrams;
+
+    // ***** Data Structures *****
+    // Derived state and what it depends on. Edits mark it stale and the next
+    //    read (getSession, getHistory, getMealPlan) rebuilds it, so it is mutable.
+    //    Only the session that owns the tracker reads it stale; a stored
+    //    tracker is refreshed first (refreshDerivedState).
+    //      weeklySessions[day]   dailyCaloriesLog[day], dailyCalories
+    //      history               dailyCaloriesLog (this week's days)
+    //      mealPlan              per-meal targets (dailyCalories, mealsPerDay)
+    //    Per-meal targets, weekly totals, the 2D grid and advice are computed on every read.
+    int dailyCaloriesLog[NUMBER_OF_DAYS];   // Weekly calorie log array (one entry per day)
+    mutable nutritionSession weeklySessions[NUMBER_OF_DAYS];   // Struct array (one entry per day) to complement dailyCaloriesLog
+    uint32_t restoredDays;    // Days of history loaded from the session file
+    int resumedDays;          // Days of dailyCaloriesLog taken from an unfinished session
+    mutable float mealPlanMilliseconds;
+    mutable uint8_t staleSessionDays;   // Bit per day
+    mutable uint8_t staleDerived;       // DerivedState flags
+    bool edited;                        // Reads count the recomputes they skip once an edit has been made
+    mutable calorieHistory history;   // Every day logged by this user, with rolling stats
+    mutable vector<mealSolution> mealPlan;   // mealsPerDay meals per day, day by day
+
+    // ***** Derived Targets *****
+    int getWeeklyProteinGrams() const { return dailyProteinGrams * NUMBER_OF_DAYS; }
+    int getWeeklyCarbGrams() const { return dailyCarbGrams * NUMBER_OF_DAYS; }
+    int getWeeklyFatGrams() const { return dailyFatGrams * NUMBER_OF_DAYS; }
+    int getProteinPerMeal() const { return (mealsPerDay > 0) ? dailyProteinGrams / mealsPerDay : 0; }
+    int getCarbsPerMeal() const { return (mealsPerDay > 0) ? dailyCarbGrams / mealsPerDay : 0; }
+    int getFatsPerMeal() const { return (mealsPerDay > 0) ? dailyFatGrams / mealsPerDay : 0; }
+
+    // ***** Private Helper Functions *****
+    const nutritionSession& getSession(int day) const;
+    const vector<mealSolution>& getMealPlan() const;
+    void buildMealPlan() const;
+    int countStaleValues() const;
+    // Prompts until the answer is valid and stores it in value; throws
+    //    sessionInputEnded if input ends first
+    sessionTask getValidatedStringInput(sessionInput& input, string requestInput, string& value);
+    sessionTask getValidatedIntInput(sessionInput& input, string requestInput, int& value);
+    sessionTask getCaloriesInput(sessionInput& input, string requestInput, int& value);   // 0 or more, as the weekly log takes
+    sessionTask getValidatedDoubleInput(sessionInput& input, string requestInput, double& value);
+    sessionTask getMealsPerDayInput(sessionInput& input, int& meals);   // 1 to MAX_MEALS_PER_DAY
+    sessionTask getUserGoal(sessionInput& input, GoalType& chosenGoal);
+    void calculateWeeklyCalories();
+    string getSessionFilePath() const;
+    double calculateAverageCalories() const;
+    double calculateAverageFromArray(const int values[], int size) const;
+    int findHighestCalories() const;
+    void evaluateMealFrequency(consoleFrame& frame, int mealsPerWeek) const;
+    void displayRecipeMatches(consoleFrame& frame) const;   // Catalog recipes nearest the per-meal targets
+    void evaluateNutrition(consoleFrame& frame) const;
+    const char* getNutritionAdvice() const;
+    const char* getGoalAdvice() const;
+    const char* getMealFrequencyAdvice(int mealsPerWeek) const;
+    void appendBatchProfileColumns(string& output) const;
+    void appendBatchTargetColumns(string& output) const;
+    const char* getBatchAdvice(AdviceCategory category) const;   // Loaded advice ID's text, or classifies
+
+    // Benchmarks time the private helpers directly
+    friend int runBenchmarks(const string& resultsPath);
+    friend benchmarkResult runSessionStoreStress(sessionStore& users, const vector<string>& userNames, int threadCount);
+};
+
+
+// ===================== WORK-STEALING POOL =====================
+// Each worker runs tasks from the front of its own queue and steals from the
+//    back of another worker's queue once its own queue is empty
+class workStealingPool
+{
+public:
+    explicit workStealingPool(int workerCount);
+    ~workStealingPool();
+
+    // Runs work(task, worker) for every task in [0, taskCount) and waits until all finish.
+    //    work returns how many items it processed (used for throughput stats).
+    void run(size_t taskCount, const function<size_t(size_t, int)>& work);
+
+    // Same as run(), but returns false right away if another job has the pool
+    bool tryRun(size_t taskCount, const function<size_t(size_t, int)>& work);
+
+    int size() const { return static_cast<int>(workers.size()); }
+    void printWorkerStats(ostream& out) const;
+
+private:
+    struct workerQueue
+    {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+
+    struct workerStats
+    {
+        long long tasksRun = 0;
+        long long tasksStolen = 0;
+        long long itemsProcessed = 0;
+        double busySeconds = 0.0;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<workerQueue>> queues;
+    vector<workerStats> stats;
+
+    mutex jobLock;   // Held for a whole job: the pool runs one at a time
+    mutex stateLock;
+    condition_variable wakeWorkers;
+    condition_variable jobFinished;
+    const function<size_t(size_t, int)>* currentWork = nullptr;
+    long long generation = 0;
+    int activeWorkers = 0;
+    bool stopping = false;
+
+    void runJob(size_t taskCount, const function<size_t(size_t, int)>& work);
+    void workerLoop(int worker);
+    bool takeTask(int worker, size_t& task, bool& stolen);
+};
+
+workStealingPool& getSharedPool();   // One worker per core, shared by the meal planner and batch mode
+
+
+// ===================== MEAL PLANNER =====================
+// Picks up to MEAL_PLAN_MAX_FOODS catalog foods and portions whose totals
+//    come closest to a per-meal target. Candidates come from k-d tree lookups,
+//    then a branch-and-bound search runs one top-level branch per task on the
+//    shared pool. Solutions are memoized by target, so days and users with
+//    the same targets share them.
+class mealPlanner
+{
+public:
+    explicit mealPlanner(const recipeCatalog& foods);
+
+    // Up to MEAL_PLAN_VARIETY meals with different food sets, best first
+    vector<mealSolution> solveMeal(int protein, int carbs, int fat);
+
+    long long getMemoHits() const { return memoHits.load(memory_order_relaxed); }
+    long long getMemoMisses() const { return memoMisses.load(memory_order_relaxed); }
+
+private:
+    // Best meals found so far for one target, shared by every search task
+    struct mealSearch
+    {
+        float target[3];
+        vector<mealPortion> candidates;
+        vector<float> candidateMacros;   // protein, carbs, fat per candidate
+        mutex bestLock;
+        vector<mealSolution> best;       // Sorted, at most MEAL_PLAN_VARIETY
+        atomic<float> cutoff;            // Error of the worst kept meal once best is full
+    };
+
+    const recipeCatalog& catalog;
+    mutex memoLock;
+    unordered_map<uint64_t, vector<mealSolution>> memo;   // At most MEAL_PLAN_MEMO_LIMIT targets
+    atomic<long long> memoHits{ 0 };
+    atomic<long long> memoMisses{ 0 };
+
+    void gatherCandidates(mealSearch& search) const;
+    size_t searchBranch(mealSearch& search, size_t next, int depth, const float totals[],
+        mealPortion portions[]) const;
+    void offerSolution(mealSearch& search, const float totals[], const mealPortion portions[], int count) const;
+};
+
+mealPlanner& getMealPlanner();   // Shared planner over getRecipeCatalog()
+
+
+// ===================== SESSION STORE =====================
+// Every active user's tracker, by name. Users hash to one of
+//    SESSION_STORE_SHARDS shards, each with its own reader/writer lock, so
+//    readers never block each other and a writer only blocks its own shard.
+class sessionStore
+{
+public:
+    sessionStore();
+
+    // Adds the user, or replaces the tracker already stored under that name
+    void store(const string& userName, unique_ptr<nutritionTracker> tracker);
+
+    // Calls view (shared lock) or edit (exclusive lock) with the user's tracker.
+    //    False if the user isn't stored.
+    bool read(const string& userName, const function<void(const nutritionTracker&)>& view) const;
+    bool update(const string& userName, const function<void(nutritionTracker&)>& edit);
+
+    size_t size() const;
+    trackerMemory getMemoryUsage() const;   // Every stored user, plus the store's own nodes
+
+    // Calls view with every user, one shard (shared lock) at a time
+    void forEach(const function<void(const string&, const nutritionTracker&)>& view) const;
+
+    // A name is claimed while a server connection or console session uses it,
+    //    so no one else can load or replace that user. False if already claimed.
+    bool claim(const string& userName);
+    void release(const string& userName);
+
+private:
+    struct storeShard
+    {
+        mutable shared_mutex lock;
+        unordered_map<string, unique_ptr<nutritionTracker>> users;
+        unordered_set<string> claimed;
+    };
+
+    unique_ptr<storeShard[]> shards;
+
+    storeShard& getShard(const string& userName) const;
+};
+
+// Names claimed by one console or menu session. Released when it ends,
+//    including when a menu server connection closes mid-session.
+class sessionNameClaims
+{
+public:
+    explicit sessionNameClaims(sessionStore& store) : users(store) {}
+    ~sessionNameClaims();
+
+    bool claim(const string& userName);   // False if another session holds the name
+
+private:
+    sessionStore& users;
+    vector<string> names;
+};
+
+sessionStore& getSessionStore();   // Interactive sessions and server mode users
+
+
+// ===================== JOURNAL =====================
+// Write-ahead log of every profile and calorie entry, so a crash loses
+//    nothing that was confirmed. Each record is its payload length and
+//    CRC-32 followed by the payload:
+//      type, day, goal (1 byte each), calories, meals per day (4 each),
+//      workout hours (8, the double's bits), name and protein lengths (2 each),
+//      then the name and protein text
+//    Recovery replays records in order and stops at the first torn or
+//    corrupt one, which is where a crash interrupted the last write.
+//    Journal offsets count every byte of records ever written. Once a
+//    snapshot holds the records before an offset, compact() drops them and
+//    the file starts with JOURNAL_MAGIC and that offset instead, so a
+//    snapshot's offset still names the same record.
+struct journalEntry
+{
+    JournalRecordType type = JOURNAL_PROFILE;
+    uint8_t day = 0;
+    uint8_t goal = 0;
+    int calories = 0;                  // Calorie target for a profile, otherwise the day's calories
+    int mealsPerDay = 0;
+    double weeklyWorkoutHours = 0.0;
+    string_view userName;
+    string_view protein;               // Profiles only
+};
+
+struct journalRecovery
+{
+    long long records = 0;
+    size_t users = 0;
+    uint64_t validBytes = 0;       // File bytes up to the last intact record; the file is cut back to this
+    uint64_t discardedBytes = 0;   // Torn or corrupt tail left by a crash
+};
+
+// append() only copies the record into memory. A commit thread writes
+//    everything queued since its last write and syncs it with one fsync, so
+//    many users' entries share each sync (group commit).
+class calorieJournal
+{
+public:
+    calorieJournal() = default;
+    ~calorieJournal() { close(); }
+    calorieJournal(const calorieJournal&) = delete;
+    calorieJournal& operator=(const calorieJournal&) = delete;
+
+    bool open(const string& path);   // New records go after the ones already there
+    void close();                    // Writes and syncs everything still queued
+    bool isOpen() const { return file != nullptr; }
+
+    uint64_t append(const journalEntry& entry);   // The record's sequence number (1, 2, ...)
+    bool waitDurable(uint64_t sequence);          // Blocks until that record is synced; false if writing failed
+    bool hasFailed() const;                       // A write failed; nothing after it is durable
+
+    // Rewrites the file without the records before offset (a snapshot holds
+    //    them). Only while nothing is queued; false if it can't.
+    bool compact(uint64_t offset);
+
+    long long getSyncs() const;
+
+private:
+    FILE* file = nullptr;
+    string path;
+    uint64_t baseOffset = 0;       // Journal offset of the file's first record
+    uint64_t durableOffset = 0;    // Journal offset just past the last synced record
+    thread committer;
+    mutable mutex lock;
+    condition_variable wake;       // Records queued, or closing
+    condition_variable synced;     // durableSequence moved
+    string queued;
+    string writing;                // The commit thread's batch
+    uint64_t queuedSequence = 0;
+    uint64_t durableSequence = 0;
+    long long syncs = 0;
+    bool closing = false;
+    bool failed = false;
+
+    void commitLoop();
+};
+
+calorieJournal& getJournal();   // Interactive sessions and server mode
+// Journal offset just past the file's last byte; 0 if there is no file
+uint64_t getJournalEndOffset(const string& path);
+uint32_t calculateCrc32(const char* data, size_t length, uint32_t previous = 0);   // previous continues an earlier CRC
+void appendJournalRecord(string& out, const journalEntry& entry);
+
+// Decodes the record at data; false if it is cut short or its checksum doesn't match
+bool decodeJournalRecord(const char* data, size_t available, journalEntry& entry, size_t& recordBytes);
+
+// Calls apply with every intact record from journal offset startOffset on
+//    (from the start if the file doesn't reach it). False if there is no journal yet.
+bool readJournal(const string& path, const function<void(const journalEntry&)>& apply, journalRecovery& recovery,
+    uint64_t startOffset = 0);
+
+
+// ===================== SNAPSHOT =====================
+// Every user's inputs and derived state (macro targets, sessions, weekly log
+//    and calorie history) in one file laid out to be memory-mapped:
+//      header | fixed-size user records | name hash table | history | text
+//    A restarted server maps it and answers at once; a user's pages are only
+//    read when a request first names them. The header records how much of
+//    the journal the snapshot already includes, so only the rest is replayed.
+//    The header and each user (record, history and text) carry a CRC-32; a
+//    user whose CRC doesn't match is treated as not in the snapshot.
+class trackerSnapshot
+{
+public:
+    bool open(const string& path);   // False if missing or damaged
+    size_t size() const { return static_cast<size_t>(userCount); }
+    uint64_t getJournalBytes() const { return journalBytes; }   // Journal offset it includes records up to
+
+    string_view getName(size_t index) const;
+    bool load(string_view userName, nutritionTracker& tracker) const;   // False if the user isn't in it
+
+    // Copies user index unchanged into a snapshot being built
+    void appendRecord(size_t index, string& records, string& historyValues, string& text) const;
+
+private:
+    mappedFile file;
+    uint64_t userCount = 0;
+    uint64_t tableSlots = 0;       // Power of two; slot holds record index + 1, or 0
+    uint64_t journalBytes = 0;
+    uint64_t historyCount = 0;
+    uint64_t textBytes = 0;
+    const char* records = nullptr;
+    const char* table = nullptr;
+    const char* historyValues = nullptr;
+    const char* text = nullptr;
+
+    bool recordFits(const char record[]) const;
+    bool recordIntact(const char record[]) const;   // Fits, and its CRC matches
+};
+
+// Writes users, plus previous's users that aren't in the store (never loaded
+//    since the restart), through a temporary file renamed into place
+bool writeTrackerSnapshot(const string& path, const sessionStore& users, const trackerSnapshot* previous,
+    uint64_t journalBytes, size_t& userCount);
+uint64_t hashSnapshotName(string_view userName);   // FNV-1a, so the table reads the same in any build
+// CRC-32 of a record's first SNAPSHOT_RECORD_BYTES - 4 bytes, its history and its text
+uint32_t calculateSnapshotRecordCrc(const char record[], const char historyValues[], const char text[]);
+
+// Rebuilds the journal's users into users and cuts off a damaged tail. With a
+//    snapshot, only records after it are replayed, onto its users.
+journalRecovery recoverJournal(const string& path, sessionStore& users, const trackerSnapshot* snapshot = nullptr);
+
+// A console session the last run stopped in before its week reached
+//    <name>_sessions.bin: the profile and the days logged so far
+struct unfinishedSession
+{
+    string protein;
+    int dailyCalories = 0;
+    int mealsPerDay = 0;
+    double weeklyWorkoutHours = 0.0;
+    GoalType goal = MAINTENANCE;
+    int dailyCaloriesLog[NUMBER_OF_DAYS] = {};
+    int loggedDays = 0;
+};
+
+// Console recovery. A clean exit leaves only sessions nobody picked up in
+//    the journal, so anything load() finds means the last run stopped early.
+//    Entering the same name resumes that session at its next unanswered day.
+class unfinishedSessions
+{
+public:
+    size_t load(const string& path);   // Cuts off a damaged tail; returns how many were found
+    bool take(const string& userName, unfinishedSession& session);   // Removes and returns that user's, if any
+    void rewriteJournal(const string& path) const;   // After a clean exit: only the sessions still unfinished
+
+private:
+    mutable mutex lock;
+    unordered_map<string, unfinishedSession> sessions;
+};
+
+unfinishedSessions& getUnfinishedSessions();
+
+
+// ===================== SERVER MODE =====================
+// --serve keeps trackers resident and answers line requests over a Unix
+//    domain socket with an epoll event loop (Linux). Clients may pipeline
+//    any number of requests; responses come back in order, one line each:
+//      PROFILE <batch input row>          OK <batch result row>
+//      MACROS <calories> <meals> <hours> <goal 1-3>
+//                                         OK <protein> <carbs> <fat> <protein/meal> <carbs/meal> <fat/meal>
+//      USER <name>                        OK <days logged> (a stored, recovered or snapshot user)
+//      APPEND <calories>                  OK <days logged> <7-day average> <7-day highest>
+//      REPORT                             OK <byte count>, then that many bytes of report text
+//      PING, QUIT                         OK
+//    Anything else answers ERR <message>. APPEND and REPORT need a PROFILE first.
+//    Users live in getSessionStore(). PROFILE and USER claim the name for the
+//    connection until it closes or names another user; a name another
+//    connection holds answers ERR user in use.
+//    Changes are journaled, and answers are sent only once their change is synced.
+//    If the journal can't be written, the round's first change answer and
+//    everything after it become ERR journal write failed and the connection
+//    closes; later PROFILE and APPEND requests answer ERR journal unavailable.
+struct serverConnection
+{
+    int socket = -1;
+    uint32_t events = 0;       // epoll interest currently registered
+    string input;
+    size_t inputStart = 0;     // First byte not yet handled
+    string output;
+    size_t outputStart = 0;    // First byte not yet sent
+    string userName;           // This connection's user in getSessionStore()
+    bool hasProfile = false;
+    bool closing = false;      // QUIT or a protocol error: close once output is sent
+    int menuSession = 0;       // --serve-menus: this connection's session in the multiplexer
+    size_t unsyncedOutput = string::npos;   // Start of this round's first answer to a change
+};
+
+// Buffers reused by every request (the event loop is single-threaded)
+struct serverScratch
+{
+    batchBlock block;
+    reportBuffer report;
+    nutritionTracker tracker;   // Fills macro cache entries for MACROS
+    string resultColumns;
+    macroCacheEntry cached;
+    long long requests = 0;
+    uint64_t journalSequence = 0;   // Last change journaled; answers wait until it is synced
+    long long changes = 0;          // PROFILE and APPEND requests, so snapshots are only taken when due
+    long long snapshotChanges = 0;  // changes when the last snapshot was taken
+    chrono::steady_clock::time_point lastSnapshot = chrono::steady_clock::now();
+    unique_ptr<trackerSnapshot> snapshot;   // Users not loaded since the restart; null if none
+    int snapshotWriter = 0;                 // Process ID of the child writing a snapshot, or 0
+    uint64_t snapshotJournalBytes = 0;      // Journal offset that snapshot includes
+};
+
+// --client: load generator for a running server
+struct loadClientOptions
+{
+    string socketPath = SERVER_DEFAULT_SOCKET;
+    int connections = 4;
+    long long requests = 100000;   // Across all connections
+    int pipeline = 16;             // Requests written before reading their responses
+};
+
+int runServerMode(const string& socketPath);
+int openServerListener(const string& socketPath);   // Listening and non-blocking; -1 after printing why not
+int runLoadClient(const loadClientOptions& options);
+void handleServerRequest(serverConnection& connection, string_view request, serverScratch& scratch);
+// Maps the last snapshot (its users are read when first named) and replays
+//    the journal records written after it
+void restoreServerUsers(const string& snapshotPath, const string& journalPath, serverScratch& scratch);
+// Writes a snapshot if users changed since the last one and it is due (or
+//    stopping). A forked child writes it while the event loop keeps going.
+void takeServerSnapshot(const string& path, const string& journalPath, serverScratch& scratch, bool stopping);
+// Reaps a finished snapshot writer (waits for it when stopping)
+void finishServerSnapshot(const string& path, const string& journalPath, serverScratch& scratch, bool stopping);
+// Maps a new snapshot file and drops the journal records it holds
+void useServerSnapshot(const string& path, const string& journalPath, serverScratch& scratch, bool written);
+
+// Loads the targets for key into tracker (whose profile must match key) from
+//    the macro cache, computing and caching them on a miss. scratch.cached
+//    holds the entry; returns false if it couldn't be cached.
+bool findMacroTargets(const macroCacheKey& key, nutritionTracker& tracker, serverScratch& scratch);
+
+// ===================== REPLAY MODE =====================
+// --replay runs recorded sessions through the same menu code as the console
+//    and compares what they print. A transcript holds any number of sessions:
+//      @input      the answers, exactly as they would be typed
+//      @output     what the session printed
+//      @end
+//    Lines starting with '#' between sessions are comments. Menu option 9
+//    prints timings, so transcripts shouldn't use it; the meal plan's
+//    "Plan built in" line is compared without its number.
+struct replaySession
+{
+    string comments;         // '#' lines before @input, kept when recording
+    string input;
+    string expectedOutput;
+    int lineNumber = 0;      // Of its @input line
+};
+
+struct replayOptions
+{
+    string transcriptPath;
+    int repeat = 1;          // Times every session is replayed
+    bool record = false;     // Take @output from this build, then check later passes match it
+};
+
+// Menu-driven sessions until the user exits. main runs it on the console;
+//    replay passes useHistoryFiles = false so <name>_sessions.bin is left alone.
+//    With latencies, every input step and menu choice is timed into them.
+//    With useReportFiles = false, the report and performance stats are only
+//    shown, never written to report.txt and perf_stats.txt.
+sessionTask runInteractiveSession(sessionInput& input, sessionStore& users, bool useHistoryFiles,
+    sessionLatencies* latencies = nullptr, bool useReportFiles = true);
+
+// Runs session on this thread, feeding it a line from cin each time it
+//    waits (never, if its input was all given up front)
+void runSessionToEnd(sessionTask& session, sessionInput& input);
+
+int runReplayMode(const replayOptions& options);
+bool loadReplayTranscript(const string& path, vector<replaySession>& sessions);
+bool saveReplayTranscript(const string& path, const vector<replaySession>& sessions);
+
+// First line where actual differs from expected (1-based), or 0 if they match
+int findReplayDifference(string_view expected, string_view actual, string& expectedLine, string& actualLine);
+
+
+// ===================== LOAD GENERATOR =====================
+// --loadgen synthesizes user sessions (profile answers, seven calorie
+//    entries, then a mix of menu views, reports, range queries and edits)
+//    and runs them through runInteractiveSession with cout captured, timing
+//    every operation. Every screen goes through the one cout, so concurrent
+//    workers are forked processes (Linux) that send their samples back
+//    through a pipe.
+struct loadgenOptions
+{
+    long long sessions = 2000;
+    int concurrency = 1;       // Worker processes
+    unsigned seed = 2530;      // Same seed, same sessions, for comparing builds
+    string resultsPath = LOADGEN_RESULTS_FILE;
+};
+
+int runLoadGenerator(const loadgenOptions& options);
+
+// The answers simulated user sessionIndex types, through their final 8 (exit)
+string makeLoadgenSession(unsigned seed, long long sessionIndex);
+
+// Runs sessions worker, worker + concurrency, ... and returns their timings
+void runLoadgenWorker(const loadgenOptions& options, int worker, sessionLatencies& latencies);
+
+
+// ===================== SESSION MULTIPLEXER =====================
+// Many interactive sessions on one thread. Each keeps its own tracker,
+//    input and output; an idle one is just its suspended coroutine frames.
+//    cout (and its format flags) point at a session only while it runs.
+class sessionMultiplexer
+{
+public:
+    explicit sessionMultiplexer(sessionStore& sessionUsers);
+
+    int open();                                  // Starts a session and runs it to its first prompt
+    void feed(int session, string_view typed);   // Runs the session until it waits again
+    void finish(int session);                    // Its terminal or socket closed
+    void takeOutput(int session, string& output);   // Appends what it printed since the last call
+    bool isDone(int session) const;
+    size_t getUnreadBytes(int session) const;   // A partial line the session is still waiting to finish
+    void close(int session);
+    size_t size() const { return sessions.size(); }
+    size_t getBufferBytes() const;               // Input and output buffers of every session
+
+private:
+    struct multiplexedSession
+    {
+        sessionInput input;
+        stringbuf output;
+        ios format{ nullptr };   // cout's flags, precision and fill while this session runs
+        sessionTask task;
+    };
+
+    sessionStore& users;
+    unordered_map<int, unique_ptr<multiplexedSession>> sessions;
+    int nextSession = 1;
+    ios consoleFormat{ nullptr };   // cout's own flags while a session runs
+
+    void run(multiplexedSession& session, bool starting);
+};
+
+// --serve-menus: the interactive menus over a Unix socket (Linux), one
+//    multiplexed session per connection, all on one thread
+int runMenuServer(const string& socketPath);
+
+void runMultiplexBenchmark(vector<benchmarkResult>& results);   // Idle session memory and wake-up latency
+
+
+// ===================== BENCHMARKS =====================
+#if TRACKER_COUNT_ALLOCATIONS
+// Counts every global operator new so benchmarks can report allocations/op
+atomic<long long> allocationCount(0);
+#endif
+
+long long getAllocationCount();   // Always 0 unless built with TRACKER_COUNT_ALLOCATIONS=1
+double getAllocationsPerOp(long long allocationsBefore, double operations);   // -1 when not counted
+
+struct benchmarkResult
+{
+    string name;
+    size_t dataSize;
+    double nsPerOp;
+    double itemsPerSecond;
+    double allocationsPerOp;
+};
+
+int runBenchmarks(const string& resultsPath);
+benchmarkResult runBenchmark(const string& name, size_t dataSize, size_t opsPerPass,
+    const function<void()>& pass);
+void printBenchmarkResult(const benchmarkResult& result);
+void printMemoryReport(ostream& out, const trackerMemory& memory);
+benchmarkResult runSessionStoreStress(sessionStore& users, const vector<string>& userNames, int threadCount);
+benchmarkResult runJournalStress(const string& path, int threadCount);
+bool runJournalCrashTests(const string& path);   // Torn writes, flipped bytes and a killed writer
+bool checkMacroKernel(mt19937& random);          // SIMD calculateMacrosColumns() gives the scalar results
+void runRestartBenchmark(vector<benchmarkResult>& results);   // Time to first request: journal vs snapshot
+
+
+// Per-worker scratch space for batch mode. Every buffer a profile needs is
+//    reused from the last profile, so once they have grown to fit, the
+//    pipeline makes no heap allocations (checked by --bench).
+struct batchWorker
+{
+    nutritionTracker tracker;
+    reportBuffer report;
+    string reportPath;
+    string reportName;      // reportFileNames::claim() scratch
+    string resultColumns;   // Rendered for macro cache entries
+    macroCacheEntry cached;
+};
+
+
+// ===================== MAIN =====================
+// Main function controlling program flow and user interaction
+int main(int argc, char* argv[])
+{
+    // Reads advice_rules.csv now so a broken file is reported before anything runs
+    getAdviceRules();
+
+    // Microbenchmarks: Week08.exe --bench [results.json]
+    if (argc > 1 && string(argv[1]) == "--bench")
+    {
+        return runBenchmarks((argc > 2) ? argv[2] : "bench_results.json");
+    }
+
+    // Resident server: Week08.exe --serve [socket path]
+    if (argc > 1 && string(argv[1]) == "--serve")
+    {
+        return runServerMode((argc > 2) ? argv[2] : SERVER_DEFAULT_SOCKET);
+    }
+
+    // Interactive menus for many users at once: Week08.exe --serve-menus [socket path]
+    if (argc > 1 && string(argv[1]) == "--serve-menus")
+    {
+        return runMenuServer((argc > 2) ? argv[2] : MENU_SERVER_DEFAULT_SOCKET);
+    }
+
+    // Load generator for --serve: Week08.exe --client [socket path] [options]
+    if (argc > 1 && string(argv[1]) == "--client")
+    {
+        loadClientOptions options;
+        int first = 2;
+        bool validOptions = true;
+
+        if (argc > 2 && argv[2][0] != '-')
+        {
+            options.socketPath = argv[2];
+            first = 3;
+        }
+
+        for (int i = first; validOptions && i < argc; i += 2)
+        {
+            string option = argv[i];
+
+            if (i + 1 >= argc)
+                validOptions = false;
+            else if (option == "--connections")
+                options.connections = atoi(argv[i + 1]);
+            else if (option == "--requests")
+                options.requests = atoll(argv[i + 1]);
+            else if (option == "--pipeline")
+                options.pipeline = atoi(argv[i + 1]);
+            else
+                validOptions = false;
+        }
+
+        if (!validOptions || options.connections <= 0 || options.requests <= 0 || options.pipeline <= 0)
+        {
+            cerr << "Usage: " << argv[0] << " --client [socket path] [--connections N] [--requests N] [--pipeline N]\n";
+            return 1;
+        }
+
+        return runLoadClient(options);
+    }
+
+    // Headless batch mode: Week08.exe --batch profiles.csv results.csv [options]
+    if (argc > 1 && string(argv[1]) == "--batch")
+    {
+        batchOptions options;
+        // hardware_concurrency() may be 0 when it can't tell; the shared pool uses 1 then too
+        options.threadCount = max(1, static_cast<int>(thread::hardware_concurrency()));
+        bool validOptions = (argc >= 4);
+
+        if (validOptions)
+        {
+            options.inputPath = argv[2];
+            options.outputPath = argv[3];
+        }
+
+        for (int i = 4; validOptions && i < argc; i += 2)
+        {
+            string option = argv[i];
+
+            if (i + 1 >= argc)
+                validOptions = false;
+            else if (option == "--threads")
+                options.threadCount = atoi(argv[i + 1]);
+            else if (option == "--reports")
+                options.reportFile = argv[i + 1];
+            else if (option == "--report-dir")
+                options.reportDirectory = argv[i + 1];
+            else if (option == "--rules")
+                options.rulesPath = argv[i + 1];
+            else
+                validOptions = false;
+        }
+
+        if (!validOptions || options.threadCount <= 0)
+        {
+            cerr << "Usage: " << argv[0] << " --batch <profiles.csv|.tsv> <results.csv> [--threads N]\n"
+                << "           [--reports <all_reports.txt>] [--report-dir <existing folder>] [--rules <advice_rules.csv>]\n";
+            return 1;
+        }
+
+        return runBatchMode(options);
+    }
+
+    // Replays recorded sessions: Week08.exe --replay transcript.txt [--repeat N] [--record]
+    if (argc > 1 && string(argv[1]) == "--replay")
+    {
+        replayOptions options;
+        bool validOptions = (argc >= 3);
+
+        if (validOptions)
+            options.transcriptPath = argv[2];
+
+        for (int i = 3; validOptions && i < argc; i++)
+        {
+            string option = argv[i];
+
+            if (option == "--record")
+                options.record = true;
+            else if (option == "--repeat" && i + 1 < argc)
+                options.repeat = atoi(argv[++i]);
+            else
+                validOptions = false;
+        }
+
+        if (!validOptions || options.repeat <= 0)
+        {
+            cerr << "Usage: " << argv[0] << " --replay <transcript.txt> [--repeat N] [--record]\n";
+            return 1;
+        }
+
+        return runReplayMode(options);
+    }
+
+    // Simulated users: Week08.exe --loadgen [--sessions N] [--concurrency N] [--seed N] [--json results.json]
+    if (argc > 1 && string(argv[1]) == "--loadgen")
+    {
+        loadgenOptions options;
+        bool validOptions = true;
+
+        for (int i = 2; validOptions && i < argc; i += 2)
+        {
+            string option = argv[i];
+
+            if (i + 1 >= argc)
+                validOptions = false;
+            else if (option == "--sessions")
+                options.sessions = atoll(argv[i + 1]);
+            else if (option == "--concurrency")
+                options.concurrency = atoi(argv[i + 1]);
+            else if (option == "--seed")
+                options.seed = static_cast<unsigned>(strtoul(argv[i + 1], nullptr, 10));
+            else if (option == "--json")
+                options.resultsPath = argv[i + 1];
+            else
+                validOptions = false;
+        }
+
+        if (!validOptions || options.sessions <= 0 || options.concurrency <= 0)
+        {
+            cerr << "Usage: " << argv[0] << " --loadgen [--sessions N] [--concurrency N] [--seed N]"
+                << " [--json <results.json>]\n";
+            return 1;
+        }
+
+        return runLoadGenerator(options);
+    }
+
+    // Sessions a run stopped in the middle of; a clean exit leaves none unless nobody resumed them
+    size_t unfinished = getUnfinishedSessions().load(JOURNAL_FILE);
+
+    if (unfinished > 0)
+    {
+        cout << "Found " << unfinished << " unfinished session" << (unfinished == 1 ? "" : "s")
+            << " from a run that stopped early. Enter the same name to pick up where you left off.\n\n";
+    }
+
+    if (!getJournal().open(JOURNAL_FILE))
+        cerr << "Warning: Unable to open " << JOURNAL_FILE << "; entries will not survive a crash\n";
+
+    sessionInput input;
+    sessionTask session = runInteractiveSession(input, getSessionStore(), true);
+    runSessionToEnd(session, input);
+    getJournal().close();
+
+    // Every finished week is in its <name>_sessions.bin now
+    getUnfinishedSessions().rewriteJournal(JOURNAL_FILE);
+
+    return 0;
+}
+
+
+// ================================= FUNCTION DEFINITIONS ==============================================
+
+// --------------------- Interactive Session ---------------------
+sessionTask runInteractiveSession(sessionInput& input, sessionStore& users, bool useHistoryFiles,
+    sessionLatencies* latencies, bool useReportFiles)
+{
+    unique_ptr<nutritionTracker> session;
+    sessionNameClaims claims(users);   // Kept for the whole run, since stored users stay active
+
+    char startNewSession = 'n';
+
+    // Main session loop so user can restart with new inputs
+    do
+    {
+        session = make_unique<nutritionTracker>();
+        nutritionTracker& tracker = *session;
+
+        tracker.displayIntroBanner();
+        bool inputEnded = false;
+
+        try
+        {
+            {
+                TRACK_STAGE(STAGE_USER_INPUT);
+                scopedLatencySample sample(latencies, STAGE_USER_INPUT);
+                co_await tracker.collectUserInput(input, claims);
+            }
+            if (useHistoryFiles)
+            {
+                TRACK_STAGE(STAGE_HISTORY_FILE);
+                tracker.restoreSessionHistory();
+            }
+            {
+                TRACK_STAGE(STAGE_CALORIE_LOG_INPUT);
+                scopedLatencySample sample(latencies, STAGE_CALORIE_LOG_INPUT);
+                co_await tracker.fillDailyCaloriesArray(input);
+            }
+        }
+        catch (const sessionInputEnded&)
+        {
+            inputEnded = true;
+        }
+
+        // A half-entered user is never stored or shown
+        if (inputEnded)
+        {
+            setConsoleColor(COLOR_ERROR);
+            cout << "Input ended before this session was complete, so it was not saved.\n";
+            setConsoleColor(COLOR_DEFAULT);
+            break;
+        }
+        {
+            TRACK_STAGE(STAGE_CALCULATE_MACROS);
+            scopedLatencySample sample(latencies, STAGE_CALCULATE_MACROS);
+            tracker.calculateMacros();
+        }
+        {
+            TRACK_STAGE(STAGE_FILL_SESSIONS);
+            scopedLatencySample sample(latencies, STAGE_FILL_SESSIONS);
+            tracker.fillSessionsFromCalories();
+        }
+        if (useHistoryFiles)
+        {
+            TRACK_STAGE(STAGE_HISTORY_FILE);
+
+            // Once the week is in the file, recovery has nothing of it to resume
+            if (tracker.saveWeeklySessions())
+                tracker.waitForJournal(tracker.appendToJournal(JOURNAL_WEEK_SAVED));
+        }
+        {
+            TRACK_STAGE(STAGE_MEAL_PLAN);
+            scopedLatencySample sample(latencies, STAGE_MEAL_PLAN);
+            tracker.planWeeklyMeals();
+        }
+
+        int menuChoice = 0;
+
+        // ------------------------ Menu Loop -----------------------------
+        // Displays the main menu and allows the user to explore all features
+        //    until they choose to exit or start a new session
+        do
+        {
+            tracker.displayMenu();
+            bool validChoice = co_await input.readInt(menuChoice);
+            cout << "\n";
+
+            // Out of input: finish as if the user chose to exit
+            if (!validChoice && input.atEnd())
+            {
+                menuChoice = MENU_EXIT;
+                validChoice = true;
+            }
+
+            // If menu input is invalid, clear the stream and continue
+            if (!validChoice)
+            {
+                co_await input.skipLine();
+                COUNT_EVENT(COUNTER_MENU_RETRIES, 1);
+                setConsoleColor(COLOR_ERROR);
+                cout << "Invalid choice. Please enter a number from 1 to 12.\n\n";
+                setConsoleColor(COLOR_DEFAULT);
+                continue;   
+            }
+
+            // Time each menu option as its own stage
+            TRACK_STAGE(getMenuStage(menuChoice));
+            scopedLatencySample sample(latencies, getMenuStage(menuChoice));
+
+            switch (menuChoice)
+            {
+            case 1:
+                // Show suggested daily macros and per meal breakdown
+                tracker.displayDailyMacros();
+                break;
+
+            case 2:
+                // Write a formatted report to report.txt
+                tracker.generateReport(useReportFiles);
+                break;
+
+            case 3:
+                // Check calorie intake vs activity and show smoothie recipe
+                tracker.displayNutritionCheckAndRecipe();
+                break;
+
+            case 4:
+                // View weekly calorie log (array)
+                tracker.displayWeeklyCalorieLog();
+                break;
+
+            case 5:
+                // View weekly nutrition sessions (using struct array)
+                tracker.displayWeeklySessions();
+                break;
+
+            case 6:
+                // Display macros per meal as a grid
+                tracker.displayMacrosPerMeal2D();
+                break;
+
+            case MENU_NEW_SESSION:
+                // Start a new session with fresh inputs
+                setConsoleColor(COLOR_SUB_HEADING);
+                cout << "Starting a new session...\n\n";
+                setConsoleColor(COLOR_DEFAULT);
+                break;
+
+            case 8:
+                // Average/peak calories between two days of the history
+                try
+                {
+                    co_await tracker.displayCalorieRangeQuery(input);
+                }
+                catch (const sessionInputEnded&)
+                {
+                    menuChoice = MENU_EXIT;   // Out of input, as at the menu prompt
+                }
+                break;
+
+            case 9:
+                // Stage timings, validation retries and report bytes
+                tracker.displayPerformanceStats(useReportFiles);
+                break;
+
+            case 10:
+                // Foods and portions chosen for every meal this week
+                tracker.displayMealPlan();
+                break;
+
+            case 11:
+                // Change one input; only what depends on it is recomputed
+                try
+                {
+                    co_await tracker.editWeeklyInput(input);
+                }
+                catch (const sessionInputEnded&)
+                {
+                    menuChoice = MENU_EXIT;   // Out of input, as at the menu prompt
+                }
+                break;
+
+            case MENU_EXIT:
+                // Exit the program
+                setConsoleColor(COLOR_SUB_HEADING);
+                cout << "Thanks for using the program! Keep lifting strong!\n";
+                printSectionBreakLine();
+                setConsoleColor(COLOR_DEFAULT);
+                break;
+
+            default:
+                COUNT_EVENT(COUNTER_MENU_RETRIES, 1);
+                setConsoleColor(COLOR_ERROR);
+                cout << "Invalid choice. Please select 112.\n\n";
+                setConsoleColor(COLOR_DEFAULT);
+                break;
+            }
+
+        } while (menuChoice != MENU_NEW_SESSION && menuChoice != MENU_EXIT);
+
+        // Clear leftover newline from menu input
+        co_await input.skipLine();
+
+        // Keep this user active rather than overwriting them with the next session
+        string userName = tracker.getName();
+        users.store(userName, move(session));
+
+        // Check if user decided to start a new session
+        startNewSession = (menuChoice == MENU_NEW_SESSION) ? 'y' : 'n';
+
+        if (startNewSession == 'y')
+        {
+            size_t activeUsers = users.size();
+            cout << "Saved " << userName << "'s session (" << activeUsers << " active user"
+                << (activeUsers == 1 ? "" : "s") << ").\n\n";
+        }
+
+    } while (startNewSession == 'y');
+
+    cout << "\nProgram ended. Have a great day!\n";
+}
+
+void runSessionToEnd(sessionTask& session, sessionInput& input)
+{
+    string line;
+
+    session.start();
+
+    // Each time the session waits for an answer, read another line
+    while (!session.done())
+    {
+        if (getline(cin, line))
+        {
+            line += '\n';
+            input.feed(line);
+        }
+        else
+            input.finish();
+
+        input.resume();
+    }
+
+    session.checkFailure();
+}
+
+
+// --------------------- Utility Functions ---------------------
+void setConsoleColor(int color)
+{
+    if (isConsoleCaptured())
+        return;
+
+#ifdef _WIN32
+    // Handle is a Windows data type that references the console
+    // GetSTDHandle is a Windows function that retrieves the console/output device
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+
+    // SetConsoleTextAttribute is a Windows function to allow changing the text color in the console
+    SetConsoleTextAttribute(hConsole, color);
+#else
+    // Goes through cout so the escape stays in order with the text around it
+    if (getConsoleMode() == CONSOLE_ANSI)
+    {
+        string escape;
+        appendAnsiColor(escape, color);
+        cout << escape;
+    }
+#endif
+}
+
+// Characters unsafe in file names are replaced with '_'
+void appendSafeFileName(string& path, string_view name)
+{
+    for (char c : name)
+        path += (isalnum(static_cast<unsigned char>(c)) || c == '-') ? c : '_';
+}
+
+void printSectionBreakLine(ostream& out)
+{
+    out << setfill('*') << setw(CONSOLE_WIDTH) << '*' << "\n";
+    out << setfill(' ');
+}
+
+
+// --------------------- Constructor ---------------------
+nutritionTracker::nutritionTracker()
+{
+    name = "";
+    favoriteProtein = "";
+    dailyCalories = 0;
+    weeklyCalories = 0;
+    mealsPerDay = 0;
+    weeklyWorkoutHours = 0.0;
+
+    dailyProteinGrams = 0;
+    dailyCarbGrams = 0;
+    dailyFatGrams = 0;
+
+    goal = MAINTENANCE;
+    restoredDays = 0;
+    resumedDays = 0;
+    mealPlanMilliseconds = 0.0f;
+    staleSessionDays = 0;
+    staleDerived = 0;
+    edited = false;
+
+    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    {
+        dailyCaloriesLog[i] = 0;
+    }
+
+    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    {
+        weeklySessions[i].calories = 0;
+        weeklySessions[i].day = static_cast<uint8_t>(i);
+        weeklySessions[i].metCalorieGoal = false;
+    }
+}
+
+
+// --------------------- Input ---------------------
+sessionTask nutritionTracker::collectUserInput(sessionInput& input, sessionNameClaims& claims)
+{
+    co_await getValidatedStringInput(input, "What is your name? ", name);
+
+    // Another active session with this name would be replaced when this one is saved
+    while (!claims.claim(name))
+    {
+        setConsoleColor(COLOR_ERROR);
+        cout << "Someone named " << name << " already has a session open. Please use a different name.\n\n";
+        setConsoleColor(COLOR_DEFAULT);
+
+        co_await getValidatedStringInput(input, "What is your name? ", name);
+    }
+
+    cout << "Hi " << name << "!\n\n";
+
+    // New user, so start a new calorie history
+    history.clear();
+    resumedDays = 0;
+
+    // A session the last run stopped in the middle of continues from its last answer
+    unfinishedSession unfinished;
+    if (getUnfinishedSessions().take(name, unfinished))
+    {
+        setFavoriteProtein(unfinished.protein);
+        dailyCalories = unfinished.dailyCalories;
+        mealsPerDay = unfinished.mealsPerDay;
+        weeklyWorkoutHours = unfinished.weeklyWorkoutHours;
+        goal = unfinished.goal;
+        resumedDays = unfinished.loggedDays;
+        copy(unfinished.dailyCaloriesLog, unfinished.dailyCaloriesLog + resumedDays, dailyCaloriesLog);
+
+        cout << "Picking up your unfinished session: your profile and " << resumedDays << " of "
+            << NUMBER_OF_DAYS << " days were logged before the last run stopped.\n\n";
+        waitForJournal(appendToJournal(JOURNAL_PROFILE));
+        co_return;
+    }
+
+    string protein;
+    co_await getValidatedStringInput(input, "What is your favorite vegetarian protein source? ", protein);
+    setFavoriteProtein(protein);
+    co_await getValidatedIntInput(input, "How many calories are you targeting each day? ", dailyCalories);
+    co_await getMealsPerDayInput(input, mealsPerDay);
+    co_await getValidatedDoubleInput(input, "How many hours per week do you weightlift? ", weeklyWorkoutHours);
+    co_await getUserGoal(input, goal);
+
+    waitForJournal(appendToJournal(JOURNAL_PROFILE));
+}
+
+sessionTask nutritionTracker::getValidatedStringInput(sessionInput& input, string requestInput, string& value)
+{
+    cout << requestInput;
+    co_await input.readLine(value);
+    cout << "\n";
+
+    // Repeat until the user enters a non-empty string
+    while (value.length() == 0 && !input.atEnd())
+    {
+        COUNT_EVENT(COUNTER_STRING_RETRIES, 1);
+        setConsoleColor(COLOR_ERROR);
+        cout << "That is not a valid answer. Please try again: ";
+        setConsoleColor(COLOR_DEFAULT);
+
+        co_await input.readLine(value);
+        cout << "\n";
+    }
+
+    if (value.length() == 0)
+        throw sessionInputEnded();
+}
+
+sessionTask nutritionTracker::getValidatedIntInput(sessionInput& input, string requestInput, int& value)
+{
+    value = 0;
+
+    cout << requestInput;
+    bool valid = co_await input.readInt(value);
+    cout << "\n";
+
+    // Loop continues until the user enters a valid positive integer
+    while ((!valid || value <= 0) && !input.atEnd())
+    {
+        co_await input.skipLine();
+        COUNT_EVENT(COUNTER_INT_RETRIES, 1);
+        setConsoleColor(COLOR_ERROR);
+        cout << "That is not a valid answer. Please enter a positive number: ";
+        setConsoleColor(COLOR_DEFAULT);
+
+        valid = co_await input.readInt(value);
+        cout << "\n";
+    }
+
+    if (!valid || value <= 0)
+        throw sessionInputEnded();
+
+    co_await input.skipLine();   // Clear newline left in the buffer
+}
+
+sessionTask nutritionTracker::getCaloriesInput(sessionInput& input, string requestInput, int& value)
+{
+    value = 0;
+
+    cout << requestInput;
+    bool valid = co_await input.readInt(value);
+    cout << "\n";
+
+    // Same rule as fillDailyCaloriesArray(): 0 is a rest day
+    while ((!valid || value < 0) && !input.atEnd())
+    {
+        co_await input.skipLine();
+        COUNT_EVENT(COUNTER_CALORIE_RETRIES, 1);
+        setConsoleColor(COLOR_ERROR);
+        cout << "That is not a valid answer. Please enter 0 or a positive number: ";
+        setConsoleColor(COLOR_DEFAULT);
+
+        valid = co_await input.readInt(value);
+        cout << "\n";
+    }
+
+    if (!valid || value < 0)
+        throw sessionInputEnded();
+
+    co_await input.skipLine();
+}
+
+sessionTask nutritionTracker::getMealsPerDayInput(sessionInput& input, int& meals)
+{
+    co_await getValidatedIntInput(input, "How many meals do you eat per day? ", meals);
+
+    // Repeat until the week's meal plan stays a sensible size
+    while (meals > MAX_MEALS_PER_DAY)
+    {
+        COUNT_EVENT(COUNTER_INT_RETRIES, 1);
+        setConsoleColor(COLOR_ERROR);
+        cout << "Please enter from 1 to " << MAX_MEALS_PER_DAY << " meals per day.\n\n";
+        setConsoleColor(COLOR_DEFAULT);
+
+        co_await getValidatedIntInput(input, "How many meals do you eat per day? ", meals);
+    }
+}
+
+sessionTask nutritionTracker::getValidatedDoubleInput(sessionInput& input, string requestInput, double& value)
+{
+    value = 0.0;
+
+    cout << requestInput;
+    bool valid = co_await input.readDouble(value);
+    cout << "\n";
+
+    // Loop continues until the user enters a valid nonnegative double
+    while ((!valid || value < 0.0) && !input.atEnd())
+    {
+        co_await input.skipLine();
+        COUNT_EVENT(COUNTER_DOUBLE_RETRIES, 1);
+        setConsoleColor(COLOR_ERROR);
+        cout << "That is not a valid answer. Please enter a nonnegative number: ";
+        setConsoleColor(COLOR_DEFAULT);
+
+        valid = co_await input.readDouble(value);
+        cout << "\n";
+    }
+
+    if (!valid || value < 0.0)
+        throw sessionInputEnded();
+
+    co_await input.skipLine();   // Clear newline left in the buffer
+}
+
+sessionTask nutritionTracker::getUserGoal(sessionInput& input, GoalType& chosenGoal)
+{
+    int goalChoice = 0;
+
+    cout << "Select your primary goal:\n"
+        << "  1. Fat loss\n"
+        << "  2. Maintenance\n"
+        << "  3. Muscle gain\n\n";
+    cout << "Enter 1, 2, or 3: ";
+    bool valid = co_await input.readInt(goalChoice);
+    cout << "\n";
+
+    while ((!valid || goalChoice < 1 || goalChoice > 3) && !input.atEnd())
+    {
+        co_await input.skipLine();
+        COUNT_EVENT(COUNTER_GOAL_RETRIES, 1);
+        setConsoleColor(COLOR_ERROR);
+        cout << "That is not a valid choice. Please enter 1, 2, or 3: ";
+        setConsoleColor(COLOR_DEFAULT);
+
+        valid = co_await input.readInt(goalChoice);
+        cout << "\n";
+    }
+
+    if (!valid || goalChoice < 1 || goalChoice > 3)
+        throw sessionInputEnded();
+
+    co_await input.skipLine();
+    chosenGoal = static_cast<GoalType>(goalChoice - 1);   // Convert user's goal choice to the enum value (0-2)
+}
+
+
+// --------------------- Core Processing ---------------------
+void nutritionTracker::calculateMacros()
+{
+    // Daily macro grams based on percentage of calories
+    dailyProteinGrams = static_cast<int>((dailyCalories * PROTEIN_PERCENT) /
+        CALORIES_PER_GRAM_PROTEIN);
+    dailyCarbGrams = static_cast<int>((dailyCalories * CARB_PERCENT) /
+        CALORIES_PER_GRAM_CARBS);
+    dailyFatGrams = static_cast<int>((dailyCalories * FAT_PERCENT) /
+        CALORIES_PER_GRAM_FAT);
+
+    // Per meal targets and weekly macro totals come from getProteinPerMeal() etc.
+    //    The weekly calorie figure is reset here, as it always has been.
+    weeklyCalories = 0;
+}
+
+sessionTask nutritionTracker::fillDailyCaloriesArray(sessionInput& input)
+{
+    cout << "Now let's log your actual calories for each day this week.\n";
+    cout << "(Enter a positive number for each day.)\n\n";
+
+    int caloriesDayTotal = 0;
+
+    for (int day = 0; day < NUMBER_OF_DAYS; ++day)
+    {
+        // Logged before the last run stopped; journaled again for this run
+        if (day < resumedDays)
+        {
+            cout << "Day " << (day + 1) << ": " << dailyCaloriesLog[day] << " calories (from your unfinished session)\n";
+            history.append(dailyCaloriesLog[day]);
+            waitForJournal(appendToJournal(JOURNAL_LOG_DAY, day, dailyCaloriesLog[day]));
+            continue;
+        }
+
+        cout << "Enter your total calories for day " << (day + 1) << ": ";
+        bool valid = co_await input.readInt(caloriesDayTotal);
+
+        // Repeat until the user enters a valid answer
+        while ((!valid || caloriesDayTotal < 0) && !input.atEnd())
+        {
+            co_await input.skipLine();
+            COUNT_EVENT(COUNTER_CALORIE_RETRIES, 1);
+            setConsoleColor(COLOR_ERROR);
+            cout << "Please enter a positive number for the day " << (day + 1) << ": ";
+            setConsoleColor(COLOR_DEFAULT);
+
+            valid = co_await input.readInt(caloriesDayTotal);
+        }
+
+        if (!valid || caloriesDayTotal < 0)
+            throw sessionInputEnded();
+
+        co_await input.skipLine();
+        dailyCaloriesLog[day] = caloriesDayTotal;
+        history.append(caloriesDayTotal);
+        waitForJournal(appendToJournal(JOURNAL_LOG_DAY, day, caloriesDayTotal));
+    }
+
+    calculateWeeklyCalories();
+
+    cout << "Thank you! Your weekly calorie log has been recorded.\n\n";
+}
+
+void nutritionTracker::calculateWeeklyCalories()
+{
+    // Compute actual weekly calorie total from the array
+    weeklyCalories = 0;
+
+    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    {
+        weeklyCalories += dailyCaloriesLog[i];
+    }
+}
+
+void nutritionTracker::fillSessionsFromCalories()
+{
+    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    {
+        weeklySessions[i].day = static_cast<uint8_t>(i);
+        weeklySessions[i].calories = dailyCaloriesLog[i];
+
+        // True if the user did not exceed their calorie target
+        weeklySessions[i].metCalorieGoal = (dailyCaloriesLog[i] <= dailyCalories);
+    }
+
+    staleSessionDays = 0;
+}
+
+// --------------------- Batch Processing ---------------------
+void nutritionTracker::loadProfile(string_view userName, string_view protein, int calories,
+    int meals, double hours, GoalType userGoal)
+{
+    name.assign(userName.data(), userName.size());
+    setFavoriteProtein(protein);
+    dailyCalories = calories;
+    mealsPerDay = meals;
+    weeklyWorkoutHours = hours;
+    goal = userGoal;
+    adviceLoaded = false;
+
+    history.clear();
+}
+
+void nutritionTracker::loadDailyCalories(const int calories[])
+{
+    for (int day = 0; day < NUMBER_OF_DAYS; ++day)
+    {
+        dailyCaloriesLog[day] = calories[day];
+        history.append(calories[day]);
+    }
+
+    calculateWeeklyCalories();
+}
+
+void nutritionTracker::appendDailyCalories(int calories)
+{
+    history.append(calories);
+}
+
+// --------------------- Journal Records ---------------------
+uint64_t nutritionTracker::appendToJournal(JournalRecordType type, int day, int calories) const
+{
+    calorieJournal& journal = getJournal();
+
+    if (!journal.isOpen())
+        return 0;
+
+    journalEntry entry;
+    entry.type = type;
+    entry.day = static_cast<uint8_t>(day);
+    entry.goal = static_cast<uint8_t>(goal);
+    entry.calories = (type == JOURNAL_PROFILE) ? dailyCalories : calories;
+    entry.mealsPerDay = mealsPerDay;
+    entry.weeklyWorkoutHours = weeklyWorkoutHours;
+    entry.userName = name;
+    entry.protein = (type == JOURNAL_PROFILE) ? favoriteProtein : string_view();
+
+    return journal.append(entry);
+}
+
+// The session's own output, so a menu server client sees it too
+void nutritionTracker::waitForJournal(uint64_t sequence) const
+{
+    if (getJournal().waitDurable(sequence))
+        return;
+
+    setConsoleColor(COLOR_ERROR);
+    cout << "Warning: This entry could not be saved to the journal, so a crash would lose it.\n\n";
+    setConsoleColor(COLOR_DEFAULT);
+}
+
+void nutritionTracker::applyJournalEntry(const journalEntry& entry)
+{
+    switch (entry.type)
+    {
+    case JOURNAL_PROFILE:
+        loadProfile(entry.userName, entry.protein, entry.calories, entry.mealsPerDay,
+            entry.weeklyWorkoutHours, static_cast<GoalType>(entry.goal));
+        break;
+
+    case JOURNAL_LOG_DAY:
+        // Same as fillDailyCaloriesArray() for one day
+        dailyCaloriesLog[entry.day] = entry.calories;
+        history.append(entry.calories);
+        break;
+
+    case JOURNAL_EDIT_DAY:
+        setDayCalories(entry.day, entry.calories);
+        break;
+
+    case JOURNAL_MEALS_PER_DAY:
+        setMealsPerDay(entry.mealsPerDay);
+        break;
+
+    case JOURNAL_APPEND:
+        appendDailyCalories(entry.calories);
+        break;
+
+    case JOURNAL_WEEK_SAVED:
+        break;   // Only tells console recovery the session finished
+    }
+}
+
+// --------------------- Snapshot Records ---------------------
+// Record: text offset, history index (8 each), history days (4), name and
+//    protein lengths (2 each), calorie target, meals per day (4 each), workout
+//    hours (8), daily protein/carb/fat grams (4 each), goal, met-goal day bits,
+//    2 spare bytes, the 7 logged days and the weekly total (4 each)
+void nutritionTracker::appendSnapshotRecord(string& records, string& historyValues, string& text) const
+{
+    const calorieHistory& days = getHistory();
+    size_t nameLength = min<size_t>(name.size(), 0xFFFF);
+    size_t proteinLength = min<size_t>(favoriteProtein.size(), 0xFFFF);
+    size_t start = records.size();
+    uint64_t hoursBits;
+    uint8_t metGoalDays = 0;
+
+    memcpy(&hoursBits, &weeklyWorkoutHours, sizeof(hoursBits));
+
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+    {
+        if (getSession(day).metCalorieGoal)
+            metGoalDays |= static_cast<uint8_t>(1 << day);
+    }
+
+    records.resize(start + SNAPSHOT_RECORD_BYTES, '\0');
+    char* record = &records[start];
+
+    writeLittleEndian(record, text.size(), 8);
+    writeLittleEndian(record + 8, historyValues.size() / 4, 8);
+    writeLittleEndian(record + 16, days.size(), 4);
+    writeLittleEndian(record + 20, nameLength, 2);
+    writeLittleEndian(record + 22, proteinLength, 2);
+    writeLittleEndian(record + 24, static_cast<uint32_t>(dailyCalories), 4);
+    writeLittleEndian(record + 28, static_cast<uint32_t>(mealsPerDay), 4);
+    writeLittleEndian(record + 32, hoursBits, 8);
+    writeLittleEndian(record + 40, static_cast<uint32_t>(dailyProteinGrams), 4);
+    writeLittleEndian(record + 44, static_cast<uint32_t>(dailyCarbGrams), 4);
+    writeLittleEndian(record + 48, static_cast<uint32_t>(dailyFatGrams), 4);
+    record[52] = static_cast<char>(goal);
+    record[53] = static_cast<char>(metGoalDays);
+
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        writeLittleEndian(record + 56 + 4 * day, static_cast<uint32_t>(dailyCaloriesLog[day]), 4);
+    writeLittleEndian(record + 84, static_cast<uint32_t>(weeklyCalories), 4);
+
+    text.append(name.data(), nameLength);
+    text.append(favoriteProtein.data(), proteinLength);
+
+    size_t historyStart = historyValues.size();
+    historyValues.resize(historyStart + 4 * days.size());
+
+    for (size_t i = 0; i < days.size(); i++)
+        writeLittleEndian(&historyValues[historyStart + 4 * i], static_cast<uint32_t>(days.day(i)), 4);
+
+    writeLittleEndian(&records[start + 88], calculateSnapshotRecordCrc(&records[start], historyValues.data(), text.data()), 4);
+}
+
+void nutritionTracker::loadSnapshotRecord(const char record[], const char historyValues[], const char text[])
+{
+    uint64_t textOffset = readLittleEndian(record, 8);
+    uint64_t historyIndex = readLittleEndian(record + 8, 8);
+    size_t dayCount = static_cast<size_t>(readLittleEndian(record + 16, 4));
+    size_t nameLength = static_cast<size_t>(readLittleEndian(record + 20, 2));
+    size_t proteinLength = static_cast<size_t>(readLittleEndian(record + 22, 2));
+    uint64_t hoursBits = readLittleEndian(record + 32, 8);
+    uint8_t metGoalDays = static_cast<uint8_t>(record[53]);
+
+    name.assign(text + textOffset, nameLength);
+    setFavoriteProtein(string_view(text + textOffset + nameLength, proteinLength));
+    dailyCalories = static_cast<int>(readLittleEndian(record + 24, 4));
+    mealsPerDay = static_cast<int>(readLittleEndian(record + 28, 4));
+    memcpy(&weeklyWorkoutHours, &hoursBits, sizeof(hoursBits));
+    dailyProteinGrams = static_cast<int>(readLittleEndian(record + 40, 4));
+    dailyCarbGrams = static_cast<int>(readLittleEndian(record + 44, 4));
+    dailyFatGrams = static_cast<int>(readLittleEndian(record + 48, 4));
+    goal = static_cast<GoalType>(record[52]);
+
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+    {
+        dailyCaloriesLog[day] = static_cast<int>(readLittleEndian(record + 56 + 4 * day, 4));
+        weeklySessions[day].calories = dailyCaloriesLog[day];
+        weeklySessions[day].day = static_cast<uint8_t>(day);
+        weeklySessions[day].metCalorieGoal = (metGoalDays >> day) & 1;
+    }
+
+    history.clear();
+    history.reserve(dayCount);
+
+    for (size_t i = 0; i < dayCount; i++)
+        history.append(static_cast<int>(readLittleEndian(historyValues + 4 * (historyIndex + i), 4)));
+
+    weeklyCalories = static_cast<int>(readLittleEndian(record + 84, 4));
+    staleSessionDays = 0;
+    staleDerived &= static_cast<uint8_t>(~DERIVED_HISTORY);
+}
+
+// --------------------- Incremental Edits ---------------------
+void nutritionTracker::setDayCalories(int day, int calories)
+{
+    dailyCaloriesLog[day] = calories;
+    staleSessionDays |= static_cast<uint8_t>(1 << day);
+    staleDerived |= DERIVED_HISTORY;
+    edited = true;
+}
+
+void nutritionTracker::setMealsPerDay(int meals)
+{
+    mealsPerDay = meals;
+    staleDerived |= DERIVED_MEAL_PLAN;
+    edited = true;
+}
+
+int nutritionTracker::countStaleValues() const
+{
+    int stale = 0;
+
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        stale += (staleSessionDays >> day) & 1;
+
+    stale += (staleDerived & DERIVED_HISTORY) ? 1 : 0;
+    stale += (staleDerived & DERIVED_MEAL_PLAN) ? 1 : 0;
+    return stale;
+}
+
+const nutritionSession& nutritionTracker::getSession(int day) const
+{
+    if (staleSessionDays & (1 << day))
+    {
+        weeklySessions[day].calories = dailyCaloriesLog[day];
+        weeklySessions[day].metCalorieGoal = (dailyCaloriesLog[day] <= dailyCalories);
+        staleSessionDays &= static_cast<uint8_t>(~(1 << day));
+        COUNT_EVENT(COUNTER_DERIVED_RECOMPUTED, 1);
+    }
+    else if (edited)
+        COUNT_EVENT(COUNTER_DERIVED_KEPT, 1);   // Still current after the edit
+
+    return weeklySessions[day];
+}
+
+const calorieHistory& nutritionTracker::getHistory() const
+{
+    if (staleDerived & DERIVED_HISTORY)
+    {
+        history.replaceLastDays(dailyCaloriesLog, NUMBER_OF_DAYS);
+        staleDerived &= ~DERIVED_HISTORY;
+        COUNT_EVENT(COUNTER_DERIVED_RECOMPUTED, 1);
+    }
+    else if (edited)
+        COUNT_EVENT(COUNTER_DERIVED_KEPT, 1);
+
+    return history;
+}
+
+const vector<mealSolution>& nutritionTracker::getMealPlan() const
+{
+    if (staleDerived & DERIVED_MEAL_PLAN)
+    {
+        buildMealPlan();
+        COUNT_EVENT(COUNTER_DERIVED_RECOMPUTED, 1);
+    }
+    else if (edited)
+        COUNT_EVENT(COUNTER_DERIVED_KEPT, 1);
+
+    return mealPlan;
+}
+
+void nutritionTracker::refreshDerivedState()
+{
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        getSession(day);
+
+    getHistory();
+    getMealPlan();
+}
+
+void nutritionTracker::addMemoryUsage(trackerMemory& memory) const
+{
+    memory.objectBytes += sizeof(nutritionTracker);
+
+    // Short names live inside the string object itself
+    if (name.capacity() > string().capacity())
+        memory.nameBytes += name.capacity() + 1;
+
+    if (unpooledProtein)
+        memory.nameBytes += sizeof(string) + unpooledProtein->capacity() + 1;
+
+    memory.historyBytes += history.getHeapBytes();
+    memory.mealPlanBytes += mealPlan.capacity() * sizeof(mealSolution);
+    memory.users++;
+}
+
+void nutritionTracker::setFavoriteProtein(string_view protein)
+{
+    if (getProteinPool().tryIntern(protein, favoriteProtein))
+        return;
+
+    // Reuses the buffer, so a batch worker reloading rows doesn't allocate each time
+    if (!unpooledProtein)
+        unpooledProtein = make_unique<string>();
+
+    unpooledProtein->assign(protein.data(), protein.size());
+    favoriteProtein = *unpooledProtein;
+}
+
+// Copies targets already computed by calculateMacrosColumns()
+void nutritionTracker::loadMacroTargets(const profileColumns& columns, size_t index)
+{
+    dailyProteinGrams = columns.dailyProteinGrams[index];
+    dailyCarbGrams = columns.dailyCarbGrams[index];
+    dailyFatGrams = columns.dailyFatGrams[index];
+    nutritionAdviceId = columns.nutritionAdvice[index];
+    mealAdviceId = columns.mealAdvice[index];
+    adviceLoaded = true;
+
+    weeklyCalories = 0;   // As calculateMacros() leaves it
+}
+
+// Appends one CSV row with the same values the menu options display
+void nutritionTracker::appendBatchResult(string& output) const
+{
+    appendBatchProfileColumns(output);
+    appendBatchTargetColumns(output);
+    output += '\n';
+}
+
+void nutritionTracker::appendBatchResult(string& output, const macroCacheEntry& cached) const
+{
+    appendBatchProfileColumns(output);
+    output.append(cached.resultColumns, cached.resultLength);
+    output += '\n';
+}
+
+// Name through days met: the columns that depend on the whole profile
+void nutritionTracker::appendBatchProfileColumns(string& output) const
+{
+    char number[32];
+    int loggedCalories = 0;
+    int daysMetGoal = 0;
+
+    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    {
+        loggedCalories += dailyCaloriesLog[i];
+
+        if (getSession(i).metCalorieGoal)
+            daysMetGoal++;
+    }
+
+    appendBatchText(output, name);
+    output += ',';
+    appendBatchText(output, favoriteProtein);
+
+    const int values[] = { static_cast<int>(goal) + 1, dailyCalories, mealsPerDay };
+    for (int value : values)
+    {
+        snprintf(number, sizeof(number), ",%d", value);
+        output += number;
+    }
+
+    snprintf(number, sizeof(number), ",%.2f", weeklyWorkoutHours);
+    output += number;
+
+    snprintf(number, sizeof(number), ",%d,%d", loggedCalories, daysMetGoal);
+    output += number;
+}
+
+// Macro targets and advice: the columns macroCacheEntry keeps
+void nutritionTracker::appendBatchTargetColumns(string& output) const
+{
+    char number[32];
+
+    const int results[] = { dailyProteinGrams, dailyCarbGrams, dailyFatGrams,
+        getProteinPerMeal(), getCarbsPerMeal(), getFatsPerMeal() };
+    for (int value : results)
+    {
+        snprintf(number, sizeof(number), ",%d", value);
+        output += number;
+    }
+
+    output += ',';
+    appendBatchText(output, getBatchAdvice(ADVICE_NUTRITION));
+    output += ',';
+    appendBatchText(output, getBatchAdvice(ADVICE_MEAL_FREQUENCY));
+}
+
+// Rows from a classified block reuse its advice IDs instead of classifying again
+const char* nutritionTracker::getBatchAdvice(AdviceCategory category) const
+{
+    if (adviceLoaded)
+        return getAdviceRules().getText((category == ADVICE_NUTRITION) ? nutritionAdviceId : mealAdviceId);
+
+    return (category == ADVICE_NUTRITION) ? getNutritionAdvice() : getMealFrequencyAdvice(mealsPerDay * NUMBER_OF_DAYS);
+}
+
+void nutritionTracker::loadMacroTargets(const macroCacheEntry& cached)
+{
+    dailyProteinGrams = cached.dailyProteinGrams;
+    dailyCarbGrams = cached.dailyCarbGrams;
+    dailyFatGrams = cached.dailyFatGrams;
+
+    weeklyCalories = 0;   // As calculateMacros() leaves it
+}
+
+bool nutritionTracker::fillMacroCacheEntry(macroCacheEntry& entry, string& scratch) const
+{
+    entry.dailyProteinGrams = dailyProteinGrams;
+    entry.dailyCarbGrams = dailyCarbGrams;
+    entry.dailyFatGrams = dailyFatGrams;
+    entry.proteinPerMeal = getProteinPerMeal();
+    entry.carbsPerMeal = getCarbsPerMeal();
+    entry.fatsPerMeal = getFatsPerMeal();
+    entry.nutritionAdvice = getBatchAdvice(ADVICE_NUTRITION);
+    entry.goalAdvice = getGoalAdvice();
+    entry.mealFrequencyAdvice = getBatchAdvice(ADVICE_MEAL_FREQUENCY);
+
+    scratch.clear();
+    appendBatchTargetColumns(scratch);
+
+    if (scratch.size() > sizeof(entry.resultColumns))
+        return false;
+
+    memcpy(entry.resultColumns, scratch.data(), scratch.size());
+    entry.resultLength = scratch.size();
+    return true;
+}
+
+
+// --------------------- Session History File ---------------------
+// A name that is already a safe lowercase file name is used as-is. Any other
+//    name gets its FNV-1a hash appended, so "Ann", "ann" and "A n" can't share
+//    a file on any file system. Plain names have no '_', so neither form can
+//    produce the other.
+string nutritionTracker::getSessionFilePath() const
+{
+    string path;
+    appendSafeFileName(path, name);
+
+    bool plainName = !name.empty() && path == name &&
+        none_of(name.begin(), name.end(), [](char c) { return isupper(static_cast<unsigned char>(c)) != 0; });
+
+    if (!plainName)
+    {
+        char hashText[24];
+        snprintf(hashText, sizeof(hashText), "_%016llx",
+            static_cast<unsigned long long>(hashSnapshotName(name)));
+        path += hashText;
+    }
+
+    path += "_sessions.bin";
+
+    return path;
+}
+
+void nutritionTracker::restoreSessionHistory()
+{
+    sessionFileView sessions;
+    restoredDays = 0;
+
+    // First session for this user: nothing to restore
+    if (!sessions.open(getSessionFilePath()))
+        return;
+
+    history.clear();
+    history.reserve(sessions.size() + NUMBER_OF_DAYS);
+
+    for (size_t i = 0; i < sessions.size(); i++)
+        history.append(static_cast<int>(sessions[i].calories));
+
+    restoredDays = static_cast<uint32_t>(sessions.size());
+
+    setConsoleColor(COLOR_SUB_HEADING);
+    cout << "Welcome back! Restored " << restoredDays << " days of calorie history.\n\n";
+    setConsoleColor(COLOR_DEFAULT);
+}
+
+bool nutritionTracker::saveWeeklySessions() const
+{
+    sessionRecord records[NUMBER_OF_DAYS];
+
+    // This week's days are the last NUMBER_OF_DAYS entries of the history
+    size_t firstDay = history.size() - NUMBER_OF_DAYS;
+
+    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    {
+        records[i].dayNumber = static_cast<uint32_t>(firstDay + i + 1);
+        records[i].calories = static_cast<uint32_t>(getSession(i).calories);
+        records[i].protein = static_cast<uint16_t>(dailyProteinGrams);
+        records[i].carbs = static_cast<uint16_t>(dailyCarbGrams);
+        records[i].fats = static_cast<uint16_t>(dailyFatGrams);
+        records[i].metCalorieGoal = getSession(i).metCalorieGoal;
+    }
+
+    // Targets too large for the 16-bit fields are not saved
+    bool fitsFormat = dailyProteinGrams <= UINT16_MAX &&
+        dailyCarbGrams <= UINT16_MAX &&
+        dailyFatGrams < SESSION_GOAL_FLAG;
+
+    if (!fitsFormat || !appendSessionRecords(getSessionFilePath(), records, NUMBER_OF_DAYS))
+    {
+        setConsoleColor(COLOR_ERROR);
+        cout << "Error: Unable to save your session history to " << getSessionFilePath() << "\n\n";
+        setConsoleColor(COLOR_DEFAULT);
+        return false;
+    }
+
+    return true;
+}
+
+
+// New function to fill 2D arrray added to program. Built when displayed
+//    from the per-meal targets; the meal plan shows what the foods add up to.
+void nutritionTracker::fillMacrosPerMeal2D(int grid[3][NUMBER_OF_DAYS]) const
+{
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+    {
+        grid[0][day] = getProteinPerMeal();
+        grid[1][day] = getCarbsPerMeal();
+        grid[2][day] = getFatsPerMeal();
+    }
+}
+
+// Every meal of the week shares the same target, so one (memoized) solve
+//    covers the whole plan; meals rotate through the best distinct options
+void nutritionTracker::planWeeklyMeals()
+{
+    buildMealPlan();
+}
+
+void nutritionTracker::buildMealPlan() const
+{
+    auto startTime = chrono::steady_clock::now();
+    vector<mealSolution> options = getMealPlanner().solveMeal(getProteinPerMeal(), getCarbsPerMeal(), getFatsPerMeal());
+
+    mealPlan.clear();
+
+    // Older journals and snapshots may hold any meal count; only plan ones the input allows
+    if (!options.empty() && mealsPerDay > 0 && mealsPerDay <= MAX_MEALS_PER_DAY)
+    {
+        mealPlan.resize(static_cast<size_t>(NUMBER_OF_DAYS) * mealsPerDay);
+
+        for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        {
+            for (int meal = 0; meal < mealsPerDay; meal++)
+                mealPlan[static_cast<size_t>(day) * mealsPerDay + meal] = options[(day + meal) % options.size()];
+        }
+    }
+
+    mealPlanMilliseconds = chrono::duration<float, milli>(chrono::steady_clock::now() - startTime).count();
+    staleDerived &= ~DERIVED_MEAL_PLAN;
+}
+
+
+// --------------------- Helpers ---------------------
+// The week just logged is the last NUMBER_OF_DAYS entries of the history,
+//    so the rolling window answers this without rescanning the array
+double nutritionTracker::calculateAverageCalories() const
+{
+    return getHistory().windowMean(NUMBER_OF_DAYS);
+}
+
+double nutritionTracker::calculateAverageFromArray(const int values[], int size) const
+{
+    long long sum = 0;   // long long so long histories cannot overflow
+
+    for (int i = 0; i < size; i++)
+        sum += values[i];
+
+    return static_cast<double>(sum) / size;
+}
+
+int nutritionTracker::findHighestCalories() const
+{
+    return getHistory().windowMax(NUMBER_OF_DAYS);
+}
+
+void nutritionTracker::evaluateMealFrequency(consoleFrame& frame, int mealsPerWeek) const
+{
+    frame << getMealFrequencyAdvice(mealsPerWeek) << " Try a recipe below!\n\n";
+}
+
+// Advice text is returned (not printed) so batch mode can reuse the same rules
+const char* nutritionTracker::getMealFrequencyAdvice(int mealsPerWeek) const
+{
+    const adviceRules& rules = getAdviceRules();
+    return rules.getText(rules.classify(ADVICE_MEAL_FREQUENCY, weeklyWorkoutHours, dailyCalories, mealsPerWeek));
+}
+
+void nutritionTracker::evaluateNutrition(consoleFrame& frame) const
+{
+    frame << getNutritionAdvice() << "\n\n";
+
+    // Additional guidance based on goal(enum used in switch)
+    frame << getGoalAdvice();
+}
+
+const char* nutritionTracker::getNutritionAdvice() const
+{
+    const adviceRules& rules = getAdviceRules();
+    return rules.getText(rules.classify(ADVICE_NUTRITION, weeklyWorkoutHours, dailyCalories,
+        mealsPerDay * NUMBER_OF_DAYS));
+}
+
+const char* nutritionTracker::getGoalAdvice() const
+{
+    switch (goal)
+    {
+    case FAT_LOSS:
+        return "Goal: Fat loss\n"
+            "Aim for a small, sustainable calorie deficit and prioritize protein.\n\n";
+    case MAINTENANCE:
+        return "Goal: Maintenance\n"
+            "Keep your calorie intake steady and focus on consistency.\n\n";
+    case MUSCLE_GAIN:
+        return "Goal: Muscle gain\n"
+            "Make sure you're in a slight calorie surplus and hitting your protein target.\n\n";
+    default:
+        return "";
+    }
+}
+
+
+// --------------------- Display / Output ---------------------
+void nutritionTracker::displayIntroBanner()
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_HEADER);
+    printSectionBreakLine(frame);
+
+    frame << left << setw(5) << " "
+        << " Welcome to the Vegetarian Nutrition for Weightlifters Program! "
+        << right << setw(5) << " " << "\n";
+
+    printSectionBreakLine(frame);
+    frame << "\nLet's learn more about you!\n\n";
+
+    frame.setColor(COLOR_DEFAULT);
+}
+
+void nutritionTracker::displayMenu() const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_HEADER);
+    printSectionBreakLine(frame);
+    frame << "1. View Daily Macro Targets\n"
+        << "2. Generate Full Nutrition Report\n"
+        << "3. Nutrition Check & Recipe Unlock\n"
+        << "4. View Weekly Calorie Log\n"
+        << "5. View Weekly Nutrition Sessions\n"
+        << "6. View Macros Per Meal (2D Table)\n"   // New menu option
+        << "7. Start a New User Session\n"
+        << "8. Query Calorie History Range\n"
+        << "9. View Performance Stats\n"
+        << "10. View Weekly Meal Plan\n"
+        << "11. Edit a Day's Calories or Meals per Day\n"
+        << "12. Exit Program\n\n";
+    frame.setColor(COLOR_DEFAULT);
+}
+
+void nutritionTracker::displayDailyMacros() const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "You chose to view your suggested daily macros!\n\n";
+    frame.setColor(COLOR_DEFAULT);
+
+    frame << "Here is the information you provided:\n";
+    frame << left << setw(50) << setfill('.') << "Favorite protein source: " << right << favoriteProtein << "\n";
+    frame << left << setw(50) << setfill('.') << "Daily calorie target: " << right << dailyCalories << "\n";
+    frame << left << setw(50) << setfill('.') << "Meals per day: " << right << mealsPerDay << "\n";
+    frame << left << setw(50) << setfill('.') << "Weekly workout hours: " << right << weeklyWorkoutHours << "\n\n";
+
+    frame << "Suggested daily macros:\n";
+    frame << left << setw(50) << setfill('.') << "Protein: " << right << dailyProteinGrams << " grams\n";
+    frame << left << setw(50) << setfill('.') << "Carbs: " << right << dailyCarbGrams << " grams\n";
+    frame << left << setw(50) << setfill('.') << "Fats: " << right << dailyFatGrams << " grams\n\n";
+
+    frame << "Per meal macro targets:\n";
+    frame << left << setw(50) << setfill('.') << "Protein grams per meal: " << right << getProteinPerMeal() << "\n";
+    frame << left << setw(50) << setfill('.') << "Carbs grams per meal: " << right << getCarbsPerMeal() << "\n";
+    frame << left << setw(50) << setfill('.') << "Fats grams per meal: " << right << getFatsPerMeal() << "\n";
+    frame << setfill(' ');
+
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "Keep fueling with " << favoriteProtein << " to hit " << dailyProteinGrams << " grams of protein daily!\n";
+    frame << "Remember your " << weeklyWorkoutHours << " hours of weightlifting per week...\n";
+    frame << "Keep lifting heavy, " << name << "!\n\n";
+    frame.setColor(COLOR_DEFAULT);
+}
+ 
+void nutritionTracker::generateReport(bool writeFile) const
+{
+    // Abosrbed previous previous programming assignment's 
+    //    processReportGeneration function for simplification
+    setConsoleColor(COLOR_SUB_HEADING);
+    printSectionBreakLine();
+    cout << "You chose to generate a report of your suggested " << "daily and weekly macros!\n";
+    if (writeFile)
+        cout << "Open 'report.txt' to view, save, or print it.\n\n";
+    else
+        cout << "Here it is to view, save, or print.\n\n";
+    printSectionBreakLine();
+    setConsoleColor(COLOR_DEFAULT);
+
+
+    // Render the whole report, then write it with one call
+    reportBuffer report;
+    {
+        TRACK_STAGE(STAGE_REPORT_RENDER);
+        renderReport(report);
+    }
+
+    if (!writeFile)
+    {
+        cout << "\n" << report.str() << "\n";
+        return;
+    }
+
+    TRACK_STAGE(STAGE_REPORT_FILE_IO);
+    ofstream outFile("report.txt");
+
+    if (!outFile)
+    {
+        setConsoleColor(COLOR_ERROR);
+        cout << "Error: Unable to open report.txt\n";
+        setConsoleColor(COLOR_DEFAULT);
+        return;
+    }
+
+    outFile.write(report.str().data(), report.str().size());
+    outFile.close();
+
+    COUNT_EVENT(COUNTER_REPORTS_WRITTEN, 1);
+    COUNT_EVENT(COUNTER_REPORT_BYTES, static_cast<long long>(report.str().size()));
+
+    // Confirm report generation in console using green success message
+    setConsoleColor(COLOR_SUB_HEADING);
+    cout << "Report successfully generated: report.txt\n\n";
+    setConsoleColor(COLOR_DEFAULT);
+}
+
+// Same layout the setw/setfill version of generateReport() produced
+void nutritionTracker::renderReport(reportBuffer& report) const
+{
+    // Calculate macro calories per day for the report
+    int dailyProteinCalories = dailyProteinGrams * CALORIES_PER_GRAM_PROTEIN;
+    int dailyCarbCalories = dailyCarbGrams * CALORIES_PER_GRAM_CARBS;
+    int dailyFatCalories = dailyFatGrams * CALORIES_PER_GRAM_FAT;
+
+    report.clear();
+
+    // Report header
+    report.appendRule();
+    report.append("Vegetarian Nutrition for Weightlifters Report\n");
+    report.appendRule();
+    report.append("\n");
+
+    report.append("Information you provided:\n");
+    report.appendLeader("Favorite protein source: ");
+    report.append(favoriteProtein);
+    report.append("\n");
+    report.appendLeader("Daily calorie target: ");
+    report.appendInt(dailyCalories);
+    report.append("\n");
+    report.appendLeader("Weekly calorie target: ");
+    report.appendInt(weeklyCalories);
+    report.append("\n");
+    report.appendLeader("Meals per day: ");
+    report.appendInt(mealsPerDay);
+    report.append("\n");
+    report.appendLeader("Weekly workout hours: ");
+    report.appendFixed2(weeklyWorkoutHours);
+    report.append("\n\n");
+
+    // Weekly totals
+    report.append("Suggested weekly macros:\n");
+    report.appendLeader("Protein: ");
+    report.appendInt(getWeeklyProteinGrams());
+    report.append(" grams\n");
+    report.appendLeader("Carbs: ");
+    report.appendInt(getWeeklyCarbGrams());
+    report.append(" grams\n");
+    report.appendLeader("Fats: ");
+    report.appendInt(getWeeklyFatGrams());
+    report.append(" grams\n\n");
+
+    // Daily macros
+    report.append("Suggested total daily macros:\n");
+    report.appendLeader("Protein: ");
+    report.appendInt(dailyProteinGrams);
+    report.append(" grams (");
+    report.appendInt(dailyProteinCalories);
+    report.append(" cal)\n");
+    report.appendLeader("Carbs: ");
+    report.appendInt(dailyCarbGrams);
+    report.append(" grams (");
+    report.appendInt(dailyCarbCalories);
+    report.append(" cal)\n");
+    report.appendLeader("Fats: ");
+    report.appendInt(dailyFatGrams);
+    report.append(" grams (");
+    report.appendInt(dailyFatCalories);
+    report.append(" cal)\n\n");
+
+    // Per-meal macros
+    report.append("Per meal macro targets:\n");
+    report.appendLeader("Protein grams per meal: ");
+    report.appendInt(getProteinPerMeal());
+    report.append("\n");
+    report.appendLeader("Carbs grams per meal: ");
+    report.appendInt(getCarbsPerMeal());
+    report.append("\n");
+    report.appendLeader("Fats grams per meal:  ");
+    report.appendInt(getFatsPerMeal());
+    report.append("\n\n");
+
+    report.appendRule();
+    report.append("Keep fueling with ");
+    report.append(favoriteProtein);
+    report.append(" to hit ");
+    report.appendInt(dailyProteinGrams);
+    report.append(" grams of protein daily!\n");
+    report.append("Remember your ");
+    report.appendFixed2(weeklyWorkoutHours);
+    report.append(" hours of weightlifting per week...\n");
+    report.append("Keep lifting heavy, ");
+    report.append(name);
+    report.append("!\n\n");
+}
+
+void nutritionTracker::displayWeeklyCalorieLog() const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "Your Weekly Calorie Log:\n\n";
+    frame.setColor(COLOR_DEFAULT);
+
+    if (dailyCaloriesLog[0] == 0)
+    {
+        frame << "No calorie data entered yet.\n";
+        return;
+    }
+
+    frame << left << setw(10) << "Day" << right << setw(19) << "Calories\n";
+    printSectionBreakLine(frame);
+
+    for (int day = 0; day < NUMBER_OF_DAYS; ++day)
+    {
+        frame << left << setw(10) << (day + 1) << right << setw(15) << dailyCaloriesLog[day] << "\n";
+    }
+
+    frame << "\n\n";
+
+    double averageCalories = calculateAverageCalories();
+    int highestCalories = findHighestCalories();
+
+    frame << "Average daily calories this week: " << static_cast<int>(averageCalories) << "\n";
+    frame << "Highest daily calories this week: " << highestCalories << "\n\n";
+
+    // Longer rolling windows once there is more than a week of history
+    const calorieHistory& loggedHistory = getHistory();
+    if (loggedHistory.size() > static_cast<size_t>(NUMBER_OF_DAYS))
+    {
+        frame << "Days logged: " << loggedHistory.size() << "\n";
+
+        for (int window : ROLLING_WINDOWS)
+        {
+            frame << "Last " << window << " days - average: " << static_cast<int>(loggedHistory.windowMean(window))
+                << ", highest: " << loggedHistory.windowMax(window) << "\n";
+        }
+
+        frame << "\n";
+    }
+
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame.setColor(COLOR_DEFAULT);
+    frame << "\n";
+
+}
+
+void nutritionTracker::displayWeeklySessions() const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "Your Weekly Nutrition Summary:\n\n";
+    frame.setColor(COLOR_DEFAULT);
+
+    frame << left << setw(10) << "Day"
+        << setw(12) << "Calories"
+        << setw(10) << "Protein"
+        << setw(10) << "Carbs"
+        << setw(10) << "Fats"
+        << setw(15) << "Calorie Goal?\n";
+
+    printSectionBreakLine(frame);
+
+    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    {
+        const nutritionSession& session = getSession(i);
+        frame << left << setw(10) << DAY_LABELS[session.day]
+            << setw(12) << session.calories
+            << setw(10) << dailyProteinGrams
+            << setw(10) << dailyCarbGrams
+            << setw(10) << dailyFatGrams
+            << setw(15) << (session.metCalorieGoal ? "Yes" : "No")   // If bool is true, returns yes, otherwise returns No
+            << "\n";
+    }
+
+    frame << "\n";
+
+    const calorieHistory& loggedHistory = getHistory();
+    if (loggedHistory.size() > static_cast<size_t>(NUMBER_OF_DAYS))
+    {
+        frame << "Rolling average calories (7 / 30 / 90 days): ";
+
+        for (int i = 0; i < ROLLING_WINDOW_COUNT; i++)
+        {
+            frame << (i > 0 ? " / " : "") << static_cast<int>(loggedHistory.windowMean(ROLLING_WINDOWS[i]));
+        }
+
+        frame << "\n\n";
+    }
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame.setColor(COLOR_DEFAULT);
+    frame << "\n";
+}
+
+void nutritionTracker::displayNutritionCheckAndRecipe() const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "Checking your calorie intake vs activity level...\n\n";
+    frame.setColor(COLOR_DEFAULT);
+
+    // Calories vs. activity and goal guidance
+    evaluateNutrition(frame);
+
+    // Calculate meals per week before evaluating meal frequency
+    int mealsPerWeek = mealsPerDay * NUMBER_OF_DAYS;
+    evaluateMealFrequency(frame, mealsPerWeek);
+
+    // Display recipe
+    displayRecipeMatches(frame);
+}
+
+// New function to display menu option 4 (2D array of per meal macros)
+void nutritionTracker::displayMacrosPerMeal2D() const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "Per-Meal Macros by Day (grams per meal)\n\n";
+    frame << "All values below represent how your daily macros are\n";
+    frame << "distributed evenly across each meal.\n\n";
+    frame.setColor(COLOR_DEFAULT);
+
+    int macrosPerMeal2D[3][NUMBER_OF_DAYS];
+    fillMacrosPerMeal2D(macrosPerMeal2D);
+
+    // ----- Header Row -----
+    frame << left << setw(10) << "Macro";
+    for (int day = 1; day <= NUMBER_OF_DAYS; day++)
+        frame << setw(8) << day;
+    frame << "\n";
+
+    printSectionBreakLine(frame);
+
+    // ----- Protein Row -----
+    frame << left << setw(10) << "Protein";
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        frame << setw(8) << macrosPerMeal2D[0][day];
+    frame << "\n";
+
+    // ----- Carb Row -----
+    frame << left << setw(10) << "Carbs";
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        frame << setw(8) << macrosPerMeal2D[1][day];
+    frame << "\n";
+
+    // ----- Fat Row -----
+    frame << left << setw(10) << "Fats";
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        frame << setw(8) << macrosPerMeal2D[2][day];
+    frame << "\n\n";
+
+    // ----- Goal-Based Messaging Using Enum -----
+    switch (goal)
+    {
+    case FAT_LOSS:
+        frame << "Fat Loss Tip: Keep protein consistent at each meal\n";
+        frame << "to support muscle retention while in a calorie deficit.\n";
+        break;
+
+    case MAINTENANCE:
+        frame << "Maintenance Tip: These balanced macros support steady\n";
+        frame << "energy and recovery throughout the week.\n";
+        break;
+
+    case MUSCLE_GAIN:
+        frame << "Muscle Gain Tip: Try placing higher-carb meals around\n";
+        frame << "your workouts to support strength and recovery.\n";
+        break;
+    }
+
+    frame << "\nBased on " << mealsPerDay << " meals per day.\n\n";
+}
+
+sessionTask nutritionTracker::displayCalorieRangeQuery(sessionInput& input)
+{
+    setConsoleColor(COLOR_SUB_HEADING);
+    printSectionBreakLine();
+    cout << "Calorie History Range Query\n\n";
+    setConsoleColor(COLOR_DEFAULT);
+
+    const calorieRangeIndex& ranges = getHistory().ranges();
+
+    if (ranges.size() == 0)
+    {
+        cout << "No calorie data entered yet.\n\n";
+        co_return;
+    }
+
+    cout << "Your history has " << ranges.size() << " days.\n\n";
+
+    int firstDay = 0;
+    int lastDay = 0;
+    co_await getValidatedIntInput(input, "First day of the range: ", firstDay);
+    co_await getValidatedIntInput(input, "Last day of the range: ", lastDay);
+
+    // Repeat until the range fits inside the history
+    while (firstDay < 1 || firstDay > lastDay || static_cast<size_t>(lastDay) > ranges.size())
     {
-        clearInputStream();
         setConsoleColor(COLOR_ERROR);
-        cout << "That is not a valid answer. Please enter a positive number: ";
+        cout << "Please enter a range between day 1 and day " << ranges.size() << ".\n\n";
+        setConsoleColor(COLOR_DEFAULT);
+
+        co_await getValidatedIntInput(input, "First day of the range: ", firstDay);
+        co_await getValidatedIntInput(input, "Last day of the range: ", lastDay);
+    }
+
+    size_t first = firstDay - 1;
+    size_t last = lastDay - 1;
+
+    cout << "Days " << firstDay << " to " << lastDay << ":\n";
+    cout << left << setw(50) << setfill('.') << "Total calories: " << right << ranges.rangeSum(first, last) << "\n";
+    cout << left << setw(50) << setfill('.') << "Average calories: " << right << static_cast<int>(ranges.rangeMean(first, last)) << "\n";
+    cout << left << setw(50) << setfill('.') << "Highest calories: " << right << ranges.rangeMax(first, last) << "\n";
+    cout << left << setw(50) << setfill('.') << "Lowest calories: " << right << ranges.rangeMin(first, last) << "\n\n";
+    cout << setfill(' ');
+}
+
+void nutritionTracker::displayPerformanceStats(bool writeFile) const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "Performance Stats (this program run)\n\n";
+    frame.setColor(COLOR_DEFAULT);
+
+#if TRACKER_INSTRUMENTATION
+    metrics.printStats(frame, false);
+
+    if (!writeFile)
+    {
+        frame << "\n";
+        return;
+    }
+
+    ofstream outFile(METRICS_FILE);
+
+    if (!outFile)
+    {
+        frame.setColor(COLOR_ERROR);
+        frame << "Error: Unable to open " << METRICS_FILE << "\n\n";
+        frame.setColor(COLOR_DEFAULT);
+        return;
+    }
+
+    metrics.printStats(outFile, true);
+
+    frame.setColor(COLOR_SUB_HEADING);
+    frame << "\nFull stats with latency histograms saved to " << METRICS_FILE << "\n\n";
+    frame.setColor(COLOR_DEFAULT);
+#else
+    (void)writeFile;
+    frame << "Instrumentation is turned off in this build (TRACKER_INSTRUMENTATION=0).\n\n";
+#endif
+}
+
+void nutritionTracker::displayMealPlan() const
+{
+    consoleFrame frame;
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame << "Your Weekly Meal Plan\n\n";
+    frame << "Target per meal: Protein " << getProteinPerMeal() << "g | Carbs " << getCarbsPerMeal()
+        << "g | Fat " << getFatsPerMeal() << "g\n\n";
+    frame.setColor(COLOR_DEFAULT);
+
+    const vector<mealSolution>& plan = getMealPlan();
+
+    if (plan.empty())
+    {
+        frame << "No meal plan available.\n\n";
+        return;
+    }
+
+    const recipeCatalog& catalog = getRecipeCatalog();
+    static const char* const portionNames[MEAL_PLAN_MAX_HALF_SERVINGS + 1] = { "0", "1/2", "1", "1 1/2", "2" };
+    int mealsOnTarget = 0;
+
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+    {
+        frame << "Day " << (day + 1) << ":\n";
+        float dayTotals[3] = { 0.0f, 0.0f, 0.0f };
+
+        for (int meal = 0; meal < mealsPerDay; meal++)
+        {
+            const mealSolution& planned = plan[static_cast<size_t>(day) * mealsPerDay + meal];
+            dayTotals[0] += planned.protein;
+            dayTotals[1] += planned.carbs;
+            dayTotals[2] += planned.fat;
+            bool onTarget = fabs(planned.protein - getProteinPerMeal()) <= MEAL_PLAN_TOLERANCE &&
+                fabs(planned.carbs - getCarbsPerMeal()) <= MEAL_PLAN_TOLERANCE &&
+                fabs(planned.fat - getFatsPerMeal()) <= MEAL_PLAN_TOLERANCE;
+            mealsOnTarget += onTarget ? 1 : 0;
+
+            frame << "  Meal " << (meal + 1) << ": ";
+            for (int i = 0; i < planned.portionCount; i++)
+            {
+                frame << (i > 0 ? " + " : "") << portionNames[planned.portions[i].halfServings]
+                    << " x " << catalog[planned.portions[i].recipe].name;
+            }
+
+            frame << fixed << setprecision(0) << " (P " << planned.protein << " / C " << planned.carbs
+                << " / F " << planned.fat << ")" << (onTarget ? "" : " *") << "\n";
+        }
+
+        frame << "  Average per meal: P " << lround(dayTotals[0] / mealsPerDay) << " / C "
+            << lround(dayTotals[1] / mealsPerDay) << " / F " << lround(dayTotals[2] / mealsPerDay) << "\n\n";
+    }
+
+    frame << mealsOnTarget << " of " << plan.size() << " meals are within " << MEAL_PLAN_TOLERANCE
+        << "g of every target (* = outside).\n";
+    frame << setprecision(2) << "Plan built in " << mealPlanMilliseconds << " ms.\n\n";
+
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame.setColor(COLOR_DEFAULT);
+    frame << "\n";
+}
+
+sessionTask nutritionTracker::editWeeklyInput(sessionInput& input)
+{
+    setConsoleColor(COLOR_SUB_HEADING);
+    printSectionBreakLine();
+    cout << "Edit Your Week\n\n";
+    setConsoleColor(COLOR_DEFAULT);
+
+    cout << "  1. One day's calories\n"
+        << "  2. Meals per day\n\n";
+    int choice = 0;
+    co_await getValidatedIntInput(input, "What would you like to change? ", choice);
+
+    while (choice < 1 || choice > 2)
+    {
+        setConsoleColor(COLOR_ERROR);
+        cout << "That is not a valid choice. Please enter 1 or 2.\n\n";
         setConsoleColor(COLOR_DEFAULT);
 
-        cin >> value;
-        cout << endl;
+        co_await getValidatedIntInput(input, "What would you like to change? ", choice);
+    }
+
+    int pendingBefore = countStaleValues();
+
+    if (choice == 1)
+    {
+        int day = 0;
+        co_await getValidatedIntInput(input, "Which day (1-7)? ", day);
+
+        while (day < 1 || day > NUMBER_OF_DAYS)
+        {
+            setConsoleColor(COLOR_ERROR);
+            cout << "Please enter a day from 1 to " << NUMBER_OF_DAYS << ".\n\n";
+            setConsoleColor(COLOR_DEFAULT);
+
+            co_await getValidatedIntInput(input, "Which day (1-7)? ", day);
+        }
+
+        int calories = 0;
+        co_await getCaloriesInput(input, "New total calories for that day: ", calories);
+        setDayCalories(day - 1, calories);
+        waitForJournal(appendToJournal(JOURNAL_EDIT_DAY, day - 1, dailyCaloriesLog[day - 1]));
+        cout << "Day " << day << " updated. Its session and your calorie history will be\n"
+            << "recomputed the next time they are shown; nothing else changes.\n\n";
+    }
+    else
+    {
+        int meals = 0;
+        co_await getMealsPerDayInput(input, meals);
+        setMealsPerDay(meals);
+        waitForJournal(appendToJournal(JOURNAL_MEALS_PER_DAY));
+        cout << "Meals per day updated. Your per-meal targets are recalculated and your\n"
+            << "meal plan will be rebuilt the next time it is shown.\n\n";
+    }
+
+    int pendingAfter = countStaleValues();
+
+    cout << "Derived values waiting to be recomputed: " << pendingAfter << " of " << DERIVED_VALUE_COUNT
+        << " (" << (pendingAfter - pendingBefore) << " new)\n\n";
+}
+
+// Recipes closest to this user's per-meal macros, preferring their favorite protein
+void nutritionTracker::displayRecipeMatches(consoleFrame& frame) const
+{
+    const recipeCatalog& catalog = getRecipeCatalog();
+    uint32_t matches[RECIPE_MATCH_COUNT];
+    bool sameProtein = catalog.hasProteinSource(favoriteProtein);
+    size_t found = catalog.findNearest(getProteinPerMeal(), getCarbsPerMeal(), getFatsPerMeal(),
+        sameProtein ? string_view(favoriteProtein) : string_view(), RECIPE_MATCH_COUNT, matches);
+
+    frame.setColor(COLOR_RECIPE);
+    frame << "Closest recipes to your per-meal targets (Protein: " << getProteinPerMeal() << "g | Carbs: "
+        << getCarbsPerMeal() << "g | Fat: " << getFatsPerMeal() << "g)";
+    if (sameProtein)
+        frame << " made with " << favoriteProtein;
+    frame << ":\n\n";
+
+    for (size_t i = 0; i < found; i++)
+    {
+        const recipeEntry& recipe = catalog[matches[i]];
+        frame << recipe.name << " Recipe:\n";
+
+        // One line per ';' separated ingredient
+        string_view ingredients = recipe.ingredients;
+        while (!ingredients.empty())
+        {
+            size_t separator = ingredients.find(';');
+            frame << "- " << trimBatchField(ingredients.substr(0, separator)) << "\n";
+            ingredients.remove_prefix(separator == string_view::npos ? ingredients.size() : separator + 1);
+        }
+
+        frame << "\n";
+        if (!recipe.method.empty())
+            frame << recipe.method << "\n";
+        frame << "Protein: " << recipe.protein << "g | Carbs: " << recipe.carbs << "g | Fat: " << recipe.fat << "g\n\n";
+    }
+
+    frame.setColor(COLOR_SUB_HEADING);
+    printSectionBreakLine(frame);
+    frame.setColor(COLOR_DEFAULT);
+    frame << "\n";
+}
+
+
+// --------------------- Batch Mode ---------------------
+int runBatchMode(const batchOptions& options)
+{
+    const string& inputPath = options.inputPath;
+    const string& outputPath = options.outputPath;
+    mappedFile inFile;
+
+    if (!inFile.open(inputPath))
+    {
+        cerr << "Error: Unable to open " << inputPath << "\n";
+        return 1;
+    }
+
+    ofstream outFile(outputPath, ios::binary);
+
+    if (!outFile)
+    {
+        cerr << "Error: Unable to open " << outputPath << "\n";
+        return 1;
+    }
+
+    // Text mode, like report.txt
+    ofstream reportFile;
+
+    if (!options.reportFile.empty())
+    {
+        reportFile.open(options.reportFile);
+
+        if (!reportFile)
+        {
+            cerr << "Error: Unable to open " << options.reportFile << "\n";
+            return 1;
+        }
+    }
+
+    auto startTime = chrono::steady_clock::now();
+
+    // Candidate rules are swapped in before any worker reads advice
+    if (!options.rulesPath.empty() && !getAdviceRules().load(options.rulesPath))
+    {
+        cerr << "Error: Unable to load advice rules from " << options.rulesPath << "\n";
+        return 1;
+    }
+
+    const adviceRules& rules = getAdviceRules();
+    vector<long long> adviceCounts(rules.size() + 1, 0);
+
+    // The default thread count reuses the shared pool instead of starting more threads
+    unique_ptr<workStealingPool> ownPool;
+
+    if (options.threadCount != getSharedPool().size())
+        ownPool = make_unique<workStealingPool>(options.threadCount);
+
+    workStealingPool& pool = ownPool ? *ownPool : getSharedPool();
+    vector<batchWorker> workers(pool.size());
+    reportFileNames reportNames;
+    vector<batchBlock> blocks(pool.size() * BATCH_BLOCKS_PER_WORKER);
+
+    outFile << "name,favorite_protein,goal,daily_calories,meals_per_day,weekly_workout_hours,"
+        "logged_calories,days_met_goal,protein_grams,carb_grams,fat_grams,"
+        "protein_per_meal,carbs_per_meal,fats_per_meal,nutrition_advice,meal_advice\n";
+
+    uint64_t fileSize = inFile.size();
+    uint64_t offset = 0;
+
+    // Room for every name in all but huge runs, so claims don't grow the table
+    if (!options.reportDirectory.empty())
+        reportNames.reserve(static_cast<size_t>(min<uint64_t>(fileSize / BATCH_MIN_ROW_BYTES, REPORT_NAMES_MAX_RESERVED)));
+
+    long long processedCount = 0;
+    long long rejectedCount = 0;
+    long long reportFailures = 0;
+    double reportSeconds = 0.0;
+    size_t windowBytes = blocks.size() * BATCH_BLOCK_BYTES;
+
+    while (offset < fileSize)
+    {
+        // Map the next window, ending on a line boundary unless it reaches end of file
+        size_t length = static_cast<size_t>(min<uint64_t>(windowBytes, fileSize - offset));
+        const char* window = inFile.map(offset, length);
+
+        if (window == nullptr)
+        {
+            cerr << "Error: Unable to map " << inputPath << "\n";
+            return 1;
+        }
+
+        if (offset + length < fileSize)
+        {
+            const char* lastNewline = static_cast<const char*>(memrchr_portable(window, '\n', length));
+
+            // A single line longer than the window: map a bigger window and retry
+            if (lastNewline == nullptr)
+            {
+                windowBytes *= 2;
+                continue;
+            }
+
+            length = lastNewline - window + 1;
+        }
+
+        // Split the window into blocks on line boundaries
+        const char* position = window;
+        const char* windowEnd = window + length;
+        size_t blockCount = 0;
+
+        while (position < windowEnd)
+        {
+            batchBlock& block = blocks[blockCount++];
+            const char* blockEnd = position + min<size_t>(BATCH_BLOCK_BYTES, windowEnd - position);
+
+            // Last block takes the rest of the window
+            if (blockCount == blocks.size())
+                blockEnd = windowEnd;
+
+            while (blockEnd < windowEnd && blockEnd[-1] != '\n')
+                blockEnd++;
+
+            block.begin = position;
+            block.end = blockEnd;
+            block.fileOffset = offset + (position - window);
+            position = blockEnd;
+        }
+
+        pool.run(blockCount, [&](size_t task, int worker)
+            {
+                return processBatchBlock(blocks[task], workers[worker], options, &reportNames);
+            });
+
+        // Merge per-block results in input order so output is deterministic
+        for (size_t i = 0; i < blockCount; i++)
+        {
+            cerr << blocks[i].errors;
+            outFile.write(blocks[i].output.data(), blocks[i].output.size());
+            processedCount += blocks[i].count;
+            rejectedCount += blocks[i].rejectedCount;
+            reportFailures += blocks[i].reportFailures;
+            reportSeconds += blocks[i].reportSeconds;
+
+            for (size_t id = 0; id < blocks[i].adviceCounts.size(); id++)
+                adviceCounts[id] += blocks[i].adviceCounts[id];
+
+            if (reportFile.is_open())
+            {
+                auto writeStart = chrono::steady_clock::now();
+                reportFile.write(blocks[i].reports.data(), blocks[i].reports.size());
+                reportSeconds += chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+            }
+        }
+
+        offset += length;
+    }
+
+    outFile.close();
+
+    if (!outFile)
+    {
+        cerr << "Error: Unable to write " << outputPath << "\n";
+        return 1;
+    }
+
+    if (reportFile.is_open())
+    {
+        reportFile.close();
+
+        if (!reportFile)
+        {
+            cerr << "Error: Unable to write " << options.reportFile << "\n";
+            return 1;
+        }
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    cout << "Processed " << processedCount << " profiles (" << rejectedCount << " rejected) in "
+        << fixed << setprecision(3) << seconds << " s";
+    if (seconds > 0.0)
+        cout << " (" << static_cast<long long>(processedCount / seconds) << " profiles/s)";
+    cout << " using " << pool.size() << " threads\n";
+
+    if (!options.reportFile.empty() || !options.reportDirectory.empty())
+    {
+        // Reports per second of worker time spent rendering and writing them
+        cout << "Rendered " << processedCount << " reports";
+        if (reportSeconds > 0.0)
+            cout << " (" << static_cast<long long>(processedCount / reportSeconds) << " reports/s)";
+        if (reportFailures > 0)
+            cout << ", " << reportFailures << " could not be written";
+        cout << "\n";
+
+        if (reportNames.getRenamed() > 0)
+        {
+            cout << reportNames.getRenamed() << " reports were given a numbered file name because another "
+                "profile's name maps to the same file\n";
+        }
+    }
+
+    // How often each rule fired across the whole population
+    cout << "Advice given (rules from " << rules.getSource() << "):\n";
+    for (size_t id = 0; id <= rules.size(); id++)
+    {
+        if (id == rules.size() && adviceCounts[id] == 0)
+            break;
+
+        const char* category = (id == rules.size()) ? "none" :
+            (rules[id].category == ADVICE_NUTRITION) ? "nutrition" : "meals";
+        cout << right << setw(12) << adviceCounts[id] << "  " << left << setw(10) << category
+            << ((id == rules.size()) ? "(no rule matched)" : rules[id].text.c_str()) << "\n";
+    }
+    cout << right;
+
+    const macroCache& cache = getMacroCache();
+    cout << "Macro cache: " << cache.getHits() << " hits, " << cache.getMisses() << " misses, "
+        << cache.getEvictions() << " evictions\n";
+
+    pool.printWorkerStats(cout);
+
+    return 0;
+}
+
+// Parses, computes and formats one block (runs on a pool worker)
+size_t processBatchBlock(batchBlock& block, batchWorker& worker, const batchOptions& options,
+    reportFileNames* reportNames)
+{
+    block.count = 0;
+    block.rejectedCount = 0;
+    block.reportFailures = 0;
+    block.reportSeconds = 0.0;
+    block.output.clear();
+    block.reports.clear();
+    block.errors.clear();
+
+    size_t lineCount = 0;
+    const char* position = block.begin;
+
+    while (position < block.end)
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(position, '\n', block.end - position));
+        if (lineEnd == nullptr)
+            lineEnd = block.end;
+
+        string_view line(position, lineEnd - position);
+        uint64_t byteOffset = block.fileOffset + (position - block.begin);
+        position = lineEnd + 1;
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        // Skip blank lines and an optional header row
+        if (line.empty() || (byteOffset == 0 && isBatchHeader(line)))
+            continue;
+
+        lineCount++;
+        block.reserveRows(block.count + 1);
+
+        if (parseBatchLine(line, byteOffset, block))
+            block.count++;
+        else
+            block.rejectedCount++;
+    }
+
+    // Macro targets and advice IDs for the whole block at once
+    calculateMacrosColumns(block.columns, 0, block.count);
+
+    const adviceRules& rules = getAdviceRules();
+    rules.classifyColumns(block.columns, 0, block.count);
+
+    size_t noAdvice = rules.size();
+    block.adviceCounts.assign(noAdvice + 1, 0);
+
+    for (size_t i = 0; i < block.count; i++)
+    {
+        block.adviceCounts[min<size_t>(block.columns.nutritionAdvice[i], noAdvice)]++;
+        block.adviceCounts[min<size_t>(block.columns.mealAdvice[i], noAdvice)]++;
+    }
+
+    // Rest of the pipeline main() runs for an interactive session
+    nutritionTracker& tracker = worker.tracker;
+    const profileColumns& columns = block.columns;
+
+    macroCache& cache = getMacroCache();
+
+    for (size_t i = 0; i < block.count; i++)
+    {
+        tracker.loadProfile(block.names[i], block.proteins[i], columns.dailyCalories[i],
+            columns.mealsPerDay[i], columns.weeklyWorkoutHours[i],
+            static_cast<GoalType>(columns.goal[i]));
+        tracker.loadDailyCalories(&block.caloriesLog[i * NUMBER_OF_DAYS]);
+
+        // Repeated (calories, meals, hours, goal) reuse targets and rendered advice
+        macroCacheKey key = makeMacroCacheKey(columns.dailyCalories[i], columns.mealsPerDay[i],
+            columns.weeklyWorkoutHours[i], columns.goal[i]);
+        bool cached = cache.find(key, worker.cached);
+
+        if (cached)
+        {
+            tracker.loadMacroTargets(worker.cached);
+        }
+        else
+        {
+            tracker.loadMacroTargets(columns, i);
+            cached = tracker.fillMacroCacheEntry(worker.cached, worker.resultColumns);
+            if (cached)
+                cache.insert(key, worker.cached);
+        }
+
+        tracker.fillSessionsFromCalories();
+
+        if (cached)
+            tracker.appendBatchResult(block.output, worker.cached);
+        else
+            tracker.appendBatchResult(block.output);
+
+        if (!options.reportFile.empty() || !options.reportDirectory.empty())
+        {
+            auto reportStart = chrono::steady_clock::now();
+            tracker.renderReport(worker.report);
+
+            if (!options.reportFile.empty())
+                block.reports += worker.report.str();
+
+            if (!options.reportDirectory.empty())
+            {
+                // <folder>/<name>.txt, or <name>_2.txt if another report has that file
+                worker.reportPath = options.reportDirectory;
+                worker.reportPath += '/';
+                size_t nameStart = worker.reportPath.size();
+                appendSafeFileName(worker.reportPath, tracker.getName());
+                reportNames->claim(worker.reportPath, nameStart, worker.reportName);
+                worker.reportPath += ".txt";
+
+                if (!writeReportFile(worker.reportPath, worker.report.str()))
+                    block.reportFailures++;
+            }
+
+            block.reportSeconds += chrono::duration<double>(chrono::steady_clock::now() - reportStart).count();
+        }
+    }
+
+    return lineCount;
+}
+
+void reportFileNames::reserve(size_t names)
+{
+    lock_guard<mutex> guard(lock);
+    size_t slotCount = REPORT_NAMES_MIN_SLOTS;
+
+    while (slotCount < names * 2)
+        slotCount *= 2;
+
+    if (slotCount > slots.size())
+        grow(slotCount);
+
+    text.reserve(names * REPORT_NAME_RESERVE_BYTES);
+}
+
+void reportFileNames::clear()
+{
+    lock_guard<mutex> guard(lock);
+    slots.assign(slots.size(), nameSlot());
+    text.clear();
+    count = 0;
+    renamed = 0;
+}
+
+void reportFileNames::claim(string& path, size_t nameStart, string& name)
+{
+    name.assign(path, nameStart, string::npos);
+    transform(name.begin(), name.end(), name.begin(),
+        [](unsigned char c) { return static_cast<char>(tolower(c)); });
+
+    lock_guard<mutex> guard(lock);
+
+    // Each claim adds one name, so growing first keeps slot indexes valid below
+    if ((count + 1) * 2 > slots.size())
+        grow(max(REPORT_NAMES_MIN_SLOTS, slots.size() * 2));
+
+    size_t slot = find(name);
+
+    if (!slots[slot].used)
+    {
+        insert(slot, name);
+        return;
+    }
+
+    // "john_smith_2" may itself be someone's name, so keep counting until free
+    size_t nameLength = name.size();
+    int suffix = slots[slot].lastSuffix;
+    size_t candidateSlot;
+    char digits[16];
+
+    do
+    {
+        suffix = max(suffix, 1) + 1;
+        name.resize(nameLength);
+        name += '_';
+        name.append(digits, to_chars(digits, digits + sizeof(digits), suffix).ptr);
+        candidateSlot = find(name);
+    } while (slots[candidateSlot].used);
+
+    slots[slot].lastSuffix = suffix;
+    insert(candidateSlot, name);
+    path.append(name, nameLength, string::npos);
+    renamed++;
+}
+
+long long reportFileNames::getRenamed() const
+{
+    lock_guard<mutex> guard(lock);
+    return renamed;
+}
+
+size_t reportFileNames::find(string_view name) const
+{
+    size_t mask = slots.size() - 1;
+    size_t slot = hash<string_view>()(name) & mask;
+
+    while (slots[slot].used && string_view(text).substr(slots[slot].offset, slots[slot].length) != name)
+        slot = (slot + 1) & mask;
+
+    return slot;
+}
+
+void reportFileNames::insert(size_t slot, string_view name)
+{
+    slots[slot].offset = text.size();
+    slots[slot].length = static_cast<uint32_t>(name.size());
+    slots[slot].lastSuffix = 0;
+    slots[slot].used = true;
+    text.append(name.data(), name.size());
+    count++;
+}
+
+void reportFileNames::grow(size_t slotCount)
+{
+    vector<nameSlot> previous(slotCount);
+    previous.swap(slots);
+
+    for (const nameSlot& entry : previous)
+    {
+        if (entry.used)
+            slots[find(string_view(text).substr(entry.offset, entry.length))] = entry;
+    }
+}
+
+// Writes one report with a single write (text mode, like report.txt)
+bool writeReportFile(const string& path, const string& text)
+{
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (file == nullptr)
+        return false;
+
+    // Unbuffered so the whole report goes out in one write
+    setvbuf(file, nullptr, _IONBF, 0);
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+
+    return (fclose(file) == 0) && written;
+}
+
+bool isBatchHeader(string_view line)
+{
+    char delimiter = (line.find('\t') != string_view::npos) ? '\t' : ',';
+    string_view fields[3];
+    size_t fieldStart = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        size_t fieldEnd = line.find(delimiter, fieldStart);
+        fields[i] = trimBatchField(line.substr(fieldStart,
+            (fieldEnd == string_view::npos) ? string_view::npos : fieldEnd - fieldStart));
+
+        if (fieldEnd == string_view::npos)
+            break;
+        fieldStart = fieldEnd + 1;
+    }
+
+    // A user really named "name" still has a number for a calorie target
+    int calories = 0;
+    return fields[0] == "name" && !parseBatchInt(fields[2], calories);
+}
+
+// Splits and validates one input line into row block.count of the block
+//    (same validation rules as the interactive prompts)
+bool parseBatchLine(string_view line, uint64_t byteOffset, batchBlock& block)
+{
+    const char* problem = parseBatchFields(line, block);
+
+    if (problem != nullptr)
+    {
+        // Appended piece by piece so a rejected row doesn't allocate
+        char digits[24];
+        block.errors += "Byte offset ";
+        block.errors.append(digits, to_chars(digits, digits + sizeof(digits), byteOffset).ptr);
+        block.errors += ": ";
+        block.errors += problem;
+        block.errors += '\n';
+        return false;
+    }
+
+    return true;
+}
+
+// Parses one profile row into row block.count (space must already be reserved)
+const char* parseBatchFields(string_view line, batchBlock& block)
+{
+    // Tab separated if the line has a tab, otherwise comma separated
+    char delimiter = (line.find('\t') != string_view::npos) ? '\t' : ',';
+
+    string_view fields[BATCH_FIELD_COUNT];
+    int fieldCount = 0;
+    size_t fieldStart = 0;
+    bool extraFields = false;
+
+    while (true)
+    {
+        size_t fieldEnd = line.find(delimiter, fieldStart);
+
+        if (fieldCount == BATCH_FIELD_COUNT)
+        {
+            extraFields = true;
+            break;
+        }
+
+        fields[fieldCount++] = line.substr(fieldStart,
+            (fieldEnd == string_view::npos) ? string_view::npos : fieldEnd - fieldStart);
+
+        if (fieldEnd == string_view::npos)
+            break;
+
+        fieldStart = fieldEnd + 1;
+    }
+
+    size_t row = block.count;
+    int* calories = &block.caloriesLog[row * NUMBER_OF_DAYS];
+    int dailyCalories = 0;
+    int mealsPerDay = 0;
+    double workoutHours = 0.0;
+    int goalChoice = 0;
+    const char* problem = nullptr;
+
+    if (fieldCount != BATCH_FIELD_COUNT || extraFields)
+        problem = "expected 13 fields";
+    else if (fields[0].empty() || fields[1].empty())
+        problem = "name and favorite protein are required";
+    else if (!parseBatchInt(fields[2], dailyCalories) || dailyCalories <= 0)
+        problem = "daily calorie target must be a positive number";
+    else if (!parseBatchInt(fields[3], mealsPerDay) || mealsPerDay <= 0 || mealsPerDay > MAX_MEALS_PER_DAY)
+        problem = "meals per day must be from 1 to 12";
+    else if (!parseBatchDouble(fields[4], workoutHours) || workoutHours < 0.0)
+        problem = "workout hours must be a nonnegative number";
+    else if (!parseBatchInt(fields[5], goalChoice) || goalChoice < 1 || goalChoice > 3)
+        problem = "goal must be 1, 2, or 3";
+    else
+    {
+        for (int day = 0; day < NUMBER_OF_DAYS && problem == nullptr; ++day)
+        {
+            if (!parseBatchInt(fields[6 + day], calories[day]) || calories[day] < 0)
+                problem = "daily calories must be positive numbers";
+        }
+    }
+
+    if (problem != nullptr)
+        return problem;
+
+    block.names[row] = fields[0];
+    block.proteins[row] = fields[1];
+    block.columns.dailyCalories[row] = dailyCalories;
+    block.columns.mealsPerDay[row] = mealsPerDay;
+    block.columns.weeklyWorkoutHours[row] = workoutHours;
+    block.columns.goal[row] = goalChoice - 1;
+
+    return nullptr;
+}
+
+// Trims surrounding spaces; the rest of the field must be a number
+string_view trimBatchField(string_view field)
+{
+    while (!field.empty() && field.front() == ' ')
+        field.remove_prefix(1);
+
+    while (!field.empty() && field.back() == ' ')
+        field.remove_suffix(1);
+
+    return field;
+}
+
+// from_chars takes a leading '-' but not '+'; the stream parser took both
+string_view skipBatchPlusSign(string_view field)
+{
+    if (field.size() > 1 && field[0] == '+' && field[1] != '-' && field[1] != '+')
+        field.remove_prefix(1);
+
+    return field;
+}
+
+bool parseBatchInt(string_view field, int& value)
+{
+    field = skipBatchPlusSign(trimBatchField(field));
+    from_chars_result result = from_chars(field.data(), field.data() + field.size(), value);
+
+    return result.ec == errc() && result.ptr == field.data() + field.size();
+}
+
+bool parseBatchDouble(string_view field, double& value)
+{
+    field = skipBatchPlusSign(trimBatchField(field));
+    from_chars_result result = from_chars(field.data(), field.data() + field.size(), value);
+
+    return result.ec == errc() && result.ptr == field.data() + field.size() && isfinite(value);
+}
+
+// Writes a quoted CSV text field, doubling any embedded quotes
+void appendBatchText(string& output, string_view text)
+{
+    output += '"';
+
+    for (char c : text)
+    {
+        if (c == '"')
+            output += '"';
+        output += c;
+    }
+
+    output += '"';
+}
+
+// memrchr() is a GNU extension, so search backwards by hand
+const void* memrchr_portable(const void* data, int value, size_t length)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    while (length > 0)
+    {
+        if (bytes[--length] == static_cast<unsigned char>(value))
+            return bytes + length;
+    }
+
+    return nullptr;
+}
+
+
+// --------------------- Mapped File ---------------------
+mappedFile::~mappedFile()
+{
+    unmap();
+
+#ifdef _WIN32
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+#else
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+#endif
+}
+
+bool mappedFile::open(const string& path)
+{
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size))
+        return false;
+
+    fileSize = static_cast<uint64_t>(size.QuadPart);
+
+    // Windows cannot create a mapping of an empty file
+    if (fileSize > 0)
+    {
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL)
+            return false;
+    }
+#else
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+
+    if (fileDescriptor < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fileDescriptor, &info) != 0)
+        return false;
+
+    fileSize = static_cast<uint64_t>(info.st_size);
+#endif
+
+    return true;
+}
+
+const char* mappedFile::map(uint64_t offset, size_t length)
+{
+    unmap();
+
+    if (length == 0 || offset + length > fileSize)
+        return nullptr;
+
+    // Views must start on an allocation-granularity boundary
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    uint64_t granularity = systemInfo.dwAllocationGranularity;
+#else
+    uint64_t granularity = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+    uint64_t alignedOffset = offset - (offset % granularity);
+    size_t lead = static_cast<size_t>(offset - alignedOffset);
+    viewLength = length + lead;
+
+#ifdef _WIN32
+    view = static_cast<char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ,
+        static_cast<DWORD>(alignedOffset >> 32), static_cast<DWORD>(alignedOffset & 0xFFFFFFFF), viewLength));
+#else
+    void* address = mmap(nullptr, viewLength, PROT_READ, MAP_PRIVATE, fileDescriptor,
+        static_cast<off_t>(alignedOffset));
+    view = (address == MAP_FAILED) ? nullptr : static_cast<char*>(address);
+
+    if (view != nullptr)
+        madvise(view, viewLength, MADV_SEQUENTIAL);
+#endif
+
+    if (view == nullptr)
+    {
+        viewLength = 0;
+        return nullptr;
+    }
+
+    return view + lead;
+}
+
+void mappedFile::unmap()
+{
+    if (view == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(view);
+#else
+    munmap(view, viewLength);
+#endif
+
+    view = nullptr;
+    viewLength = 0;
+}
+
+
+// --------------------- Columnar Macro Kernel ---------------------
+void profileColumns::resize(size_t count)
+{
+    dailyCalories.resize(count);
+    mealsPerDay.resize(count);
+    weeklyWorkoutHours.resize(count);
+    goal.resize(count);
+
+    dailyProteinGrams.resize(count);
+    dailyCarbGrams.resize(count);
+    dailyFatGrams.resize(count);
+    proteinPerMeal.resize(count);
+    carbsPerMeal.resize(count);
+    fatsPerMeal.resize(count);
+
+    nutritionAdvice.resize(count);
+    mealAdvice.resize(count);
+}
+
+void batchBlock::reserveRows(size_t rows)
+{
+    if (rows <= names.size())
+        return;
+
+    size_t capacity = max<size_t>(rows, names.size() * 2);
+
+    columns.resize(capacity);
+    names.resize(capacity);
+    proteins.resize(capacity);
+    caloriesLog.resize(capacity * NUMBER_OF_DAYS);
+}
+
+void calculateMacrosColumnsScalar(profileColumns& columns, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        int calories = columns.dailyCalories[i];
+        int meals = columns.mealsPerDay[i];
+
+        int protein = static_cast<int>((calories * PROTEIN_PERCENT) / CALORIES_PER_GRAM_PROTEIN);
+        int carbs = static_cast<int>((calories * CARB_PERCENT) / CALORIES_PER_GRAM_CARBS);
+        int fats = static_cast<int>((calories * FAT_PERCENT) / CALORIES_PER_GRAM_FAT);
+
+        columns.dailyProteinGrams[i] = protein;
+        columns.dailyCarbGrams[i] = carbs;
+        columns.dailyFatGrams[i] = fats;
+
+        columns.proteinPerMeal[i] = protein / meals;
+        columns.carbsPerMeal[i] = carbs / meals;
+        columns.fatsPerMeal[i] = fats / meals;
+    }
+}
+
+// The SIMD paths do the same double multiply, divide and truncation as the
+//    scalar code, so results match static_cast<int> exactly. Integer division
+//    by mealsPerDay is done in double: for 32-bit operands the truncated double
+//    quotient always equals the integer quotient.
+#if defined(__AVX__)
+
+void calculateMacrosColumns(profileColumns& columns, size_t begin, size_t end)
+{
+    const __m256d proteinPercent = _mm256_set1_pd(PROTEIN_PERCENT);
+    const __m256d carbPercent = _mm256_set1_pd(CARB_PERCENT);
+    const __m256d fatPercent = _mm256_set1_pd(FAT_PERCENT);
+    const __m256d proteinCalories = _mm256_set1_pd(CALORIES_PER_GRAM_PROTEIN);
+    const __m256d carbCalories = _mm256_set1_pd(CALORIES_PER_GRAM_CARBS);
+    const __m256d fatCalories = _mm256_set1_pd(CALORIES_PER_GRAM_FAT);
+
+    size_t i = begin;
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m256d calories = _mm256_cvtepi32_pd(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(&columns.dailyCalories[i])));
+        __m256d meals = _mm256_cvtepi32_pd(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(&columns.mealsPerDay[i])));
+
+        __m128i protein = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_mul_pd(calories, proteinPercent), proteinCalories));
+        __m128i carbs = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_mul_pd(calories, carbPercent), carbCalories));
+        __m128i fats = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_mul_pd(calories, fatPercent), fatCalories));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&columns.dailyProteinGrams[i]), protein);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&columns.dailyCarbGrams[i]), carbs);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&columns.dailyFatGrams[i]), fats);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&columns.proteinPerMeal[i]),
+            _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(protein), meals)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&columns.carbsPerMeal[i]),
+            _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(carbs), meals)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&columns.fatsPerMeal[i]),
+            _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(fats), meals)));
+    }
+
+    calculateMacrosColumnsScalar(columns, i, end);
+}
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+void calculateMacrosColumns(profileColumns& columns, size_t begin, size_t end)
+{
+    const __m128d proteinPercent = _mm_set1_pd(PROTEIN_PERCENT);
+    const __m128d carbPercent = _mm_set1_pd(CARB_PERCENT);
+    const __m128d fatPercent = _mm_set1_pd(FAT_PERCENT);
+    const __m128d proteinCalories = _mm_set1_pd(CALORIES_PER_GRAM_PROTEIN);
+    const __m128d carbCalories = _mm_set1_pd(CALORIES_PER_GRAM_CARBS);
+    const __m128d fatCalories = _mm_set1_pd(CALORIES_PER_GRAM_FAT);
+
+    size_t i = begin;
+
+    // Two profiles per step (only the low 64 bits of each store are used)
+    for (; i + 2 <= end; i += 2)
+    {
+        __m128d calories = _mm_cvtepi32_pd(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(&columns.dailyCalories[i])));
+        __m128d meals = _mm_cvtepi32_pd(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(&columns.mealsPerDay[i])));
+
+        __m128i protein = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(calories, proteinPercent), proteinCalories));
+        __m128i carbs = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(calories, carbPercent), carbCalories));
+        __m128i fats = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(calories, fatPercent), fatCalories));
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&columns.dailyProteinGrams[i]), protein);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&columns.dailyCarbGrams[i]), carbs);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&columns.dailyFatGrams[i]), fats);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&columns.proteinPerMeal[i]),
+            _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(protein), meals)));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&columns.carbsPerMeal[i]),
+            _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(carbs), meals)));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&columns.fatsPerMeal[i]),
+            _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(fats), meals)));
+    }
+
+    calculateMacrosColumnsScalar(columns, i, end);
+}
+
+#else
+
+void calculateMacrosColumns(profileColumns& columns, size_t begin, size_t end)
+{
+    calculateMacrosColumnsScalar(columns, begin, end);
+}
+
+#endif
+
+
+// --------------------- Work-Stealing Pool ---------------------
+workStealingPool::workStealingPool(int workerCount)
+{
+    if (workerCount < 1)
+        workerCount = 1;
+
+    stats.resize(workerCount);
+
+    for (int i = 0; i < workerCount; i++)
+        queues.emplace_back(new workerQueue);
+
+    for (int i = 0; i < workerCount; i++)
+        workers.emplace_back(&workStealingPool::workerLoop, this, i);
+}
+
+workStealingPool::~workStealingPool()
+{
+    {
+        lock_guard<mutex> guard(stateLock);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+
+    for (thread& worker : workers)
+        worker.join();
+}
+
+void workStealingPool::run(size_t taskCount, const function<size_t(size_t, int)>& work)
+{
+    lock_guard<mutex> job(jobLock);
+    runJob(taskCount, work);
+}
+
+bool workStealingPool::tryRun(size_t taskCount, const function<size_t(size_t, int)>& work)
+{
+    unique_lock<mutex> job(jobLock, try_to_lock);
+
+    if (!job.owns_lock())
+        return false;
+
+    runJob(taskCount, work);
+    return true;
+}
+
+void workStealingPool::runJob(size_t taskCount, const function<size_t(size_t, int)>& work)
+{
+    if (taskCount == 0)
+        return;
+
+    // Each worker starts with a contiguous range of tasks
+    size_t workerCount = workers.size();
+
+    for (size_t w = 0; w < workerCount; w++)
+    {
+        lock_guard<mutex> guard(queues[w]->lock);
+
+        for (size_t task = taskCount * w / workerCount; task < taskCount * (w + 1) / workerCount; task++)
+            queues[w]->tasks.push_back(task);
+    }
+
+    unique_lock<mutex> lock(stateLock);
+    currentWork = &work;
+    activeWorkers = static_cast<int>(workerCount);
+    generation++;
+    wakeWorkers.notify_all();
+
+    jobFinished.wait(lock, [this] { return activeWorkers == 0; });
+    currentWork = nullptr;
+}
+
+void workStealingPool::workerLoop(int worker)
+{
+    long long seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(stateLock);
+            wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+
+            if (stopping)
+                return;
+
+            seenGeneration = generation;
+        }
+
+        auto startTime = chrono::steady_clock::now();
+        size_t task = 0;
+        bool stolen = false;
+
+        while (takeTask(worker, task, stolen))
+        {
+            stats[worker].itemsProcessed += (*currentWork)(task, worker);
+            stats[worker].tasksRun++;
+
+            if (stolen)
+                stats[worker].tasksStolen++;
+        }
+
+        stats[worker].busySeconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+        lock_guard<mutex> guard(stateLock);
+
+        if (--activeWorkers == 0)
+            jobFinished.notify_all();
+    }
+}
+
+bool workStealingPool::takeTask(int worker, size_t& task, bool& stolen)
+{
+    // Own queue first (front), then steal from the other queues (back)
+    {
+        workerQueue& own = *queues[worker];
+        lock_guard<mutex> guard(own.lock);
+
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            stolen = false;
+            return true;
+        }
+    }
+
+    int workerCount = static_cast<int>(queues.size());
+
+    for (int offset = 1; offset < workerCount; offset++)
+    {
+        workerQueue& victim = *queues[(worker + offset) % workerCount];
+        lock_guard<mutex> guard(victim.lock);
+
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            stolen = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+workStealingPool& getSharedPool()
+{
+    static workStealingPool pool(static_cast<int>(thread::hardware_concurrency()));
+    return pool;
+}
+
+void workStealingPool::printWorkerStats(ostream& out) const
+{
+    out << left << setw(8) << "Worker" << right << setw(10) << "Tasks" << setw(10) << "Stolen"
+        << setw(14) << "Items" << setw(12) << "Busy (s)" << setw(14) << "Items/s" << "\n";
+
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const workerStats& worker = stats[i];
+        double rate = (worker.busySeconds > 0.0) ? worker.itemsProcessed / worker.busySeconds : 0.0;
+
+        out << left << setw(8) << i << right << setw(10) << worker.tasksRun << setw(10) << worker.tasksStolen
+            << setw(14) << worker.itemsProcessed << fixed << setprecision(3) << setw(12) << worker.busySeconds
+            << setprecision(0) << setw(14) << rate << "\n";
+    }
+}
+
+
+// --------------------- Report Buffer ---------------------
+void reportBuffer::appendInt(long long value)
+{
+    char digits[24];
+    to_chars_result result = to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+void reportBuffer::appendFixed2(double value)
+{
+    // Large enough for any double in fixed notation
+    char digits[400];
+    to_chars_result result = to_chars(digits, digits + sizeof(digits), value, chars_format::fixed, 2);
+    text.append(digits, result.ptr);
+}
+
+void reportBuffer::appendLeader(string_view label)
+{
+    static const string dots(REPORT_LABEL_WIDTH, '.');
+
+    append(label);
+
+    if (label.size() < dots.size())
+        text.append(dots, 0, dots.size() - label.size());
+}
+
+void reportBuffer::appendRule()
+{
+    static const string rule = string(CONSOLE_WIDTH, '*') + "\n";
+    text += rule;
+}
+
+
+// --------------------- Calorie History ---------------------
+calorieHistory::calorieHistory()
+{
+    for (int i = 0; i < ROLLING_WINDOW_COUNT; i++)
+        windows[i].length = ROLLING_WINDOWS[i];
+}
+
+void calorieHistory::clear()
+{
+    days.clear();
+    allDaysSum = 0;
+    rangeIndex.clear();
+
+    for (rollingWindow& window : windows)
+    {
+        window.sum = 0;
+        window.queueHead = 0;
+        window.queueCount = 0;
+    }
+}
+
+void calorieHistory::append(int calories)
+{
+    size_t index = days.size();
+    days.push_back(calories);
+    allDaysSum += calories;
+    rangeIndex.append(calories);
+
+    for (rollingWindow& window : windows)
+    {
+        size_t length = static_cast<size_t>(window.length);
+
+        // Add the new day and drop the one that slid out of the window
+        window.sum += calories;
+        if (index >= length)
+            window.sum -= days[index - length];
+
+        // Remove the front if it slid out of the window
+        if (window.queueCount > 0 && window.maxQueue[window.queueHead] + length <= index)
+        {
+            window.queueHead = static_cast<uint32_t>((window.queueHead + 1) % window.maxQueue.size());
+            window.queueCount--;
+        }
+
+        // Remove days from the back that can never be the max again
+        size_t capacity = window.maxQueue.size();
+        while (window.queueCount > 0 &&
+            days[window.maxQueue[(window.queueHead + window.queueCount - 1) % capacity]] <= calories)
+        {
+            window.queueCount--;
+        }
+
+        // Short histories never fill the longer windows, so the ring only
+        //    grows (unrolled to start at 0) when it is full
+        if (window.queueCount == capacity)
+        {
+            rotate(window.maxQueue.begin(), window.maxQueue.begin() + window.queueHead, window.maxQueue.end());
+            window.queueHead = 0;
+            window.maxQueue.push_back(0);
+            capacity = window.maxQueue.size();
+        }
+
+        window.maxQueue[(window.queueHead + window.queueCount) % capacity] = static_cast<uint32_t>(index);
+        window.queueCount++;
+    }
+}
+
+void calorieHistory::replaceLastDays(const int calories[], int count)
+{
+    size_t first = days.size() - min(days.size(), static_cast<size_t>(count));
+    bool changed = false;
+
+    for (size_t i = first; i < days.size(); i++)
+    {
+        int delta = calories[i - first] - days[i];
+
+        if (delta == 0)
+            continue;
+
+        days[i] = calories[i - first];
+        allDaysSum += delta;
+        rangeIndex.replaceDay(i, days[i]);
+        changed = true;
+
+        for (rollingWindow& window : windows)
+        {
+            if (i >= windowStart(window.length))
+                window.sum += delta;
+        }
+    }
+
+    // A window's max can move to any of its days, so its queue is rebuilt
+    //    (at most window length days, however long the history is)
+    if (changed)
+    {
+        for (rollingWindow& window : windows)
+            rebuildMaxQueue(window);
+    }
+}
+
+void calorieHistory::rebuildMaxQueue(rollingWindow& window)
+{
+    window.queueHead = 0;
+    window.queueCount = 0;
+
+    for (size_t index = windowStart(window.length); index < days.size(); index++)
+    {
+        while (window.queueCount > 0 && days[window.maxQueue[window.queueCount - 1]] <= days[index])
+            window.queueCount--;
+
+        if (window.queueCount == window.maxQueue.size())
+            window.maxQueue.push_back(0);
+
+        window.maxQueue[window.queueCount++] = static_cast<uint32_t>(index);
+    }
+}
+
+size_t calorieHistory::getHeapBytes() const
+{
+    size_t bytes = days.capacity() * sizeof(int) + rangeIndex.getHeapBytes();
+
+    for (const rollingWindow& window : windows)
+        bytes += window.maxQueue.capacity() * sizeof(uint32_t);
+
+    return bytes;
+}
+
+const calorieHistory::rollingWindow* calorieHistory::findWindow(int window) const
+{
+    for (const rollingWindow& candidate : windows)
+    {
+        if (candidate.length == window)
+            return &candidate;
+    }
+
+    return nullptr;
+}
+
+size_t calorieHistory::windowStart(int window) const
+{
+    return days.size() - min(days.size(), static_cast<size_t>(max(window, 0)));
+}
+
+long long calorieHistory::windowSum(int window) const
+{
+    if (const rollingWindow* rolling = findWindow(window))
+        return rolling->sum;
+
+    size_t first = windowStart(window);
+    return (first < days.size()) ? rangeIndex.rangeSum(first, days.size() - 1) : 0;
+}
+
+double calorieHistory::windowMean(int window) const
+{
+    size_t count = days.size() - windowStart(window);
+
+    if (count == 0)
+        return 0.0;
+
+    return static_cast<double>(windowSum(window)) / count;
+}
+
+int calorieHistory::windowMax(int window) const
+{
+    if (const rollingWindow* rolling = findWindow(window))
+        return (rolling->queueCount > 0) ? days[rolling->maxQueue[rolling->queueHead]] : 0;
+
+    size_t first = windowStart(window);
+    return (first < days.size()) ? rangeIndex.rangeMax(first, days.size() - 1) : 0;
+}
+
+
+// --------------------- Calorie Range Index ---------------------
+void calorieRangeIndex::clear()
+{
+    prefixSums.clear();
+
+    // Keep the level vectors (and their capacity) for reuse
+    for (vector<int>& level : maxTable)
+        level.clear();
+    for (vector<int>& level : minTable)
+        level.clear();
+}
+
+void calorieRangeIndex::append(int calories)
+{
+    if (prefixSums.empty())
+        prefixSums.push_back(0);
+
+    size_t count = size() + 1;   // Days after this append
+    prefixSums.push_back(prefixSums.back() + calories);
+
+    // Level 0 is the day itself; level k gains the block of 2^k days ending today
+    for (int k = 0; (static_cast<size_t>(1) << k) <= count; k++)
+    {
+        if (static_cast<size_t>(k) == maxTable.size())
+        {
+            maxTable.emplace_back();
+            minTable.emplace_back();
+        }
+
+        if (k == 0)
+        {
+            maxTable[0].push_back(calories);
+            minTable[0].push_back(calories);
+            continue;
+        }
+
+        size_t start = count - (static_cast<size_t>(1) << k);
+        size_t half = static_cast<size_t>(1) << (k - 1);
+
+        maxTable[k].push_back(max(maxTable[k - 1][start], maxTable[k - 1][start + half]));
+        minTable[k].push_back(min(minTable[k - 1][start], minTable[k - 1][start + half]));
+    }
+}
+
+void calorieRangeIndex::replaceDay(size_t index, int calories)
+{
+    size_t count = size();
+    long long delta = static_cast<long long>(calories) - maxTable[0][index];
+
+    for (size_t i = index + 1; i <= count; i++)
+        prefixSums[i] += delta;
+
+    maxTable[0][index] = calories;
+    minTable[0][index] = calories;
+
+    // Level k blocks [start, start + 2^k) that contain index
+    for (int k = 1; (static_cast<size_t>(1) << k) <= count; k++)
+    {
+        size_t length = static_cast<size_t>(1) << k;
+        size_t half = length >> 1;
+        size_t start = (index + 1 >= length) ? index + 1 - length : 0;
+        size_t last = min(index, count - length);
+
+        for (; start <= last; start++)
+        {
+            maxTable[k][start] = max(maxTable[k - 1][start], maxTable[k - 1][start + half]);
+            minTable[k][start] = min(minTable[k - 1][start], minTable[k - 1][start + half]);
+        }
+    }
+}
+
+size_t calorieRangeIndex::getHeapBytes() const
+{
+    size_t bytes = prefixSums.capacity() * sizeof(long long) +
+        (maxTable.capacity() + minTable.capacity()) * sizeof(vector<int>);
+
+    for (const vector<int>& level : maxTable)
+        bytes += level.capacity() * sizeof(int);
+    for (const vector<int>& level : minTable)
+        bytes += level.capacity() * sizeof(int);
+
+    return bytes;
+}
+
+long long calorieRangeIndex::rangeSum(size_t first, size_t last) const
+{
+    return prefixSums[last + 1] - prefixSums[first];
+}
+
+double calorieRangeIndex::rangeMean(size_t first, size_t last) const
+{
+    return static_cast<double>(rangeSum(first, last)) / (last - first + 1);
+}
+
+// Two overlapping power-of-two blocks cover the range exactly
+int calorieRangeIndex::rangeMax(size_t first, size_t last) const
+{
+    int k = floorLog2(last - first + 1);
+    return max(maxTable[k][first], maxTable[k][last + 1 - (static_cast<size_t>(1) << k)]);
+}
+
+int calorieRangeIndex::rangeMin(size_t first, size_t last) const
+{
+    int k = floorLog2(last - first + 1);
+    return min(minTable[k][first], minTable[k][last + 1 - (static_cast<size_t>(1) << k)]);
+}
+
+int calorieRangeIndex::floorLog2(size_t value)
+{
+    return static_cast<int>(bit_width(value)) - 1;
+}
+
+
+// --------------------- Session File ---------------------
+// Little-endian helpers so the file reads the same on any platform
+void writeLittleEndian(char bytes[], uint64_t value, int byteCount)
+{
+    for (int i = 0; i < byteCount; i++)
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+uint64_t readLittleEndian(const char bytes[], int byteCount)
+{
+    uint64_t value = 0;
+
+    for (int i = 0; i < byteCount; i++)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+
+    return value;
+}
+
+bool encodeSessionRecord(const sessionRecord& record, char bytes[])
+{
+    if (record.fats >= SESSION_GOAL_FLAG)
+        return false;
+
+    uint16_t fatsAndFlag = record.fats | (record.metCalorieGoal ? SESSION_GOAL_FLAG : 0);
+
+    writeLittleEndian(bytes, record.dayNumber, 4);
+    writeLittleEndian(bytes + 4, record.calories, 4);
+    writeLittleEndian(bytes + 8, record.protein, 2);
+    writeLittleEndian(bytes + 10, record.carbs, 2);
+    writeLittleEndian(bytes + 12, fatsAndFlag, 2);
+
+    return true;
+}
+
+bool seekFileOffset(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    if (offset > static_cast<uint64_t>(INT64_MAX))
+        return false;
+
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    if (offset > static_cast<uint64_t>(numeric_limits<off_t>::max()))
+        return false;
+
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Creates the file if needed, appends the records, then updates the header count
+bool appendSessionRecords(const string& path, const sessionRecord records[], size_t count)
+{
+    char header[SESSION_HEADER_SIZE];
+    uint64_t existingCount = 0;
+
+    FILE* file = fopen(path.c_str(), "r+b");
+
+    if (file != nullptr)
+    {
+        if (fread(header, 1, SESSION_HEADER_SIZE, file) != SESSION_HEADER_SIZE ||
+            memcmp(header, SESSION_FILE_MAGIC, sizeof(SESSION_FILE_MAGIC)) != 0 ||
+            readLittleEndian(header + 8, 4) != SESSION_FILE_VERSION)
+        {
+            fclose(file);
+            return false;
+        }
+
+        existingCount = readLittleEndian(header + 16, 8);
+
+        // A count no file could hold means the header is damaged
+        if (existingCount > (UINT64_MAX - SESSION_HEADER_SIZE) / SESSION_RECORD_SIZE - count)
+        {
+            fclose(file);
+            return false;
+        }
+    }
+    else if (errno != ENOENT)
+    {
+        // The file is there but can't be opened: never replace it
+        return false;
+    }
+    else
+    {
+        // "x" fails if another process created the file in the meantime
+        file = fopen(path.c_str(), "w+bx");
+
+        if (file == nullptr)
+            return false;
+
+        memcpy(header, SESSION_FILE_MAGIC, sizeof(SESSION_FILE_MAGIC));
+        writeLittleEndian(header + 8, SESSION_FILE_VERSION, 4);
+        writeLittleEndian(header + 12, SESSION_RECORD_SIZE, 4);
+    }
+
+    vector<char> bytes(count * SESSION_RECORD_SIZE);
+    bool written = true;
+
+    for (size_t i = 0; i < count && written; i++)
+        written = encodeSessionRecord(records[i], &bytes[i * SESSION_RECORD_SIZE]);
+
+    uint64_t recordsOffset = SESSION_HEADER_SIZE + existingCount * SESSION_RECORD_SIZE;
+    writeLittleEndian(header + 16, existingCount + count, 8);
+
+    written = written &&
+        seekFileOffset(file, recordsOffset) &&
+        fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() &&
+        fseek(file, 0, SEEK_SET) == 0 &&
+        fwrite(header, 1, SESSION_HEADER_SIZE, file) == SESSION_HEADER_SIZE;
+
+    return (fclose(file) == 0) && written;
+}
+
+bool sessionFileView::open(const string& path)
+{
+    recordCount = 0;
+    records = nullptr;
+
+    if (!file.open(path) || file.size() < SESSION_HEADER_SIZE)
+        return false;
+
+    const char* data = file.map(0, static_cast<size_t>(file.size()));
+
+    if (data == nullptr ||
+        memcmp(data, SESSION_FILE_MAGIC, sizeof(SESSION_FILE_MAGIC)) != 0 ||
+        readLittleEndian(data + 8, 4) != SESSION_FILE_VERSION ||
+        readLittleEndian(data + 12, 4) != SESSION_RECORD_SIZE)
+    {
+        return false;
+    }
+
+    // Ignore a partly written record at the end
+    uint64_t storedCount = readLittleEndian(data + 16, 8);
+    uint64_t completeCount = (file.size() - SESSION_HEADER_SIZE) / SESSION_RECORD_SIZE;
+
+    records = data + SESSION_HEADER_SIZE;
+    recordCount = static_cast<size_t>(min(storedCount, completeCount));
+
+    return true;
+}
+
+sessionRecord sessionFileView::operator[](size_t index) const
+{
+    const char* bytes = records + index * SESSION_RECORD_SIZE;
+    uint16_t fatsAndFlag = static_cast<uint16_t>(readLittleEndian(bytes + 12, 2));
+
+    sessionRecord record;
+    record.dayNumber = static_cast<uint32_t>(readLittleEndian(bytes, 4));
+    record.calories = static_cast<uint32_t>(readLittleEndian(bytes + 4, 4));
+    record.protein = static_cast<uint16_t>(readLittleEndian(bytes + 8, 2));
+    record.carbs = static_cast<uint16_t>(readLittleEndian(bytes + 10, 2));
+    record.fats = fatsAndFlag & ~SESSION_GOAL_FLAG;
+    record.metCalorieGoal = (fatsAndFlag & SESSION_GOAL_FLAG) != 0;
+
+    return record;
+}
+
+
+// --------------------- Benchmarks ---------------------
+#if TRACKER_COUNT_ALLOCATIONS
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+
+    if (void* memory = malloc(size == 0 ? 1 : size))
+        return memory;
+
+    throw bad_alloc();
+}
+
+// GCC inlines these into callers and then reports the malloc/free pair
+//    behind new/delete as mismatched
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+long long getAllocationCount()
+{
+#if TRACKER_COUNT_ALLOCATIONS
+    return allocationCount.load(memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+double getAllocationsPerOp(long long allocationsBefore, double operations)
+{
+    if (!TRACKER_COUNT_ALLOCATIONS)
+        return -1.0;
+
+    return (getAllocationCount() - allocationsBefore) / operations;
+}
+
+// Repeats pass() (opsPerPass operations each) until BENCH_MIN_SECONDS have passed
+benchmarkResult runBenchmark(const string& name, size_t dataSize, size_t opsPerPass,
+    const function<void()>& pass)
+{
+    // Warm up caches and any lazily grown buffers
+    pass();
+
+    long long passes = 0;
+    long long allocationsBefore = getAllocationCount();
+    auto startTime = chrono::steady_clock::now();
+    double seconds = 0.0;
+
+    do
+    {
+        pass();
+        passes++;
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    } while (seconds < BENCH_MIN_SECONDS);
+
+    double operations = static_cast<double>(passes) * opsPerPass;
+    double allocationsPerOp = getAllocationsPerOp(allocationsBefore, operations);
+
+    benchmarkResult result;
+    result.name = name;
+    result.dataSize = dataSize;
+    result.nsPerOp = seconds * 1e9 / operations;
+    result.itemsPerSecond = operations / seconds;
+    result.allocationsPerOp = allocationsPerOp;
+
+    printBenchmarkResult(result);
+
+    return result;
+}
+
+void printBenchmarkResult(const benchmarkResult& result)
+{
+    cout << left << setw(30) << result.name << right << setw(10) << result.dataSize
+        << fixed << setprecision(2) << setw(14) << result.nsPerOp
+        << setprecision(0) << setw(16) << result.itemsPerSecond << setprecision(3) << setw(12);
+
+    if (result.allocationsPerOp < 0.0)
+        cout << "n/a" << "\n";
+    else
+        cout << result.allocationsPerOp << "\n";
+}
+
+// Bytes per resident user, by where they live
+void printMemoryReport(ostream& out, const trackerMemory& memory)
+{
+    const stringPool& proteins = getProteinPool();
+    double users = static_cast<double>(max<size_t>(1, memory.users));
+
+    out << "Memory per user (" << memory.users << " users)\n" << fixed << setprecision(1);
+    out << left << setw(30) << "  tracker and store entry" << right << setw(10) << memory.objectBytes / users << " bytes\n";
+    out << left << setw(30) << "  name text" << right << setw(10) << memory.nameBytes / users << " bytes\n";
+    out << left << setw(30) << "  calorie history" << right << setw(10) << memory.historyBytes / users << " bytes\n";
+    out << left << setw(30) << "  meal plan" << right << setw(10) << memory.mealPlanBytes / users << " bytes\n";
+    out << left << setw(30) << "  total" << right << setw(10) << memory.total() / users << " bytes\n";
+    out << left << setw(30) << "Interned protein sources" << right << setw(10) << proteins.size()
+        << " (" << proteins.getBytes() << " bytes shared)\n";
+
+    if (proteins.getRefused() > 0)
+        out << left << setw(30) << "Protein text kept per user" << right << setw(10) << proteins.getRefused()
+            << " (pool full or text too long)\n";
+}
+
+// Threads pick random stored users: STORE_BENCH_WRITE_PERCENT of operations
+//    append a day of calories, the rest read a summary. ns/op is wall time
+//    per operation across all threads, so it falls as throughput scales.
+benchmarkResult runSessionStoreStress(sessionStore& users, const vector<string>& userNames, int threadCount)
+{
+    atomic<bool> stop(false);
+    atomic<long long> operations(0);
+    atomic<long long> summarySink(0);   // Keeps the summaries observable
+    vector<thread> threads;
+
+    long long allocationsBefore = getAllocationCount();
+    auto startTime = chrono::steady_clock::now();
+
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]
+            {
+                mt19937 random(7919 + t);
+                long long done = 0;
+                long long sink = 0;
+
+                while (!stop.load(memory_order_relaxed))
+                {
+                    const string& userName = userNames[random() % userNames.size()];
+
+                    if (static_cast<int>(random() % 100) < STORE_BENCH_WRITE_PERCENT)
+                    {
+                        users.update(userName, [&](nutritionTracker& tracker)
+                            {
+                                tracker.appendDailyCalories(1500 + static_cast<int>(random() % 2000));
+                            });
+                    }
+                    else
+                    {
+                        users.read(userName, [&](const nutritionTracker& tracker)
+                            {
+                                const calorieHistory& history = tracker.getHistory();
+                                sink += static_cast<long long>(history.windowMean(NUMBER_OF_DAYS)) +
+                                    history.windowMax(NUMBER_OF_DAYS) + tracker.findHighestCalories() +
+                                    reinterpret_cast<uintptr_t>(tracker.getNutritionAdvice());
+                            });
+                    }
+
+                    done++;
+                }
+
+                operations += done;
+                summarySink += sink;
+            });
+    }
+
+    this_thread::sleep_for(chrono::duration<double>(BENCH_MIN_SECONDS));
+    stop = true;
+
+    for (thread& worker : threads)
+        worker.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    double totalOperations = static_cast<double>(max(1LL, operations.load()));
+
+    benchmarkResult result;
+    result.name = "session store " + to_string(threadCount) + " thread" + (threadCount == 1 ? "" : "s");
+    result.dataSize = users.size();
+    result.nsPerOp = seconds * 1e9 / totalOperations;
+    result.itemsPerSecond = totalOperations / seconds;
+    result.allocationsPerOp = getAllocationsPerOp(allocationsBefore, totalOperations);
+
+    printBenchmarkResult(result);
+
+    return result;
+}
+
+int runBenchmarks(const string& resultsPath)
+{
+    const size_t profileCounts[] = { 1000, 10000, 100000 };
+    const size_t arrayLengths[] = { NUMBER_OF_DAYS, 1000, 100000 };
+
+    vector<benchmarkResult> results;
+    mt19937 random(2530);   // Fixed seed so every run uses the same data
+    long long sink = 0;     // Keeps results observable so loops are not optimized away
+
+    cout << left << setw(30) << "Benchmark" << right << setw(10) << "Size" << setw(14) << "ns/op"
+        << setw(16) << "items/s" << setw(12) << "allocs/op" << "\n";
+    printSectionBreakLine();
+
+    bool kernelMatches = checkMacroKernel(random);
+
+    for (size_t count : profileCounts)
+    {
+        // Random but realistic profiles with a full week logged
+        vector<nutritionTracker> trackers(count);
+        profileColumns columns;
+        columns.resize(count);
+        int calories[NUMBER_OF_DAYS];
+
+        for (size_t i = 0; i < count; i++)
+        {
+            int dailyCalories = 1500 + static_cast<int>(random() % 2000);
+            int meals = 2 + static_cast<int>(random() % 5);
+            double hours = (random() % 80) / 10.0;
+
+            for (int day = 0; day < NUMBER_OF_DAYS; day++)
+                calories[day] = 1200 + static_cast<int>(random() % 2500);
+
+            trackers[i].loadProfile("Lifter " + to_string(i), "tofu", dailyCalories, meals, hours,
+                static_cast<GoalType>(random() % 3));
+            trackers[i].loadDailyCalories(calories);
+            trackers[i].calculateMacros();
+            trackers[i].fillSessionsFromCalories();
+
+            columns.dailyCalories[i] = dailyCalories;
+            columns.mealsPerDay[i] = meals;
+            columns.weeklyWorkoutHours[i] = hours;
+        }
+
+        results.push_back(runBenchmark("calculateMacros", count, count, [&]
+            {
+                for (nutritionTracker& tracker : trackers)
+                    tracker.calculateMacros();
+                sink += trackers[0].dailyProteinGrams;
+            }));
+
+        results.push_back(runBenchmark("calculateMacrosColumns", count, count, [&]
+            {
+                calculateMacrosColumns(columns, 0, count);
+                sink += columns.proteinPerMeal[0];
+            }));
+
+        results.push_back(runBenchmark("fillSessionsFromCalories", count, count, [&]
+            {
+                for (nutritionTracker& tracker : trackers)
+                    tracker.fillSessionsFromCalories();
+                sink += trackers[0].weeklySessions[0].calories;
+            }));
+
+        int macrosPerMeal2D[3][NUMBER_OF_DAYS];
+        results.push_back(runBenchmark("fillMacrosPerMeal2D", count, count, [&]
+            {
+                for (const nutritionTracker& tracker : trackers)
+                {
+                    tracker.fillMacrosPerMeal2D(macrosPerMeal2D);
+                    sink += macrosPerMeal2D[0][0];
+                }
+            }));
+
+        results.push_back(runBenchmark("findHighestCalories", count, count, [&]
+            {
+                for (const nutritionTracker& tracker : trackers)
+                    sink += tracker.findHighestCalories();
+            }));
+
+        results.push_back(runBenchmark("evaluateNutrition rules", count, count, [&]
+            {
+                for (const nutritionTracker& tracker : trackers)
+                {
+                    sink += reinterpret_cast<uintptr_t>(tracker.getNutritionAdvice());
+                    sink += reinterpret_cast<uintptr_t>(tracker.getMealFrequencyAdvice(tracker.mealsPerDay * NUMBER_OF_DAYS));
+                    sink += reinterpret_cast<uintptr_t>(tracker.getGoalAdvice());
+                }
+            }));
+
+        const adviceRules& rules = getAdviceRules();
+        results.push_back(runBenchmark("adviceRules::classifyColumns", count, count, [&]
+            {
+                rules.classifyColumns(columns, 0, count);
+                sink += columns.nutritionAdvice[0] + columns.mealAdvice[count - 1];
+            }));
+
+        // Every key cached, then a cache a tenth the size so most inserts evict
+        vector<macroCacheKey> keys(count);
+        macroCache cache(count);
+        macroCache smallCache(count / 10);
+        macroCacheEntry entry;
+        string resultColumns;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const nutritionTracker& tracker = trackers[i];
+            keys[i] = makeMacroCacheKey(tracker.dailyCalories, tracker.mealsPerDay,
+                tracker.weeklyWorkoutHours, static_cast<int>(tracker.goal));
+            tracker.fillMacroCacheEntry(entry, resultColumns);
+            cache.insert(keys[i], entry);
+        }
+
+        results.push_back(runBenchmark("macroCache find (hit)", count, count, [&]
+            {
+                for (const macroCacheKey& key : keys)
+                {
+                    cache.find(key, entry);
+                    sink += entry.proteinPerMeal;
+                }
+            }));
+
+        results.push_back(runBenchmark("macroCache insert (evicting)", count, count, [&]
+            {
+                for (const macroCacheKey& key : keys)
+                    smallCache.insert(key, entry);
+                sink += smallCache.getEvictions();
+            }));
+
+        reportBuffer report;
+        results.push_back(runBenchmark("generateReport rendering", count, count, [&]
+            {
+                for (const nutritionTracker& tracker : trackers)
+                {
+                    tracker.renderReport(report);
+                    sink += report.str().size();
+                }
+            }));
+    }
+
+    for (size_t length : arrayLengths)
+    {
+        vector<int> values(length);
+        for (int& value : values)
+            value = 1200 + static_cast<int>(random() % 2500);
+
+        nutritionTracker tracker;
+        results.push_back(runBenchmark("calculateAverageFromArray", length, length, [&]
+            {
+                sink += static_cast<long long>(tracker.calculateAverageFromArray(values.data(), static_cast<int>(length)));
+            }));
+    }
+
+    // Nearest-recipe lookups over a catalog the size of a full food database
+    {
+        const char* const sources[] = { "tofu", "tempeh", "seitan", "lentils", "chickpeas",
+            "black beans", "eggs", "greek yogurt", "cottage cheese", "edamame" };
+        const size_t catalogSize = 50000;
+        recipeCatalog catalog;
+
+        for (size_t i = 0; i < catalogSize; i++)
+        {
+            catalog.add({ "Recipe " + to_string(i), sources[random() % 10],
+                static_cast<float>(random() % 600) / 10.0f, static_cast<float>(random() % 1200) / 10.0f,
+                static_cast<float>(random() % 400) / 10.0f, "", "" });
+        }
+
+        catalog.build();
+
+        const size_t queryCount = 1000;
+        vector<int> queries(queryCount * 3);
+        for (int& value : queries)
+            value = 5 + static_cast<int>(random() % 60);
+
+        uint32_t matches[RECIPE_MATCH_COUNT];
+        results.push_back(runBenchmark("recipe nearest (k=3)", catalogSize, queryCount, [&]
+            {
+                for (size_t i = 0; i < queryCount; i++)
+                {
+                    sink += catalog.findNearest(queries[i * 3], queries[i * 3 + 1], queries[i * 3 + 2],
+                        string_view(), RECIPE_MATCH_COUNT, matches) + matches[0];
+                }
+            }));
+
+        results.push_back(runBenchmark("recipe nearest by protein", catalogSize, queryCount, [&]
+            {
+                for (size_t i = 0; i < queryCount; i++)
+                {
+                    sink += catalog.findNearest(queries[i * 3], queries[i * 3 + 1], queries[i * 3 + 2],
+                        sources[i % 10], RECIPE_MATCH_COUNT, matches) + matches[0];
+                }
+            }));
+
+        // Every solve uses a target not seen before, so the memo never answers
+        mealPlanner planner(catalog);
+        const size_t mealTargets = NUMBER_OF_DAYS * MEALS_PER_DAY_HIGH;
+        size_t targetNumber = 0;
+        results.push_back(runBenchmark("meal plan solve (uncached)", catalogSize, mealTargets, [&]
+            {
+                for (size_t i = 0; i < mealTargets; i++, targetNumber++)
+                {
+                    vector<mealSolution> meals = planner.solveMeal(20 + static_cast<int>(targetNumber % 50),
+                        30 + static_cast<int>(targetNumber / 50 % 100), 10 + static_cast<int>(targetNumber / 5000 % 40));
+                    sink += meals.size();
+                }
+            }));
+    }
+
+    bool pipelineAllocates = false;
+
+    {
+        // Whole batch pipeline (parse, targets, sessions, result row, report) over an
+        //    in-memory block. There are more distinct profiles than the macro cache
+        //    holds, so every row misses and evicts. After the warm-up pass has grown
+        //    the worker's buffers, a pass must make no heap allocations.
+        string input;
+        char row[160];
+
+        for (size_t i = 0; i < PIPELINE_BENCH_ROWS; i++)
+        {
+            int length = snprintf(row, sizeof(row), "Lifter %zu,tofu,%d,%d,%.1f,%d", i,
+                1500 + static_cast<int>(i % 2000), 2 + static_cast<int>(i / 2000 % 5),
+                (i / 10000 % 8) + (random() % 10) / 10.0, 1 + static_cast<int>(random() % 3));
+            input.append(row, length);
+
+            for (int day = 0; day < NUMBER_OF_DAYS; day++)
+            {
+                length = snprintf(row, sizeof(row), ",%d", 1200 + static_cast<int>(random() % 2500));
+                input.append(row, length);
+            }
+
+            input += '\n';
+        }
+
+        batchBlock block;
+        block.begin = input.data();
+        block.end = input.data() + input.size();
+
+        batchOptions options;
+        options.reportFile = "(in memory)";   // Render every report into block.reports
+
+        batchWorker worker;
+        benchmarkResult pipeline = runBenchmark("batch pipeline (steady state)", PIPELINE_BENCH_ROWS,
+            PIPELINE_BENCH_ROWS, [&]
+            {
+                sink += processBatchBlock(block, worker, options);
+            });
+
+        results.push_back(pipeline);
+        pipelineAllocates = (pipeline.allocationsPerOp > 0.0);
+
+        // The other paths: one report file per profile (--report-dir) and
+        //    malformed rows, whose messages go to block.errors
+        string mixedInput;
+        size_t rowStart = 0;
+
+        for (size_t i = 0; i < PIPELINE_BENCH_ROWS; i++)
+        {
+            size_t rowEnd = input.find('\n', rowStart) + 1;
+            mixedInput.append(input, rowStart, rowEnd - rowStart);
+            rowStart = rowEnd;
+
+            if (i % PIPELINE_BENCH_REJECT_EVERY == 0)
+                mixedInput += "Lifter,tofu,lots,3,4.0,1,2000,2000,2000,2000,2000,2000,2000\n";
+        }
+
+        const string reportDirectory = "bench_reports";
+        error_code ignored;
+        filesystem::create_directory(reportDirectory, ignored);
+
+        batchBlock mixedBlock;
+        mixedBlock.begin = mixedInput.data();
+        mixedBlock.end = mixedInput.data() + mixedInput.size();
+
+        batchOptions folderOptions;
+        folderOptions.reportDirectory = reportDirectory;
+
+        // Each pass is a new run over the same names, as a repeated --batch would be
+        reportFileNames reportNames;
+        reportNames.reserve(PIPELINE_BENCH_ROWS);
+
+        size_t mixedRows = PIPELINE_BENCH_ROWS + PIPELINE_BENCH_ROWS / PIPELINE_BENCH_REJECT_EVERY;
+        benchmarkResult folderPipeline = runBenchmark("batch pipeline (report dir, rejects)", mixedRows,
+            mixedRows, [&]
+            {
+                reportNames.clear();
+                sink += processBatchBlock(mixedBlock, worker, folderOptions, &reportNames);
+                sink += mixedBlock.errors.size();
+            });
+
+        results.push_back(folderPipeline);
+        pipelineAllocates = pipelineAllocates || (folderPipeline.allocationsPerOp > 0.0);
+        filesystem::remove_all(reportDirectory, ignored);
+    }
+
+    {
+        // Mixed readers and writers over many resident users, at increasing thread counts
+        sessionStore users;
+        vector<string> userNames(STORE_BENCH_USERS);
+        int calories[NUMBER_OF_DAYS];
+
+        for (size_t i = 0; i < STORE_BENCH_USERS; i++)
+        {
+            unique_ptr<nutritionTracker> tracker = make_unique<nutritionTracker>();
+
+            for (int day = 0; day < NUMBER_OF_DAYS; day++)
+                calories[day] = 1200 + static_cast<int>(random() % 2500);
+
+            userNames[i] = "Lifter " + to_string(i);
+            tracker->loadProfile(userNames[i], "tofu", 1500 + static_cast<int>(random() % 2000),
+                2 + static_cast<int>(random() % 5), (random() % 80) / 10.0, static_cast<GoalType>(random() % 3));
+            tracker->loadDailyCalories(calories);
+            tracker->calculateMacros();
+            tracker->fillSessionsFromCalories();
+            users.store(userNames[i], move(tracker));
+        }
+
+        for (int threadCount : { 1, 2, 4, 8 })
+            results.push_back(runSessionStoreStress(users, userNames, threadCount));
+
+        printSectionBreakLine();
+        printMemoryReport(cout, users.getMemoryUsage());
+    }
+
+    // Synced journal appends, then recovery after injected crashes
+    const string journalPath = "bench_journal.bin";
+    printSectionBreakLine();
+
+    for (int threadCount : { 1, 8 })
+        results.push_back(runJournalStress(journalPath, threadCount));
+
+    bool journalRecovers = runJournalCrashTests(journalPath);
+    remove(journalPath.c_str());
+
+    printSectionBreakLine();
+    runRestartBenchmark(results);
+
+    printSectionBreakLine();
+    runMultiplexBenchmark(results);
+
+    // Machine-readable results for comparing builds
+    ofstream outFile(resultsPath);
+
+    if (!outFile)
+    {
+        cerr << "Error: Unable to open " << resultsPath << "\n";
+        return 1;
+    }
+
+    outFile << "[\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const benchmarkResult& result = results[i];
+
+        outFile << "  {\"name\": \"" << result.name << "\", \"size\": " << result.dataSize
+            << fixed << setprecision(3)
+            << ", \"ns_per_op\": " << result.nsPerOp
+            << ", \"items_per_s\": " << result.itemsPerSecond
+            << ", \"allocs_per_op\": ";
+
+        // null: this build doesn't count allocations
+        if (result.allocationsPerOp < 0.0)
+            outFile << "null";
+        else
+            outFile << result.allocationsPerOp;
+
+        outFile << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    outFile << "]\n";
+
+    cout << "\nResults written to " << resultsPath << " (checksum " << sink << ")\n";
+
+    if (!TRACKER_COUNT_ALLOCATIONS)
+        cout << "Allocations were not counted; build with TRACKER_COUNT_ALLOCATIONS=1 to count them\n"
+            << "    and check that the batch pipeline makes none.\n";
+
+    if (pipelineAllocates)
+    {
+        cerr << "Error: the steady-state batch pipeline allocated memory\n";
+        return 1;
+    }
+
+    if (!journalRecovers)
+    {
+        cerr << "Error: journal recovery lost or invented records after a crash\n";
+        return 1;
+    }
+
+    if (!kernelMatches)
+    {
+        cerr << "Error: the SIMD macro kernel disagrees with the scalar code\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+bool checkMacroKernel(mt19937& random)
+{
+    profileColumns simd;
+    simd.resize(KERNEL_CHECK_ROWS);
+
+    // Every target and meal count batch mode accepts, not only realistic ones
+    for (size_t i = 0; i < KERNEL_CHECK_ROWS; i++)
+    {
+        simd.dailyCalories[i] = (i % 4 == 0) ? 1 + static_cast<int>(random() % INT_MAX) :
+            1 + static_cast<int>(random() % 10000);
+        simd.mealsPerDay[i] = (i % 4 == 1) ? 1 + static_cast<int>(random() % INT_MAX) :
+            1 + static_cast<int>(random() % 12);
+    }
+
+    profileColumns scalar = simd;
+    calculateMacrosColumns(simd, 0, KERNEL_CHECK_ROWS);
+    calculateMacrosColumnsScalar(scalar, 0, KERNEL_CHECK_ROWS);
+
+    bool matches = simd.dailyProteinGrams == scalar.dailyProteinGrams && simd.dailyCarbGrams == scalar.dailyCarbGrams &&
+        simd.dailyFatGrams == scalar.dailyFatGrams && simd.proteinPerMeal == scalar.proteinPerMeal &&
+        simd.carbsPerMeal == scalar.carbsPerMeal && simd.fatsPerMeal == scalar.fatsPerMeal;
+
+    cout << "Macro kernel check (" << KERNEL_CHECK_ROWS << " profiles): SIMD and scalar results "
+        << (matches ? "match" : "DIFFER") << "\n";
+    printSectionBreakLine();
+    return matches;
+}
+
+
+// --------------------- Instrumentation ---------------------
+trackerMetrics metrics;
+
+void trackerMetrics::recordStage(TrackerStage stage, long long elapsedNs)
+{
+    stageMetrics& timing = stages[stage];
+
+    timing.calls.fetch_add(1, memory_order_relaxed);
+    timing.totalNs.fetch_add(elapsedNs, memory_order_relaxed);
+
+    long long previousMax = timing.maxNs.load(memory_order_relaxed);
+    while (elapsedNs > previousMax &&
+        !timing.maxNs.compare_exchange_weak(previousMax, elapsedNs, memory_order_relaxed))
+    {
+    }
+
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKET_COUNT - 1 && (elapsedNs >> (bucket + 1)) > 0)
+        bucket++;
+
+    timing.buckets[bucket].fetch_add(1, memory_order_relaxed);
+}
+
+void trackerMetrics::printStats(ostream& out, bool includeHistograms) const
+{
+    out << left << setw(24) << "Stage" << right << setw(8) << "Calls" << setw(14) << "Total (ms)"
+        << setw(12) << "Mean (us)" << setw(12) << "Max (us)" << setw(12) << "p99 (us)" << "\n";
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        const stageMetrics& timing = stages[stage];
+        long long calls = timing.calls.load(memory_order_relaxed);
+
+        if (calls == 0)
+            continue;
+
+        // p99 is the upper bound of the bucket holding the 99th percentile call
+        long long target = (calls * 99 + 99) / 100;
+        long long seen = 0;
+        int p99Bucket = 0;
+
+        while (p99Bucket < LATENCY_BUCKET_COUNT - 1 &&
+            (seen += timing.buckets[p99Bucket].load(memory_order_relaxed)) < target)
+        {
+            p99Bucket++;
+        }
+
+        double totalNs = static_cast<double>(timing.totalNs.load(memory_order_relaxed));
+
+        out << left << setw(24) << getStageName(static_cast<TrackerStage>(stage)) << right << setw(8) << calls
+            << fixed << setprecision(3) << setw(14) << totalNs / 1e6
+            << setprecision(1) << setw(12) << totalNs / calls / 1e3
+            << setw(12) << timing.maxNs.load(memory_order_relaxed) / 1e3
+            << setw(12) << static_cast<double>(1LL << (p99Bucket + 1)) / 1e3 << "\n";
+    }
+
+    out << "\n";
+
+    for (int counter = 0; counter < COUNTER_COUNT; counter++)
+    {
+        out << left << setw(50) << setfill('.') << getCounterName(static_cast<TrackerCounter>(counter))
+            << right << counters[counter].load(memory_order_relaxed) << "\n";
+    }
+
+    long long frames = counters[COUNTER_FRAMES_PRESENTED].load(memory_order_relaxed);
+
+    if (frames > 0)
+    {
+        out << left << setw(50) << "Console writes per screen: " << right << fixed << setprecision(2)
+            << static_cast<double>(counters[COUNTER_FRAME_WRITES].load(memory_order_relaxed)) / frames << "\n";
+    }
+
+    out << setfill(' ');
+
+    if (!includeHistograms)
+        return;
+
+    out << "\nLatency histograms (bucket upper bound in ns: calls)\n";
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        if (stages[stage].calls.load(memory_order_relaxed) == 0)
+            continue;
+
+        out << getStageName(static_cast<TrackerStage>(stage)) << ":";
+
+        for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+        {
+            long long count = stages[stage].buckets[bucket].load(memory_order_relaxed);
+
+            if (count > 0)
+                out << " <" << (1LL << (bucket + 1)) << ": " << count;
+        }
+
+        out << "\n";
+    }
+}
+
+const char* getStageName(TrackerStage stage)
+{
+    static const char* const names[STAGE_COUNT] = {
+        "user input", "calorie log input", "calculate macros", "fill sessions",
+        "session history file", "report render", "report file I/O",
+        "menu: daily macros", "menu: report", "menu: nutrition check", "menu: calorie log",
+        "menu: sessions", "menu: macros 2D", "menu: range query", "menu: other",
+        "meal plan", "menu: meal plan", "menu: edit input"
+    };
+
+    return names[stage];
+}
+
+const char* getCounterName(TrackerCounter counter)
+{
+    static const char* const names[COUNTER_COUNT] = {
+        "Invalid text answers: ", "Invalid whole-number answers: ", "Invalid decimal answers: ",
+        "Invalid goal choices: ", "Invalid daily calorie entries: ", "Invalid menu choices: ",
+        "Reports written: ", "Report bytes written: ",
+        "Screens presented: ", "Console writes for screens: ", "Screen bytes written: ",
+        "Derived values recomputed after edits: ", "Derived values kept after edits: ",
+        "Journal records written: ", "Journal syncs (group commits): "
+    };
+
+    return names[counter];
+}
+
+TrackerStage getMenuStage(int menuChoice)
+{
+    switch (menuChoice)
+    {
+    case 1: return STAGE_MENU_DAILY_MACROS;
+    case 2: return STAGE_MENU_REPORT;
+    case 3: return STAGE_MENU_NUTRITION_CHECK;
+    case 4: return STAGE_MENU_CALORIE_LOG;
+    case 5: return STAGE_MENU_SESSIONS;
+    case 6: return STAGE_MENU_MACROS_2D;
+    case 8: return STAGE_MENU_RANGE_QUERY;
+    case 10: return STAGE_MENU_MEAL_PLAN;
+    case 11: return STAGE_MENU_EDIT_INPUT;
+    default: return STAGE_MENU_OTHER;
+    }
+}
+
+
+// --------------------- Console Frame ---------------------
+void consoleFrame::setColor(int color)
+{
+    colorChanges.push_back({ static_cast<size_t>(tellp()), color });
+}
+
+void consoleFrame::present()
+{
+    string text = str();
+
+    if (text.empty())
+        return;
+
+    str("");
+
+    // Replay is capturing the screen: plain text into cout's buffer
+    if (isConsoleCaptured())
+    {
+        cout << text;
+        colorChanges.clear();
+        return;
+    }
+
+    // Anything already sent through cout/printf must reach the screen first
+    cout.flush();
+    fflush(stdout);
+
+    ConsoleMode mode = getConsoleMode();
+    long long writes = 0;
+
+#ifdef _WIN32
+    if (mode == CONSOLE_ATTRIBUTES)
+    {
+        // No escape support: one write per colored segment
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        size_t start = 0;
+
+        for (const colorChange& change : colorChanges)
+        {
+            writes += writeConsole(text.data() + start, change.offset - start);
+            SetConsoleTextAttribute(hConsole, change.color);
+            writes++;
+            start = change.offset;
+        }
+
+        writes += writeConsole(text.data() + start, text.size() - start);
+        mode = CONSOLE_PLAIN;
+        text.clear();
+    }
+#endif
+
+    if (mode == CONSOLE_ANSI && !colorChanges.empty())
+    {
+        // Splice the escapes in at their offsets
+        string screen;
+        screen.reserve(text.size() + colorChanges.size() * 8);
+        size_t start = 0;
+
+        for (const colorChange& change : colorChanges)
+        {
+            screen.append(text, start, change.offset - start);
+            appendAnsiColor(screen, change.color);
+            start = change.offset;
+        }
+
+        screen.append(text, start, string::npos);
+        text.swap(screen);
+    }
+
+    if (!text.empty())
+        writes += writeConsole(text.data(), text.size());
+
+    COUNT_EVENT(COUNTER_FRAMES_PRESENTED, 1);
+    COUNT_EVENT(COUNTER_FRAME_WRITES, writes);
+    COUNT_EVENT(COUNTER_FRAME_BYTES, static_cast<long long>(text.size()));
+
+    colorChanges.clear();
+}
+
+ConsoleMode getConsoleMode()
+{
+    static const ConsoleMode mode = []
+        {
+#ifdef _WIN32
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+            HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+            DWORD consoleMode = 0;
+
+            if (!GetConsoleMode(hConsole, &consoleMode))
+                return CONSOLE_PLAIN;
+
+            // Windows 10 and later can process ANSI escapes once asked to
+            if (SetConsoleMode(hConsole, consoleMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+                return CONSOLE_ANSI;
+
+            return CONSOLE_ATTRIBUTES;
+#else
+            return isatty(STDOUT_FILENO) ? CONSOLE_ANSI : CONSOLE_PLAIN;
+#endif
+        }();
+
+    return mode;
+}
+
+// Maps a console attribute color (bit 0 blue, 1 green, 2 red, 3 bright) to
+//    an ANSI foreground color; COLOR_DEFAULT resets to the terminal default
+void appendAnsiColor(string& text, int color)
+{
+    if (color == COLOR_DEFAULT)
+    {
+        text += "\x1b[0m";
+        return;
+    }
+
+    int ansiColor = ((color & 4) ? 1 : 0) + ((color & 2) ? 2 : 0) + ((color & 1) ? 4 : 0);
+    char escape[8];
+    snprintf(escape, sizeof(escape), "\x1b[%dm", ((color & 8) ? 90 : 30) + ansiColor);
+    text += escape;
+}
+
+// The first call remembers cout's real buffer; replay calls it before redirecting
+bool isConsoleCaptured()
+{
+    static streambuf* const consoleBuffer = cout.rdbuf();
+    return cout.rdbuf() != consoleBuffer;
+}
+
+long long writeConsole(const char* text, size_t length)
+{
+    long long writes = 0;
+
+    while (length > 0)
+    {
+#ifdef _WIN32
+        DWORD written = 0;
+        DWORD chunk = static_cast<DWORD>(min<size_t>(length, 1u << 30));
+        writes++;
+
+        if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), text, chunk, &written, nullptr) || written == 0)
+            break;
+#else
+        writes++;
+        ssize_t written = ::write(STDOUT_FILENO, text, length);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0)
+            break;
+#endif
+        text += written;
+        length -= static_cast<size_t>(written);
+    }
+
+    return writes;
+}
+
+
+// --------------------- Recipe Catalog ---------------------
+bool recipeCatalog::load(const string& path)
+{
+    ifstream inFile(path);
+
+    if (!inFile)
+        return false;
+
+    string line;
+    string_view fields[RECIPE_FIELD_COUNT];
+
+    while (getline(inFile, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        // Split on commas; ingredients use ';' so they never contain one
+        string_view rest = line;
+        int fieldCount = 0;
+
+        while (fieldCount < RECIPE_FIELD_COUNT)
+        {
+            size_t comma = rest.find(',');
+            fields[fieldCount++] = trimBatchField(rest.substr(0, comma));
+
+            if (comma == string_view::npos)
+                break;
+            rest.remove_prefix(comma + 1);
+        }
+
+        double protein = 0.0;
+        double carbs = 0.0;
+        double fat = 0.0;
+
+        // Skips the header row, blank lines and anything malformed
+        if (fieldCount < RECIPE_FIELD_COUNT - 1 || fields[0].empty() ||
+            !parseBatchDouble(fields[2], protein) || !parseBatchDouble(fields[3], carbs) ||
+            !parseBatchDouble(fields[4], fat) || protein < 0.0 || carbs < 0.0 || fat < 0.0)
+        {
+            continue;
+        }
+
+        add({ string(fields[0]), string(fields[1]), static_cast<float>(protein), static_cast<float>(carbs),
+            static_cast<float>(fat), string(fields[5]),
+            fieldCount == RECIPE_FIELD_COUNT ? string(fields[6]) : string() });
+    }
+
+    return true;
+}
+
+void recipeCatalog::add(const recipeEntry& recipe)
+{
+    string source(trimBatchField(recipe.proteinSource));
+    transform(source.begin(), source.end(), source.begin(),
+        [](unsigned char c) { return static_cast<char>(tolower(c)); });
+
+    size_t sourceId = find(sourceNames.begin(), sourceNames.end(), source) - sourceNames.begin();
+    if (sourceId == sourceNames.size())
+        sourceNames.push_back(source);
+
+    recipes.push_back(recipe);
+    points.push_back(recipe.protein);
+    points.push_back(recipe.carbs);
+    points.push_back(recipe.fat);
+    sourceIds.push_back(static_cast<uint32_t>(sourceId));
+}
+
+void recipeCatalog::build()
+{
+    size_t count = recipes.size();
+
+    // First range: every recipe. Then one range per protein source.
+    treeOrder.resize(count * 2);
+    for (size_t i = 0; i < count; i++)
+        treeOrder[i] = static_cast<uint32_t>(i);
+
+    vector<size_t> sourceCounts(sourceNames.size(), 0);
+    for (uint32_t sourceId : sourceIds)
+        sourceCounts[sourceId]++;
+
+    sourceTrees.resize(sourceNames.size());
+    size_t next = count;
+    for (size_t sourceId = 0; sourceId < sourceNames.size(); sourceId++)
+    {
+        sourceTrees[sourceId] = { next, next };
+        next += sourceCounts[sourceId];
+    }
+
+    for (size_t i = 0; i < count; i++)
+        treeOrder[sourceTrees[sourceIds[i]].end++] = static_cast<uint32_t>(i);
+
+    allRecipes = { 0, count };
+    buildTree(allRecipes.begin, allRecipes.end, 0);
+
+    for (const treeRange& tree : sourceTrees)
+        buildTree(tree.begin, tree.end, 0);
+}
+
+// The median of each range on the split axis is its node; smaller values sit
+//    to its left, larger to its right
+void recipeCatalog::buildTree(size_t begin, size_t end, int axis)
+{
+    if (end - begin <= 1)
+        return;
+
+    size_t middle = begin + (end - begin) / 2;
+    nth_element(treeOrder.begin() + begin, treeOrder.begin() + middle, treeOrder.begin() + end,
+        [this, axis](uint32_t a, uint32_t b) { return points[a * 3 + axis] < points[b * 3 + axis]; });
+
+    int nextAxis = (axis + 1) % 3;
+    buildTree(begin, middle, nextAxis);
+    buildTree(middle + 1, end, nextAxis);
+}
+
+size_t recipeCatalog::findNearest(double protein, double carbs, double fat, string_view proteinSource,
+    size_t k, uint32_t results[]) const
+{
+    int sourceId = proteinSource.empty() ? -1 : findSourceId(proteinSource);
+    const treeRange& tree = sourceId >= 0 ? sourceTrees[sourceId] : allRecipes;
+
+    const float target[3] = { static_cast<float>(protein), static_cast<float>(carbs), static_cast<float>(fat) };
+    float distances[RECIPE_MATCH_COUNT * 4];
+    size_t found = 0;
+
+    k = min<size_t>(k, sizeof(distances) / sizeof(distances[0]));
+    searchTree(tree.begin, tree.end, 0, target, k, results, distances, found);
+
+    return found;
+}
+
+void recipeCatalog::searchTree(size_t begin, size_t end, int axis, const float target[], size_t k,
+    uint32_t results[], float distances[], size_t& found) const
+{
+    if (begin >= end || k == 0)
+        return;
+
+    size_t middle = begin + (end - begin) / 2;
+    uint32_t index = treeOrder[middle];
+    const float* point = &points[index * 3];
+
+    float distance = 0.0f;
+    for (int i = 0; i < 3; i++)
+        distance += (point[i] - target[i]) * (point[i] - target[i]);
+
+    // Keep the k best sorted by distance (k is tiny, so insertion is cheapest)
+    if (found < k || distance < distances[found - 1])
+    {
+        size_t slot = found < k ? found++ : found - 1;
+
+        while (slot > 0 && distances[slot - 1] > distance)
+        {
+            distances[slot] = distances[slot - 1];
+            results[slot] = results[slot - 1];
+            slot--;
+        }
+
+        distances[slot] = distance;
+        results[slot] = index;
+    }
+
+    float split = target[axis] - point[axis];
+    int nextAxis = (axis + 1) % 3;
+
+    if (split < 0.0f)
+        searchTree(begin, middle, nextAxis, target, k, results, distances, found);
+    else
+        searchTree(middle + 1, end, nextAxis, target, k, results, distances, found);
+
+    // The far side can only help if the splitting plane is closer than the worst match
+    if (found < k || split * split < distances[found - 1])
+    {
+        if (split < 0.0f)
+            searchTree(middle + 1, end, nextAxis, target, k, results, distances, found);
+        else
+            searchTree(begin, middle, nextAxis, target, k, results, distances, found);
+    }
+}
+
+// Case-insensitive; "smoked tofu" also matches the "tofu" source
+int recipeCatalog::findSourceId(string_view proteinSource) const
+{
+    string wanted(trimBatchField(proteinSource));
+    transform(wanted.begin(), wanted.end(), wanted.begin(),
+        [](unsigned char c) { return static_cast<char>(tolower(c)); });
+
+    if (wanted.empty())
+        return -1;
+
+    for (size_t sourceId = 0; sourceId < sourceNames.size(); sourceId++)
+    {
+        if (sourceNames[sourceId] == wanted)
+            return static_cast<int>(sourceId);
+    }
+
+    for (size_t sourceId = 0; sourceId < sourceNames.size(); sourceId++)
+    {
+        if (!sourceNames[sourceId].empty() && wanted.find(sourceNames[sourceId]) != string::npos)
+            return static_cast<int>(sourceId);
+    }
+
+    return -1;
+}
+
+const recipeCatalog& getRecipeCatalog()
+{
+    static const recipeCatalog catalog = []
+        {
+            recipeCatalog loaded;
+
+            // Without a catalog file, fall back to the original smoothie
+            if (!loaded.load(RECIPE_CATALOG_FILE) || loaded.size() == 0)
+            {
+                loaded.add({ "Oatmeal Smoothie", "protein powder", 30.0f, 37.0f, 13.0f,
+                    "1/4 cup rolled oats;2 tbsp cocoa powder;1/4 cup protein powder;1 tbsp maple syrup;"
+                    "1 tbsp chia seeds;1 tbsp peanut butter;3/4 cup almond milk",
+                    "Blend all ingredients until smooth." });
+            }
+
+            loaded.build();
+            return loaded;
+        }();
+
+    return catalog;
+}
+
+
+// --------------------- Advice Rules ---------------------
+void adviceRules::loadDefaults()
+{
+    const double any = HUGE_VAL;
+
+    rules.clear();
+    source = "built-in";
+
+    // The old if/else chains in order. Bounds are [minimum, maximum), so
+    //    "calories > CAL_EXCESS" starts at CAL_EXCESS + 1.
+    add({ ADVICE_NUTRITION, { ACTIVITY_HIGH, CAL_HIGH, -any }, { any, any, any },
+        "Your intake is sufficient for a high activity week. Keep it up!" });
+    add({ ADVICE_NUTRITION, { ACTIVITY_MEDIUM, CAL_MEDIUM, -any }, { any, any, any },
+        "Your intake is decent for your activity level, but you could increase protein slightly." });
+    add({ ADVICE_NUTRITION, { -any, -any, -any }, { ACTIVITY_MEDIUM, CAL_LOW, any },
+        "You might be under fueling. Consider adding extra calories per day." });
+    add({ ADVICE_NUTRITION, { -any, CAL_EXCESS + 1, -any }, { ACTIVITY_MEDIUM, any, any },
+        "You may be eating more than your activity requires. Consider slightly reducing calories per day." });
+    add({ ADVICE_NUTRITION, { -any, -any, -any }, { any, any, any },
+        "Your calorie intake seems balanced for your activity level." });
+
+    add({ ADVICE_MEAL_FREQUENCY, { ACTIVITY_HIGH, -any, MEALS_PER_WEEK_MEDIUM }, { any, any, MEALS_PER_WEEK_HIGH + 1 },
+        "Excellent meal frequency for muscle recovery!" });
+    add({ ADVICE_MEAL_FREQUENCY, { ACTIVITY_MEDIUM, -any, -any }, { any, any, MEALS_PER_WEEK_MEDIUM },
+        "Consider eating more often to support your training." });
+    add({ ADVICE_MEAL_FREQUENCY, { -any, -any, MEALS_PER_WEEK_HIGH + 1 }, { any, any, any },
+        "You might be eating more than necessary  ensure portion sizes are balanced." });
+    add({ ADVICE_MEAL_FREQUENCY, { -any, -any, -any }, { any, any, any },
+        "Your meal frequency seems appropriate for your activity level." });
+
+    compile();
+}
+
+bool adviceRules::load(const string& path)
+{
+    ifstream inFile(path);
+
+    if (!inFile)
+        return false;
+
+    adviceRules loaded;
+    loaded.source = path;
+
+    string line;
+    string_view fields[ADVICE_RULE_FIELD_COUNT];
+    int lineNumber = 0;
+    int badRows = 0;
+
+    while (getline(inFile, line))
+    {
+        lineNumber++;
+
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (trimBatchField(line).empty())
+            continue;
+
+        // The advice is the rest of the line, so it may contain commas
+        string_view rest = line;
+        int fieldCount = 0;
+
+        while (fieldCount < ADVICE_RULE_FIELD_COUNT)
+        {
+            size_t comma = (fieldCount + 1 < ADVICE_RULE_FIELD_COUNT) ? rest.find(',') : string_view::npos;
+            fields[fieldCount++] = trimBatchField(rest.substr(0, comma));
+
+            if (comma == string_view::npos)
+                break;
+            rest.remove_prefix(comma + 1);
+        }
+
+        // The header row names the columns
+        if (lineNumber == 1 && fields[0] == "category")
+            continue;
+
+        adviceRule rule;
+        string problem;
+
+        if (fieldCount != ADVICE_RULE_FIELD_COUNT)
+            problem = "expected " + to_string(ADVICE_RULE_FIELD_COUNT) + " fields, found " + to_string(fieldCount);
+        else if (fields[7].empty())
+            problem = "the advice text is empty";
+        else if (fields[0] == "nutrition")
+            rule.category = ADVICE_NUTRITION;
+        else if (fields[0] == "meals")
+            rule.category = ADVICE_MEAL_FREQUENCY;
+        else
+            problem = "unknown category \"" + string(fields[0]) + "\" (expected nutrition or meals)";
+
+        // An empty bound is unbounded
+        for (int axis = 0; problem.empty() && axis < ADVICE_AXIS_COUNT; axis++)
+        {
+            string_view low = fields[1 + axis * 2];
+            string_view high = fields[2 + axis * 2];
+
+            rule.minimum[axis] = -HUGE_VAL;
+            rule.maximum[axis] = HUGE_VAL;
+
+            if (!low.empty() && !parseBatchDouble(low, rule.minimum[axis]))
+                problem = "\"" + string(low) + "\" is not a number";
+            else if (!high.empty() && !parseBatchDouble(high, rule.maximum[axis]))
+                problem = "\"" + string(high) + "\" is not a number";
+            else if (rule.minimum[axis] >= rule.maximum[axis])
+                problem = "a minimum is not below its maximum, so the row never matches";
+        }
+
+        if (!problem.empty())
+        {
+            cerr << path << ':' << lineNumber << ": " << problem << "\n";
+            badRows++;
+            continue;
+        }
+
+        rule.text = string(fields[7]);
+        loaded.add(rule);
+    }
+
+    if (badRows > 0)
+        return false;
+
+    if (loaded.size() == 0)
+    {
+        cerr << path << ": no advice rules\n";
+        return false;
+    }
+
+    if (loaded.size() >= ADVICE_NONE)
+    {
+        cerr << path << ": more than " << ADVICE_NONE - 1 << " advice rules\n";
+        return false;
+    }
+
+    if (!loaded.compile())
+    {
+        cerr << path << ": the rules use too many different bounds to compile\n";
+        return false;
+    }
+
+    // Without a row that matches everything, some profiles get no advice
+    const char* const categoryNames[ADVICE_CATEGORY_COUNT] = { "nutrition", "meals" };
+
+    for (int category = 0; category < ADVICE_CATEGORY_COUNT; category++)
+    {
+        bool hasCatchAll = false;
+
+        for (const adviceRule& rule : loaded.rules)
+        {
+            bool unbounded = (rule.category == category);
+
+            for (int axis = 0; unbounded && axis < ADVICE_AXIS_COUNT; axis++)
+                unbounded = isinf(rule.minimum[axis]) && isinf(rule.maximum[axis]);
+
+            hasCatchAll = hasCatchAll || unbounded;
+        }
+
+        if (!hasCatchAll)
+        {
+            cerr << "Warning: " << path << " has no catch-all " << categoryNames[category]
+                << " rule (all bounds empty), so some profiles get no " << categoryNames[category] << " advice.\n";
+        }
+    }
+
+    *this = move(loaded);
+    return true;
+}
+
+void adviceRules::add(const adviceRule& rule)
+{
+    rules.push_back(rule);
+}
+
+bool adviceRules::compile()
+{
+    // Every finite bound splits its axis into buckets
+    cellCount = 1;
+
+    for (int axis = 0; axis < ADVICE_AXIS_COUNT; axis++)
+    {
+        vector<double>& axisCuts = cuts[axis];
+        axisCuts.clear();
+
+        for (const adviceRule& rule : rules)
+        {
+            if (isfinite(rule.minimum[axis]))
+                axisCuts.push_back(rule.minimum[axis]);
+            if (isfinite(rule.maximum[axis]))
+                axisCuts.push_back(rule.maximum[axis]);
+        }
+
+        sort(axisCuts.begin(), axisCuts.end());
+        axisCuts.erase(unique(axisCuts.begin(), axisCuts.end()), axisCuts.end());
+        cellCount *= axisCuts.size() + 1;
+
+        if (cellCount * ADVICE_CATEGORY_COUNT > ADVICE_TABLE_MAX_CELLS)
+        {
+            cellCount = 0;
+            table.clear();
+            return false;
+        }
+    }
+
+    table.assign(cellCount * ADVICE_CATEGORY_COUNT, ADVICE_NONE);
+
+    // A bucket lies wholly inside or outside every rule's range, so testing
+    //    its lower edge decides the whole bucket
+    for (size_t cell = 0; cell < cellCount; cell++)
+    {
+        double lowerEdge[ADVICE_AXIS_COUNT];
+        size_t rest = cell;
+
+        for (int axis = ADVICE_AXIS_COUNT - 1; axis >= 0; axis--)
+        {
+            size_t bucket = rest % (cuts[axis].size() + 1);
+            rest /= cuts[axis].size() + 1;
+            lowerEdge[axis] = (bucket == 0) ? -HUGE_VAL : cuts[axis][bucket - 1];
+        }
+
+        for (int category = 0; category < ADVICE_CATEGORY_COUNT; category++)
+        {
+            for (size_t id = 0; id < rules.size(); id++)
+            {
+                const adviceRule& rule = rules[id];
+                bool matches = (rule.category == category);
+
+                for (int axis = 0; matches && axis < ADVICE_AXIS_COUNT; axis++)
+                    matches = (rule.minimum[axis] <= lowerEdge[axis] && lowerEdge[axis] < rule.maximum[axis]);
+
+                if (matches)
+                {
+                    table[category * cellCount + cell] = static_cast<uint16_t>(id);
+                    break;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+size_t adviceRules::findCell(double workoutHours, double dailyCalories, double mealsPerWeek) const
+{
+    const double values[ADVICE_AXIS_COUNT] = { workoutHours, dailyCalories, mealsPerWeek };
+    size_t cell = 0;
+
+    for (int axis = 0; axis < ADVICE_AXIS_COUNT; axis++)
+    {
+        // Adding up the compares keeps the profile's values out of any branch
+        size_t bucket = 0;
+        for (double cut : cuts[axis])
+            bucket += (values[axis] >= cut);
+
+        cell = cell * (cuts[axis].size() + 1) + bucket;
+    }
+
+    return cell;
+}
+
+uint16_t adviceRules::classify(AdviceCategory category, double workoutHours, int dailyCalories, int mealsPerWeek) const
+{
+    return table[category * cellCount + findCell(workoutHours, dailyCalories, mealsPerWeek)];
+}
+
+void adviceRules::classifyColumns(profileColumns& columns, size_t begin, size_t end) const
+{
+    const uint16_t* nutritionTable = &table[ADVICE_NUTRITION * cellCount];
+    const uint16_t* mealTable = &table[ADVICE_MEAL_FREQUENCY * cellCount];
+
+    // One cell serves both categories
+    for (size_t i = begin; i < end; i++)
+    {
+        size_t cell = findCell(columns.weeklyWorkoutHours[i], columns.dailyCalories[i],
+            static_cast<double>(columns.mealsPerDay[i]) * NUMBER_OF_DAYS);
+
+        columns.nutritionAdvice[i] = nutritionTable[cell];
+        columns.mealAdvice[i] = mealTable[cell];
+    }
+}
+
+adviceRules& getAdviceRules()
+{
+    static adviceRules rules = []
+        {
+            adviceRules loaded;
+
+            // Without a rules file, the rules the tracker has always given
+            if (!loaded.load(ADVICE_RULES_FILE))
+            {
+                if (ifstream(ADVICE_RULES_FILE))
+                    cerr << "Warning: " << ADVICE_RULES_FILE << " could not be used, so the built-in advice rules apply.\n";
+
+                loaded.loadDefaults();
+            }
+
+            return loaded;
+        }();
+
+    return rules;
+}
+
+
+// --------------------- Meal Planner ---------------------
+mealPlanner::mealPlanner(const recipeCatalog& foods)
+    : catalog(foods)
+{
+}
+
+vector<mealSolution> mealPlanner::solveMeal(int protein, int carbs, int fat)
+{
+    // Each macro has MEAL_PLAN_MEMO_KEY_BITS of the key, so only targets that fit are memoized
+    const int keyLimit = 1 << MEAL_PLAN_MEMO_KEY_BITS;
+    bool memoized = protein >= 0 && protein < keyLimit && carbs >= 0 && carbs < keyLimit &&
+        fat >= 0 && fat < keyLimit;
+    uint64_t key = (static_cast<uint64_t>(protein) << (2 * MEAL_PLAN_MEMO_KEY_BITS)) |
+        (static_cast<uint64_t>(carbs) << MEAL_PLAN_MEMO_KEY_BITS) | static_cast<uint64_t>(fat);
+
+    if (memoized)
+    {
+        lock_guard<mutex> guard(memoLock);
+        auto found = memo.find(key);
+
+        if (found != memo.end())
+        {
+            memoHits.fetch_add(1, memory_order_relaxed);
+            return found->second;
+        }
+    }
+
+    memoMisses.fetch_add(1, memory_order_relaxed);
+
+    mealSearch search;
+    search.target[0] = static_cast<float>(protein);
+    search.target[1] = static_cast<float>(carbs);
+    search.target[2] = static_cast<float>(fat);
+    search.cutoff.store(numeric_limits<float>::infinity(), memory_order_relaxed);
+    gatherCandidates(search);
+
+    // One task per first food; each explores every meal that starts with it
+    auto branch = [this, &search](size_t task, int)
+        {
+            const float* macros = &search.candidateMacros[task * 3];
+            mealPortion portions[MEAL_PLAN_MAX_FOODS];
+            portions[0] = search.candidates[task];
+            return searchBranch(search, task + 1, 1, macros, portions);
+        };
+
+    // A busy pool (another solve, or batch mode calling in from a worker) means searching inline
+    if (!getSharedPool().tryRun(search.candidates.size(), branch))
+    {
+        for (size_t task = 0; task < search.candidates.size(); task++)
+            branch(task, 0);
+    }
+
+    if (!memoized)
+        return search.best;
+
+    lock_guard<mutex> guard(memoLock);
+
+    if (memo.size() >= MEAL_PLAN_MEMO_LIMIT && memo.find(key) == memo.end())
+        memo.erase(memo.begin());
+
+    return memo.emplace(key, search.best).first->second;
+}
+
+// Nearest foods to the target split across 1 to MEAL_PLAN_MAX_FOODS foods,
+//    at every portion size
+void mealPlanner::gatherCandidates(mealSearch& search) const
+{
+    vector<uint8_t> seen(catalog.size() * (MEAL_PLAN_MAX_HALF_SERVINGS + 1), 0);
+    uint32_t matches[MEAL_PLAN_NEIGHBORS];
+
+    for (int share = 1; share <= MEAL_PLAN_MAX_FOODS; share++)
+    {
+        for (int halfServings = 1; halfServings <= MEAL_PLAN_MAX_HALF_SERVINGS; halfServings++)
+        {
+            float scale = 2.0f / (share * halfServings);   // Target per serving of one food
+            size_t found = catalog.findNearest(search.target[0] * scale, search.target[1] * scale,
+                search.target[2] * scale, string_view(), MEAL_PLAN_NEIGHBORS, matches);
+
+            for (size_t i = 0; i < found; i++)
+            {
+                uint8_t& marked = seen[matches[i] * (MEAL_PLAN_MAX_HALF_SERVINGS + 1) + halfServings];
+
+                if (marked)
+                    continue;
+                marked = 1;
+
+                const recipeEntry& food = catalog[matches[i]];
+                float servings = halfServings / 2.0f;
+                search.candidates.push_back({ matches[i], static_cast<uint8_t>(halfServings) });
+                search.candidateMacros.push_back(food.protein * servings);
+                search.candidateMacros.push_back(food.carbs * servings);
+                search.candidateMacros.push_back(food.fat * servings);
+            }
+        }
+    }
+}
+
+// Depth-first over foods after `next`. Overshoot can only grow as foods are
+//    added, so a branch whose overshoot already exceeds the worst kept meal
+//    is cut. Returns the number of meals examined.
+size_t mealPlanner::searchBranch(mealSearch& search, size_t next, int depth, const float totals[],
+    mealPortion portions[]) const
+{
+    float overshoot = 0.0f;
+    for (int i = 0; i < 3; i++)
+        overshoot += max(0.0f, totals[i] - search.target[i]);
+
+    if (overshoot > search.cutoff.load(memory_order_relaxed))
+        return 1;
+
+    offerSolution(search, totals, portions, depth);
+
+    if (depth == MEAL_PLAN_MAX_FOODS)
+        return 1;
+
+    size_t examined = 1;
+
+    for (size_t candidate = next; candidate < search.candidates.size(); candidate++)
+    {
+        // One portion size per food in a meal
+        bool repeated = false;
+        for (int i = 0; i < depth; i++)
+            repeated = repeated || portions[i].recipe == search.candidates[candidate].recipe;
+
+        if (repeated)
+            continue;
+
+        const float* macros = &search.candidateMacros[candidate * 3];
+        float nextTotals[3] = { totals[0] + macros[0], totals[1] + macros[1], totals[2] + macros[2] };
+        portions[depth] = search.candidates[candidate];
+        examined += searchBranch(search, candidate + 1, depth + 1, nextTotals, portions);
+    }
+
+    return examined;
+}
+
+// Keeps the best meal per set of foods, ordered by error and then by the
+//    foods themselves so the result doesn't depend on thread timing
+void mealPlanner::offerSolution(mealSearch& search, const float totals[], const mealPortion portions[], int count) const
+{
+    float error = 0.0f;
+    for (int i = 0; i < 3; i++)
+        error += fabs(totals[i] - search.target[i]);
+
+    if (error > search.cutoff.load(memory_order_relaxed))
+        return;
+
+    mealSolution solution;
+    solution.portionCount = count;
+    solution.protein = totals[0];
+    solution.carbs = totals[1];
+    solution.fat = totals[2];
+    solution.error = error;
+
+    // Foods in recipe order (insertion sort; a meal has at most 3)
+    for (int i = 0; i < count; i++)
+    {
+        int slot = i;
+        while (slot > 0 && solution.portions[slot - 1].recipe > portions[i].recipe)
+        {
+            solution.portions[slot] = solution.portions[slot - 1];
+            slot--;
+        }
+        solution.portions[slot] = portions[i];
+    }
+
+    auto sameFoods = [](const mealSolution& a, const mealSolution& b)
+        {
+            if (a.portionCount != b.portionCount)
+                return false;
+            for (int i = 0; i < a.portionCount; i++)
+                if (a.portions[i].recipe != b.portions[i].recipe)
+                    return false;
+            return true;
+        };
+
+    auto better = [](const mealSolution& a, const mealSolution& b)
+        {
+            if (a.error != b.error)
+                return a.error < b.error;
+            if (a.portionCount != b.portionCount)
+                return a.portionCount < b.portionCount;
+            for (int i = 0; i < a.portionCount; i++)
+            {
+                if (a.portions[i].recipe != b.portions[i].recipe)
+                    return a.portions[i].recipe < b.portions[i].recipe;
+                if (a.portions[i].halfServings != b.portions[i].halfServings)
+                    return a.portions[i].halfServings < b.portions[i].halfServings;
+            }
+            return false;
+        };
+
+    lock_guard<mutex> guard(search.bestLock);
+    vector<mealSolution>& best = search.best;
+
+    auto existing = find_if(best.begin(), best.end(),
+        [&](const mealSolution& kept) { return sameFoods(kept, solution); });
+
+    if (existing != best.end())
+    {
+        if (!better(solution, *existing))
+            return;
+        best.erase(existing);
+    }
+    else if (best.size() == MEAL_PLAN_VARIETY && !better(solution, best.back()))
+    {
+        return;
+    }
+
+    best.insert(upper_bound(best.begin(), best.end(), solution, better), solution);
+
+    if (best.size() > MEAL_PLAN_VARIETY)
+        best.pop_back();
+
+    if (best.size() == MEAL_PLAN_VARIETY)
+        search.cutoff.store(best.back().error, memory_order_relaxed);
+}
+
+mealPlanner& getMealPlanner()
+{
+    static mealPlanner planner(getRecipeCatalog());
+    return planner;
+}
+
+
+// --------------------- Server Mode ---------------------
+#ifdef __linux__
+volatile sig_atomic_t serverStopping = 0;
+
+void stopServer(int)
+{
+    serverStopping = 1;
+}
+
+// Reads what the socket has and answers every complete line. Returns false
+//    once the peer has hung up or the socket failed.
+bool readServerRequests(serverConnection& connection, serverScratch& scratch)
+{
+    bool peerOpen = true;
+
+    while (connection.output.size() - connection.outputStart < SERVER_MAX_PENDING_OUTPUT && !connection.closing)
+    {
+        size_t used = connection.input.size();
+        connection.input.resize(used + SERVER_READ_BYTES);
+        ssize_t received = recv(connection.socket, &connection.input[used], SERVER_READ_BYTES, 0);
+        connection.input.resize(used + (received > 0 ? received : 0));
+
+        if (received == 0)
+        {
+            peerOpen = false;
+            break;
+        }
+
+        if (received < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            peerOpen = (errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+        }
+
+        // Pipelined requests: answer every complete line in order
+        size_t lineEnd;
+        while (!connection.closing &&
+            (lineEnd = connection.input.find('\n', connection.inputStart)) != string::npos)
+        {
+            string_view line(connection.input.data() + connection.inputStart, lineEnd - connection.inputStart);
+            connection.inputStart = lineEnd + 1;
+
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+
+            if (!line.empty())
+                handleServerRequest(connection, line, scratch);
+        }
+
+        if (connection.input.size() - connection.inputStart > SERVER_MAX_LINE)
+        {
+            connection.output += "ERR request line too long\n";
+            connection.closing = true;
+        }
+
+        // Drop handled bytes; the partial line (if any) moves to the front
+        connection.input.erase(0, connection.inputStart);
+        connection.inputStart = 0;
+    }
+
+    return peerOpen;
+}
+
+// Sends as much pending output as the socket takes. Returns false on error.
+bool flushServerOutput(serverConnection& connection)
+{
+    while (connection.outputStart < connection.output.size())
+    {
+        ssize_t sent = send(connection.socket, connection.output.data() + connection.outputStart,
+            connection.output.size() - connection.outputStart, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        connection.outputStart += sent;
+    }
+
+    connection.output.clear();
+    connection.outputStart = 0;
+    return true;
+}
+
+int openServerListener(const string& socketPath)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+    {
+        cerr << "Error: Socket path must be 1 to " << sizeof(address.sun_path) - 1 << " characters\n";
+        return -1;
+    }
+
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(socketPath.c_str());   // Left behind by a server that didn't shut down cleanly
+
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listener, SOMAXCONN) < 0)
+    {
+        cerr << "Error: Unable to listen on " << socketPath << ": " << strerror(errno) << "\n";
+        if (listener >= 0)
+            close(listener);
+        return -1;
+    }
+
+    return listener;
+}
+#endif
+
+int runServerMode(const string& socketPath)
+{
+#ifdef __linux__
+    int listener = openServerListener(socketPath);
+
+    if (listener < 0)
+        return 1;
+
+    int epollHandle = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN;
+    listenEvent.data.ptr = nullptr;   // nullptr marks the listening socket
+    epoll_ctl(epollHandle, EPOLL_CTL_ADD, listener, &listenEvent);
+
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+
+    // Users the last server had come back before the first request
+    auto startTime = chrono::steady_clock::now();
+    string journalPath = socketPath + SERVER_JOURNAL_SUFFIX;
+    string snapshotPath = socketPath + SERVER_SNAPSHOT_SUFFIX;
+    serverScratch scratch;
+    calorieJournal& journal = getJournal();
+
+    restoreServerUsers(snapshotPath, journalPath, scratch);
+
+    if (!journal.open(journalPath))
+        cerr << "Warning: Unable to open " << journalPath << "; changes will not survive a crash\n";
+
+    cout << "Serving on " << socketPath << " (Ctrl+C to stop), ready after " << fixed << setprecision(1)
+        << chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count() << " ms\n";
+    cout.flush();
+
+    unordered_map<int, unique_ptr<serverConnection>> connections;
+    epoll_event events[SERVER_MAX_EVENTS];
+    bool peerOpen[SERVER_MAX_EVENTS];
+    long long acceptedCount = 0;
+
+    while (!serverStopping)
+    {
+        // Wake up once a second while a snapshot may come due or is being written
+        bool snapshotPending = scratch.changes != scratch.snapshotChanges || scratch.snapshotWriter != 0;
+        int ready = epoll_wait(epollHandle, events, SERVER_MAX_EVENTS, snapshotPending ? 1000 : -1);
+
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            cerr << "Error: epoll_wait failed: " << strerror(errno) << "\n";
+            break;
+        }
+
+        for (int i = 0; i < ready; i++)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                int client;
+                while ((client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    auto connection = make_unique<serverConnection>();
+                    connection->socket = client;
+                    connection->events = EPOLLIN;
+
+                    epoll_event clientEvent{};
+                    clientEvent.events = connection->events;
+                    clientEvent.data.ptr = connection.get();
+                    epoll_ctl(epollHandle, EPOLL_CTL_ADD, client, &clientEvent);
+
+                    connections.emplace(client, move(connection));
+                    acceptedCount++;
+                }
+                continue;
+            }
+
+            serverConnection& connection = *static_cast<serverConnection*>(events[i].data.ptr);
+            peerOpen[i] = true;
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                peerOpen[i] = readServerRequests(connection, scratch);
+        }
+
+        // Group commit: one sync covers every change read this round, and no
+        //    answer goes out before the change it confirms is on disk
+        bool synced = journal.waitDurable(scratch.journalSequence);
+
+        for (int i = 0; i < ready; i++)
+        {
+            if (events[i].data.ptr == nullptr)
+                continue;
+
+            serverConnection& connection = *static_cast<serverConnection*>(events[i].data.ptr);
+            bool open = peerOpen[i];
+
+            // Never confirm a change that isn't on disk
+            if (!synced && connection.unsyncedOutput != string::npos)
+            {
+                connection.output.resize(connection.unsyncedOutput);
+                connection.output += "ERR journal write failed\n";
+                connection.closing = true;
+            }
+            connection.unsyncedOutput = string::npos;
+
+            // Answers to a half-closed peer are still sent
+            bool flushed = flushServerOutput(connection);
+            bool pending = connection.outputStart < connection.output.size();
+
+            if (!flushed || (!open && !pending) || (connection.closing && !pending))
+            {
+                if (!connection.userName.empty())
+                    getSessionStore().release(connection.userName);
+
+                epoll_ctl(epollHandle, EPOLL_CTL_DEL, connection.socket, nullptr);
+                close(connection.socket);
+                connections.erase(connection.socket);
+                continue;
+            }
+
+            // Read only while the output backlog is small; wait for EPOLLOUT while it isn't empty
+            uint32_t wanted = (pending ? EPOLLOUT : 0u) |
+                (open && !connection.closing && connection.output.size() < SERVER_MAX_PENDING_OUTPUT ? EPOLLIN : 0u);
+
+            if (wanted != connection.events)
+            {
+                connection.events = wanted;
+                epoll_event clientEvent{};
+                clientEvent.events = wanted;
+                clientEvent.data.ptr = &connection;
+                epoll_ctl(epollHandle, EPOLL_CTL_MOD, connection.socket, &clientEvent);
+            }
+        }
+
+        // Every answered change is synced, so the snapshot matches the journal's length
+        takeServerSnapshot(snapshotPath, journalPath, scratch, false);
+    }
+
+    for (auto& entry : connections)
+        close(entry.first);
+
+    close(epollHandle);
+    close(listener);
+    unlink(socketPath.c_str());
+
+    takeServerSnapshot(snapshotPath, journalPath, scratch, true);
+    journal.close();
+
+    const macroCache& cache = getMacroCache();
+    cout << "\nServer stopped: " << acceptedCount << " connections, " << scratch.requests << " requests, "
+        << getSessionStore().size() << " users\n"
+        << "Macro cache: " << cache.getHits() << " hits, " << cache.getMisses() << " misses, "
+        << cache.getEvictions() << " evictions\n"
+        << "Journal: " << journal.getSyncs() << " syncs to " << journalPath << "\n";
+    printMemoryReport(cout, getSessionStore().getMemoryUsage());
+    return 0;
+#else
+    cerr << "Error: Server mode (" << socketPath << ") needs Linux (epoll)\n";
+    return 1;
+#endif
+}
+
+bool findMacroTargets(const macroCacheKey& key, nutritionTracker& tracker, serverScratch& scratch)
+{
+    macroCache& cache = getMacroCache();
+
+    if (cache.find(key, scratch.cached))
+    {
+        tracker.loadMacroTargets(scratch.cached);
+        return true;
+    }
+
+    profileColumns& columns = scratch.block.columns;
+    columns.dailyCalories[0] = key.dailyCalories;
+    columns.mealsPerDay[0] = key.mealsPerDay;
+    memcpy(&columns.weeklyWorkoutHours[0], &key.workoutHoursBits, sizeof(double));
+    columns.goal[0] = key.goal;
+    calculateMacrosColumns(columns, 0, 1);
+    getAdviceRules().classifyColumns(columns, 0, 1);
+    tracker.loadMacroTargets(columns, 0);
+
+    if (!tracker.fillMacroCacheEntry(scratch.cached, scratch.resultColumns))
+        return false;
+
+    cache.insert(key, scratch.cached);
+    return true;
+}
+
+void handleServerRequest(serverConnection& connection, string_view request, serverScratch& scratch)
+{
+    size_t space = request.find(' ');
+    string_view command = request.substr(0, space);
+    string_view arguments = (space == string_view::npos) ? string_view() : trimBatchField(request.substr(space + 1));
+    string& output = connection.output;
+    sessionStore& users = getSessionStore();
+    char line[128];
+
+    scratch.requests++;
+
+    // Nothing more can be made durable, so changes are refused
+    if ((command == "PROFILE" || command == "APPEND") && getJournal().hasFailed())
+    {
+        output += "ERR journal unavailable\n";
+        return;
+    }
+
+    if (command == "PROFILE")
+    {
+        // Same row format and validation as --batch
+        batchBlock& block = scratch.block;
+        block.count = 0;
+        block.reserveRows(1);
+
+        const char* problem = parseBatchFields(arguments, block);
+        if (problem != nullptr)
+        {
+            output += "ERR ";
+            output += problem;
+            output += '\n';
+            return;
+        }
+
+        profileColumns& columns = block.columns;
+        auto loadRow = [&](nutritionTracker& tracker)
+        {
+            tracker.loadProfile(block.names[0], block.proteins[0], columns.dailyCalories[0],
+                columns.mealsPerDay[0], columns.weeklyWorkoutHours[0], static_cast<GoalType>(columns.goal[0]));
+            tracker.loadDailyCalories(&block.caloriesLog[0]);
+
+            bool cached = findMacroTargets(makeMacroCacheKey(columns.dailyCalories[0], columns.mealsPerDay[0],
+                columns.weeklyWorkoutHours[0], columns.goal[0]), tracker, scratch);
+
+            tracker.fillSessionsFromCalories();
+
+            scratch.journalSequence = max(scratch.journalSequence, tracker.appendToJournal(JOURNAL_PROFILE));
+            for (int day = 0; day < NUMBER_OF_DAYS; day++)
+            {
+                scratch.journalSequence = max(scratch.journalSequence,
+                    tracker.appendToJournal(JOURNAL_LOG_DAY, day, block.caloriesLog[day]));
+            }
+
+            scratch.changes++;
+            if (connection.unsyncedOutput == string::npos)
+                connection.unsyncedOutput = output.size();
+            output += "OK ";
+            if (cached)
+                tracker.appendBatchResult(output, scratch.cached);
+            else
+                tracker.appendBatchResult(output);
+        };
+
+        // Only the connection holding a name may load or replace that user
+        string userName(block.names[0]);
+
+        if (userName != connection.userName)
+        {
+            if (!users.claim(userName))
+            {
+                output += "ERR user in use by another connection\n";
+                return;
+            }
+
+            if (!connection.userName.empty())
+                users.release(connection.userName);
+
+            connection.userName.swap(userName);
+        }
+
+        // Reloads a stored user in place; a new user gets a new tracker
+        if (!users.update(connection.userName, loadRow))
+        {
+            unique_ptr<nutritionTracker> tracker = make_unique<nutritionTracker>();
+            loadRow(*tracker);
+            users.store(connection.userName, move(tracker));
+        }
+
+        connection.hasProfile = true;
+    }
+    else if (command == "MACROS")
+    {
+        string_view fields[4];
+        int fieldCount = 0;
+
+        while (!arguments.empty() && fieldCount < 4)
+        {
+            size_t end = arguments.find(' ');
+            fields[fieldCount++] = arguments.substr(0, end);
+            arguments = (end == string_view::npos) ? string_view() : trimBatchField(arguments.substr(end + 1));
+        }
+
+        profileColumns& columns = scratch.block.columns;
+        scratch.block.reserveRows(1);
+        int goalChoice = 0;
+
+        if (fieldCount != 4 || !arguments.empty() ||
+            !parseBatchInt(fields[0], columns.dailyCalories[0]) || columns.dailyCalories[0] <= 0 ||
+            !parseBatchInt(fields[1], columns.mealsPerDay[0]) || columns.mealsPerDay[0] <= 0 ||
+            !parseBatchDouble(fields[2], columns.weeklyWorkoutHours[0]) || columns.weeklyWorkoutHours[0] < 0.0 ||
+            !parseBatchInt(fields[3], goalChoice) || goalChoice < 1 || goalChoice > 3)
+        {
+            output += "ERR usage: MACROS <calories> <meals> <hours> <goal 1-3>\n";
+            return;
+        }
+
+        // A throwaway profile, so the connection's own profile is untouched
+        nutritionTracker& macrosOnly = scratch.tracker;
+        macrosOnly.loadProfile(string_view(), string_view(), columns.dailyCalories[0], columns.mealsPerDay[0],
+            columns.weeklyWorkoutHours[0], static_cast<GoalType>(goalChoice - 1));
+        findMacroTargets(makeMacroCacheKey(columns.dailyCalories[0], columns.mealsPerDay[0],
+            columns.weeklyWorkoutHours[0], goalChoice - 1), macrosOnly, scratch);
+
+        const macroCacheEntry& targets = scratch.cached;
+        snprintf(line, sizeof(line), "OK %d %d %d %d %d %d\n", targets.dailyProteinGrams,
+            targets.dailyCarbGrams, targets.dailyFatGrams, targets.proteinPerMeal,
+            targets.carbsPerMeal, targets.fatsPerMeal);
+        output += line;
+    }
+    else if (command == "APPEND")
+    {
+        int calories = 0;
+
+        if (!connection.hasProfile)
+            output += "ERR send PROFILE first\n";
+        else if (!parseBatchInt(arguments, calories) || calories < 0)
+            output += "ERR usage: APPEND <calories>\n";
+        else
+        {
+            users.update(connection.userName, [&](nutritionTracker& tracker)
+                {
+                    tracker.appendDailyCalories(calories);
+                    scratch.changes++;
+                    scratch.journalSequence = max(scratch.journalSequence,
+                        tracker.appendToJournal(JOURNAL_APPEND, 0, calories));
+                    const calorieHistory& history = tracker.getHistory();
+
+                    snprintf(line, sizeof(line), "OK %zu %d %d\n", history.size(),
+                        static_cast<int>(history.windowMean(NUMBER_OF_DAYS)), history.windowMax(NUMBER_OF_DAYS));
+                });
+            if (connection.unsyncedOutput == string::npos)
+                connection.unsyncedOutput = output.size();
+            output += line;
+        }
+    }
+    else if (command == "USER")
+    {
+        string userName(arguments);
+        size_t daysLogged = 0;
+        bool newClaim = !userName.empty() && userName != connection.userName;
+
+        if (newClaim && !users.claim(userName))
+        {
+            output += "ERR user in use by another connection\n";
+            return;
+        }
+
+        if (userName.empty() || !users.read(userName, [&](const nutritionTracker& tracker)
+            {
+                daysLogged = tracker.getHistory().size();
+            }))
+        {
+            // Not named since the restart: load them from the snapshot
+            unique_ptr<nutritionTracker> tracker = make_unique<nutritionTracker>();
+
+            if (userName.empty() || scratch.snapshot == nullptr || !scratch.snapshot->load(userName, *tracker))
+            {
+                if (newClaim)
+                    users.release(userName);
+
+                output += "ERR unknown user\n";
+                return;
+            }
+
+            daysLogged = tracker->getHistory().size();
+            users.store(userName, move(tracker));
+        }
+
+        if (newClaim && !connection.userName.empty())
+            users.release(connection.userName);
+
+        connection.userName.swap(userName);
+        connection.hasProfile = true;
+        snprintf(line, sizeof(line), "OK %zu\n", daysLogged);
+        output += line;
+    }
+    else if (command == "REPORT")
+    {
+        if (!connection.hasProfile)
+        {
+            output += "ERR send PROFILE first\n";
+            return;
+        }
+
+        users.read(connection.userName, [&](const nutritionTracker& tracker)
+            {
+                tracker.renderReport(scratch.report);
+            });
+        snprintf(line, sizeof(line), "OK %zu\n", scratch.report.str().size());
+        output += line;
+        output += scratch.report.str();
+    }
+    else if (command == "PING")
+    {
+        output += "OK\n";
+    }
+    else if (command == "QUIT")
+    {
+        output += "OK\n";
+        connection.closing = true;
+    }
+    else
+    {
+        output += "ERR unknown command\n";
+    }
+}
+
+#ifdef __linux__
+// Reads one response into buffer (starting at position) and moves position
+//    past it. REPORT responses are followed by their byte count of text.
+bool readServerResponse(int socketHandle, string& buffer, size_t& position, bool bulk, bool& isError)
+{
+    size_t lineEnd;
+    size_t bulkBytes = 0;
+    bool haveLine = false;
+
+    while (true)
+    {
+        if (!haveLine && (lineEnd = buffer.find('\n', position)) != string::npos)
+        {
+            haveLine = true;
+            isError = buffer.compare(position, 3, "ERR") == 0;
+
+            if (bulk && !isError)
+                bulkBytes = strtoull(buffer.c_str() + position + 3, nullptr, 10);
+        }
+
+        if (haveLine && buffer.size() - (lineEnd + 1) >= bulkBytes)
+        {
+            position = lineEnd + 1 + bulkBytes;
+            return true;
+        }
+
+        // Need more bytes; drop what has been consumed first
+        if (position > 0)
+        {
+            buffer.erase(0, position);
+            if (haveLine)
+                lineEnd -= position;
+            position = 0;
+        }
+
+        char chunk[SERVER_READ_BYTES];
+        ssize_t received = recv(socketHandle, chunk, sizeof(chunk), 0);
+
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+
+        buffer.append(chunk, received);
+    }
+}
+#endif
+
+int runLoadClient(const loadClientOptions& options)
+{
+#ifdef __linux__
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (options.socketPath.empty() || options.socketPath.size() >= sizeof(address.sun_path))
+    {
+        cerr << "Error: Socket path must be 1 to " << sizeof(address.sun_path) - 1 << " characters\n";
+        return 1;
+    }
+
+    memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size() + 1);
+
+    vector<vector<long long>> latencies(options.connections);   // Nanoseconds, per connection
+    atomic<long long> failures{ 0 };
+    atomic<long long> errorResponses{ 0 };
+
+    // Request mix per 10: 6 MACROS, 3 APPEND, 1 REPORT
+    auto client = [&](int connectionIndex)
+        {
+            long long count = options.requests * (connectionIndex + 1) / options.connections -
+                options.requests * connectionIndex / options.connections;
+            vector<long long>& times = latencies[connectionIndex];
+            times.reserve(count);
+
+            int socketHandle = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+            if (socketHandle < 0 || connect(socketHandle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+            {
+                failures.fetch_add(1);
+                if (socketHandle >= 0)
+                    close(socketHandle);
+                return;
+            }
+
+            string requests = "PROFILE Lifter" + to_string(connectionIndex) +
+                ",tofu,2400,4,6,3,2300,2500,2400,2600,2200,2450,2350\n";
+            string buffer;
+            size_t position = 0;
+            vector<char> bulk;
+            bool isError = false;
+
+            if (send(socketHandle, requests.data(), requests.size(), MSG_NOSIGNAL) < 0 ||
+                !readServerResponse(socketHandle, buffer, position, false, isError))
+            {
+                failures.fetch_add(1);
+                close(socketHandle);
+                return;
+            }
+
+            for (long long sent = 0; sent < count; )
+            {
+                long long batchSize = min<long long>(options.pipeline, count - sent);
+                requests.clear();
+                bulk.clear();
+
+                for (long long i = 0; i < batchSize; i++)
+                {
+                    long long kind = (sent + i) % 10;
+                    char request[64];
+
+                    if (kind == 9)
+                        snprintf(request, sizeof(request), "REPORT\n");
+                    else if (kind % 3 == 1)
+                        snprintf(request, sizeof(request), "APPEND %lld\n", 1800 + (sent + i) % 1200);
+                    else
+                        snprintf(request, sizeof(request), "MACROS %lld %lld %lld.5 %lld\n",
+                            1500 + (sent + i) % 2000, 2 + (sent + i) % 5, (sent + i) % 8, 1 + (sent + i) % 3);
+
+                    requests += request;
+                    bulk.push_back(kind == 9);
+                }
+
+                auto batchStart = chrono::steady_clock::now();
+                size_t written = 0;
+
+                while (written < requests.size())
+                {
+                    ssize_t result = send(socketHandle, requests.data() + written, requests.size() - written, MSG_NOSIGNAL);
+                    if (result < 0 && errno == EINTR)
+                        continue;
+                    if (result <= 0)
+                        break;
+                    written += result;
+                }
+
+                // Latency of each request runs from its batch being sent to its own response arriving
+                for (long long i = 0; i < batchSize; i++)
+                {
+                    if (written < requests.size() || !readServerResponse(socketHandle, buffer, position, bulk[i], isError))
+                    {
+                        failures.fetch_add(1);
+                        close(socketHandle);
+                        return;
+                    }
+
+                    if (isError)
+                        errorResponses.fetch_add(1);
+
+                    times.push_back(chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - batchStart).count());
+                }
+
+                sent += batchSize;
+            }
+
+            send(socketHandle, "QUIT\n", 5, MSG_NOSIGNAL);
+            close(socketHandle);
+        };
+
+    auto startTime = chrono::steady_clock::now();
+    vector<thread> clients;
+
+    for (int i = 0; i < options.connections; i++)
+        clients.emplace_back(client, i);
+
+    for (thread& clientThread : clients)
+        clientThread.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    vector<long long> allLatencies;
+    for (const vector<long long>& times : latencies)
+        allLatencies.insert(allLatencies.end(), times.begin(), times.end());
+
+    if (allLatencies.empty())
+    {
+        cerr << "Error: No responses from " << options.socketPath << " (is --serve running?)\n";
+        return 1;
+    }
+
+    sort(allLatencies.begin(), allLatencies.end());
+    auto percentile = [&](double fraction)
+        {
+            size_t index = static_cast<size_t>(fraction * (allLatencies.size() - 1));
+            return allLatencies[index] / 1e3;
+        };
+
+    cout << "Connections: " << options.connections << ", pipeline depth: " << options.pipeline << "\n"
+        << left << setw(50) << setfill('.') << "Requests answered: " << right << allLatencies.size() << "\n"
+        << left << setw(50) << "Error responses: " << right << errorResponses.load() << "\n"
+        << left << setw(50) << "Failed connections: " << right << failures.load() << "\n"
+        << fixed << setprecision(1)
+        << left << setw(50) << "Requests per second: " << right << allLatencies.size() / seconds << "\n"
+        << left << setw(50) << "p50 latency (us): " << right << percentile(0.50) << "\n"
+        << left << setw(50) << "p99 latency (us): " << right << percentile(0.99) << "\n"
+        << left << setw(50) << "p99.9 latency (us): " << right << percentile(0.999) << "\n"
+        << left << setw(50) << "Max latency (us): " << right << allLatencies.back() / 1e3 << "\n"
+        << setfill(' ');
+
+    return failures.load() == 0 ? 0 : 1;
+#else
+    cerr << "Error: The load generator (" << options.socketPath << ") needs Linux\n";
+    return 1;
+#endif
+}
+
+
+// --------------------- Macro Cache ---------------------
+size_t macroCacheKeyHash::operator()(const macroCacheKey& key) const
+{
+    // 64-bit multiply-xorshift mix of all four fields
+    uint64_t hash = key.workoutHoursBits;
+    hash ^= (static_cast<uint64_t>(static_cast<uint32_t>(key.dailyCalories)) << 32) |
+        (static_cast<uint64_t>(static_cast<uint32_t>(key.mealsPerDay)) << 2) | static_cast<uint64_t>(key.goal & 3);
+    hash *= 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+    return static_cast<size_t>(hash);
+}
+
+macroCacheKey makeMacroCacheKey(int dailyCalories, int mealsPerDay, double workoutHours, int goal)
+{
+    macroCacheKey key;
+    key.dailyCalories = dailyCalories;
+    key.mealsPerDay = mealsPerDay;
+    memcpy(&key.workoutHoursBits, &workoutHours, sizeof(double));
+    key.goal = goal;
+    return key;
+}
+
+macroCache::macroCache(size_t capacity)
+    : slotLimit(max<size_t>(1, capacity / MACRO_CACHE_SHARDS)),
+    shards(new cacheShard[MACRO_CACHE_SHARDS])
+{
+    for (int i = 0; i < MACRO_CACHE_SHARDS; i++)
+        shards[i].referenced.reset(new atomic<bool>[slotLimit]());
+}
+
+macroCache::cacheShard& macroCache::getShard(const macroCacheKey& key)
+{
+    // High bits pick the shard; unordered_map uses the low bits
+    return shards[(macroCacheKeyHash()(key) >> 56) % MACRO_CACHE_SHARDS];
+}
+
+bool macroCache::find(const macroCacheKey& key, macroCacheEntry& entry)
+{
+    cacheShard& shard = getShard(key);
+    shared_lock<shared_mutex> guard(shard.lock);
+    auto found = shard.index.find(key);
+
+    if (found == shard.index.end())
+    {
+        shard.misses.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    uint32_t slot = found->second;
+
+    // Only store when the bit is clear, so hot entries don't bounce the cache line
+    if (!shard.referenced[slot].load(memory_order_relaxed))
+        shard.referenced[slot].store(true, memory_order_relaxed);
+
+    shard.hits.fetch_add(1, memory_order_relaxed);
+
+    entry = shard.slots[slot].entry;
+    return true;
+}
+
+void macroCache::insert(const macroCacheKey& key, const macroCacheEntry& entry)
+{
+    cacheShard& shard = getShard(key);
+    unique_lock<shared_mutex> guard(shard.lock);
+    auto found = shard.index.find(key);
+    uint32_t slot;
+
+    if (found != shard.index.end())
+    {
+        // Another thread cached it first; refresh it
+        slot = found->second;
+    }
+    else if (shard.slots.size() < slotLimit)
+    {
+        slot = static_cast<uint32_t>(shard.slots.size());
+        shard.slots.emplace_back();
+        shard.index.emplace(key, slot);
+    }
+    else
+    {
+        // Give every referenced slot a second chance; at most two sweeps
+        uint32_t slotCount = static_cast<uint32_t>(shard.slots.size());
+
+        while (shard.referenced[shard.hand].exchange(false, memory_order_relaxed))
+            shard.hand = (shard.hand + 1) % slotCount;
+
+        slot = shard.hand;
+        shard.hand = (shard.hand + 1) % slotCount;
+
+        // Re-key the evicted index node so a full cache doesn't allocate
+        auto node = shard.index.extract(shard.slots[slot].key);
+        node.key() = key;
+        shard.index.insert(move(node));
+        shard.evictions++;
+    }
+
+    shard.slots[slot].key = key;
+    shard.slots[slot].entry = entry;
+
+    // New entries start unreferenced: the hand has just passed them, and a
+    //    one-off profile shouldn't outlive one that keeps being hit
+    shard.referenced[slot].store(false, memory_order_relaxed);
+}
+
+long long macroCache::getHits() const
+{
+    long long total = 0;
+    for (int i = 0; i < MACRO_CACHE_SHARDS; i++)
+        total += shards[i].hits.load(memory_order_relaxed);
+    return total;
+}
+
+long long macroCache::getMisses() const
+{
+    long long total = 0;
+    for (int i = 0; i < MACRO_CACHE_SHARDS; i++)
+        total += shards[i].misses.load(memory_order_relaxed);
+    return total;
+}
+
+long long macroCache::getEvictions() const
+{
+    long long total = 0;
+    for (int i = 0; i < MACRO_CACHE_SHARDS; i++)
+    {
+        shared_lock<shared_mutex> guard(shards[i].lock);
+        total += shards[i].evictions;
+    }
+    return total;
+}
+
+macroCache& getMacroCache()
+{
+    static macroCache cache;
+    return cache;
+}
+
+
+// --------------------- Session Store ---------------------
+sessionStore::sessionStore()
+    : shards(new storeShard[SESSION_STORE_SHARDS])
+{
+}
+
+sessionStore::storeShard& sessionStore::getShard(const string& userName) const
+{
+    // Top bits of a multiplicative mix; unordered_map uses the low bits
+    uint64_t hash = static_cast<uint64_t>(std::hash<string>()(userName)) * 0x9E3779B97F4A7C15ULL;
+    return shards[hash >> (64 - SESSION_STORE_SHARD_BITS)];
+}
+
+void sessionStore::store(const string& userName, unique_ptr<nutritionTracker> tracker)
+{
+    storeShard& shard = getShard(userName);
+    unique_ptr<nutritionTracker> replaced;
+
+    // Still only ours, so no lock is needed yet
+    if (tracker)
+        tracker->refreshDerivedState();
+
+    {
+        unique_lock<shared_mutex> guard(shard.lock);
+        unique_ptr<nutritionTracker>& slot = shard.users[userName];
+        replaced = move(slot);
+        slot = move(tracker);
+    }
+
+    // The replaced tracker is freed here, outside the lock
+}
+
+bool sessionStore::read(const string& userName, const function<void(const nutritionTracker&)>& view) const
+{
+    storeShard& shard = getShard(userName);
+    shared_lock<shared_mutex> guard(shard.lock);
+    auto found = shard.users.find(userName);
+
+    if (found == shard.users.end())
+        return false;
+
+    view(*found->second);
+    return true;
+}
+
+bool sessionStore::update(const string& userName, const function<void(nutritionTracker&)>& edit)
+{
+    storeShard& shard = getShard(userName);
+    unique_lock<shared_mutex> guard(shard.lock);
+    auto found = shard.users.find(userName);
+
+    if (found == shard.users.end())
+        return false;
+
+    edit(*found->second);
+    found->second->refreshDerivedState();
+    return true;
+}
+
+size_t sessionStore::size() const
+{
+    size_t total = 0;
+
+    for (int i = 0; i < SESSION_STORE_SHARDS; i++)
+    {
+        shared_lock<shared_mutex> guard(shards[i].lock);
+        total += shards[i].users.size();
+    }
+
+    return total;
+}
+
+void sessionStore::forEach(const function<void(const string&, const nutritionTracker&)>& view) const
+{
+    for (int i = 0; i < SESSION_STORE_SHARDS; i++)
+    {
+        shared_lock<shared_mutex> guard(shards[i].lock);
+
+        for (const auto& user : shards[i].users)
+            view(user.first, *user.second);
+    }
+}
+
+trackerMemory sessionStore::getMemoryUsage() const
+{
+    trackerMemory memory;
+    size_t storeBytes = 0;
+
+    for (int i = 0; i < SESSION_STORE_SHARDS; i++)
+    {
+        shared_lock<shared_mutex> guard(shards[i].lock);
+        const auto& users = shards[i].users;
+
+        // Hash node (key, pointer, next, cached hash) plus one bucket pointer per user
+        storeBytes += users.bucket_count() * sizeof(void*) +
+            users.size() * (sizeof(string) + 3 * sizeof(void*) + sizeof(size_t));
+
+        for (const auto& user : users)
+        {
+            user.second->addMemoryUsage(memory);
+
+            if (user.first.capacity() > string().capacity())
+                storeBytes += user.first.capacity() + 1;
+        }
+    }
+
+    // Counted with the object, as part of what each user costs
+    memory.objectBytes += storeBytes;
+    return memory;
+}
+
+bool sessionStore::claim(const string& userName)
+{
+    storeShard& shard = getShard(userName);
+    unique_lock<shared_mutex> guard(shard.lock);
+    return shard.claimed.insert(userName).second;
+}
+
+void sessionStore::release(const string& userName)
+{
+    storeShard& shard = getShard(userName);
+    unique_lock<shared_mutex> guard(shard.lock);
+    shard.claimed.erase(userName);
+}
+
+sessionStore& getSessionStore()
+{
+    static sessionStore users;
+    return users;
+}
+
+sessionNameClaims::~sessionNameClaims()
+{
+    for (const string& userName : names)
+        users.release(userName);
+}
+
+bool sessionNameClaims::claim(const string& userName)
+{
+    if (!users.claim(userName))
+        return false;
+
+    names.push_back(userName);
+    return true;
+}
+
+
+// --------------------- String Pool ---------------------
+stringPool::stringPool(size_t maxStrings, size_t maxLength)
+    : stringLimit(maxStrings), lengthLimit(maxLength)
+{
+}
+
+bool stringPool::tryIntern(string_view text, string_view& interned)
+{
+    {
+        shared_lock<shared_mutex> guard(lock);
+        auto found = index.find(text);
+
+        if (found != index.end())
+        {
+            interned = *found;
+            return true;
+        }
+    }
+
+    unique_lock<shared_mutex> guard(lock);
+    auto found = index.find(text);   // Another thread may have added it meanwhile
+
+    if (found != index.end())
+    {
+        interned = *found;
+        return true;
+    }
+
+    if (text.size() > lengthLimit || strings.size() >= stringLimit)
+    {
+        refused.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    strings.emplace_back(text);
+    interned = strings.back();
+    index.insert(interned);
+    return true;
+}
+
+size_t stringPool::size() const
+{
+    shared_lock<shared_mutex> guard(lock);
+    return strings.size();
+}
+
+size_t stringPool::getBytes() const
+{
+    shared_lock<shared_mutex> guard(lock);
+    size_t bytes = strings.size() * (sizeof(string) + sizeof(string_view) + 2 * sizeof(void*)) +
+        index.bucket_count() * sizeof(void*);
+
+    for (const string& text : strings)
+    {
+        if (text.capacity() > string().capacity())
+            bytes += text.capacity() + 1;
+    }
+
+    return bytes;
+}
+
+stringPool& getProteinPool()
+{
+    static stringPool proteins(PROTEIN_POOL_MAX_STRINGS, PROTEIN_POOL_MAX_LENGTH);
+    return proteins;
+}
+
+
+// --------------------- Session Coroutines ---------------------
+sessionTask sessionTask::promise_type::get_return_object()
+{
+    return sessionTask(coroutine_handle<promise_type>::from_promise(*this));
+}
+
+void* sessionTask::promise_type::operator new(size_t size)
+{
+    sessionFrameBytes.fetch_add(static_cast<long long>(size), memory_order_relaxed);
+    return ::operator new(size);
+}
+
+void sessionTask::promise_type::operator delete(void* frame, size_t size)
+{
+    sessionFrameBytes.fetch_sub(static_cast<long long>(size), memory_order_relaxed);
+    ::operator delete(frame);
+}
+
+// Finished: go straight back to the awaiting coroutine, without growing the stack
+coroutine_handle<> sessionTask::finalAwaiter::await_suspend(coroutine_handle<promise_type> finished) noexcept
+{
+    coroutine_handle<> continuation = finished.promise().continuation;
+    return continuation ? continuation : noop_coroutine();
+}
+
+sessionTask::sessionTask(sessionTask&& other) noexcept
+    : handle(exchange(other.handle, nullptr))
+{
+}
+
+sessionTask& sessionTask::operator=(sessionTask&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (handle)
+            handle.destroy();
+        handle = exchange(other.handle, nullptr);
+    }
+
+    return *this;
+}
+
+sessionTask::~sessionTask()
+{
+    if (handle)
+        handle.destroy();
+}
+
+coroutine_handle<> sessionTask::await_suspend(coroutine_handle<> awaiting) noexcept
+{
+    handle.promise().continuation = awaiting;
+    return handle;
+}
+
+void sessionTask::start()
+{
+    if (handle && !handle.done())
+        handle.resume();
+}
+
+bool sessionTask::done() const
+{
+    return !handle || handle.done();
+}
+
+void sessionTask::checkFailure() const
+{
+    if (handle && handle.promise().failure)
+        rethrow_exception(handle.promise().failure);
+}
+
+sessionInput::sessionInput(string_view script)
+    : buffer(script), finished(true)
+{
+}
+
+void sessionInput::feed(string_view typed)
+{
+    // Drop what has been read once it is most of the buffer
+    if (position > 0 && position >= buffer.size() / 2)
+    {
+        buffer.erase(0, position);
+        position = 0;
+    }
+
+    buffer.append(typed.data(), typed.size());
+}
+
+void sessionInput::finish()
+{
+    finished = true;
+}
+
+void sessionInput::resume()
+{
+    if (!waiting || !canRead(waitingKind))
+        return;
+
+    coroutine_handle<> session = exchange(waiting, nullptr);
+    session.resume();
+}
+
+bool sessionInput::canRead(InputReadKind kind) const
+{
+    if (finished || (failed && kind != INPUT_SKIP_LINE))
+        return true;
+
+    size_t start = position;
+
+    // cin skips blank lines while it waits for a number
+    if (kind == INPUT_INT || kind == INPUT_DOUBLE)
+    {
+        while (start < buffer.size() && isspace(static_cast<unsigned char>(buffer[start])))
+            start++;
+
+        if (start == buffer.size())
+            return false;
+    }
+
+    // Terminals send whole lines, so a read waits for the end of its line
+    return buffer.find('\n', start) != string::npos;
+}
+
+void sessionInput::skipSpaces()
+{
+    while (position < buffer.size() && isspace(static_cast<unsigned char>(buffer[position])))
+        position++;
+}
+
+bool sessionInput::parseLine(string& line)
+{
+    line.clear();
+
+    if (failed || position >= buffer.size())
+    {
+        failed = true;
+        return false;
+    }
+
+    size_t end = buffer.find('\n', position);
+
+    if (end == string::npos)
+        end = buffer.size();
+
+    line.assign(buffer, position, end - position);
+    position = min(end + 1, buffer.size());
+    return true;
+}
+
+bool sessionInput::parseInt(int& value)
+{
+    value = 0;
+
+    if (failed)
+        return false;
+
+    skipSpaces();
+
+    // from_chars takes a leading '-' but not '+'
+    const char* first = buffer.data() + position;
+    const char* last = buffer.data() + buffer.size();
+
+    if (first != last && *first == '+' && last - first > 1 && isdigit(static_cast<unsigned char>(first[1])))
+        first++;
+
+    from_chars_result result = from_chars(first, last, value);
+
+    if (result.ec == errc::invalid_argument)
+    {
+        failed = true;
+        return false;
+    }
+
+    position = static_cast<size_t>(result.ptr - buffer.data());
+
+    // Too many digits: cin fails too, after reading them all
+    if (result.ec == errc::result_out_of_range)
+    {
+        value = (*first == '-') ? INT_MIN : INT_MAX;
+        failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool sessionInput::parseDouble(double& value)
+{
+    value = 0.0;
+
+    if (failed)
+        return false;
+
+    skipSpaces();
+
+    const char* first = buffer.data() + position;
+    const char* last = buffer.data() + buffer.size();
+    const char* digits = first;
+
+    if (digits != last && (*digits == '+' || *digits == '-'))
+        digits++;
+
+    // cin reads digits and a decimal point only, never "inf" or "nan"
+    if (digits == last || !(isdigit(static_cast<unsigned char>(*digits)) || *digits == '.'))
+    {
+        failed = true;
+        return false;
+    }
+
+    if (*first == '+')
+        first++;
+
+    from_chars_result result = from_chars(first, last, value);
+
+    if (result.ec == errc::invalid_argument)
+    {
+        failed = true;
+        return false;
+    }
+
+    position = static_cast<size_t>(result.ptr - buffer.data());
+
+    if (result.ec == errc::result_out_of_range)
+    {
+        failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+void sessionInput::discardLine()
+{
+    failed = false;
+    size_t end = buffer.find('\n', position);
+    position = (end == string::npos) ? buffer.size() : end + 1;
+}
+
+bool inputRead::await_ready() const
+{
+    return input.canRead(kind);
+}
+
+void inputRead::await_suspend(coroutine_handle<> session)
+{
+    input.waiting = session;
+    input.waitingKind = kind;
+}
+
+bool inputRead::await_resume()
+{
+    switch (kind)
+    {
+    case INPUT_LINE:
+        return input.parseLine(*static_cast<string*>(target));
+    case INPUT_INT:
+        return input.parseInt(*static_cast<int*>(target));
+    case INPUT_DOUBLE:
+        return input.parseDouble(*static_cast<double*>(target));
+    default:
+        input.discardLine();
+        return true;
+    }
+}
+
+
+// --------------------- Replay Mode ---------------------
+int runReplayMode(const replayOptions& options)
+{
+    vector<replaySession> sessions;
+
+    if (!loadReplayTranscript(options.transcriptPath, sessions))
+        return 1;
+
+    if (sessions.empty())
+    {
+        cerr << "No @input sessions in " << options.transcriptPath << "\n";
+        return 1;
+    }
+
+    isConsoleCaptured();   // Remember the real console before redirecting cout
+    streambuf* console = cout.rdbuf();
+    ostringstream capture;
+    long long replayed = 0;
+    int mismatches = 0;
+    vector<bool> reported(sessions.size(), false);   // Each session's first difference is shown once
+    auto startTime = chrono::steady_clock::now();
+
+    for (int pass = 0; pass < options.repeat; pass++)
+    {
+        for (size_t i = 0; i < sessions.size(); i++)
+        {
+            replaySession& session = sessions[i];
+            sessionInput input(session.input);
+            sessionStore users;   // Every replay starts with no active users
+
+            capture.str("");
+            cout.rdbuf(capture.rdbuf());
+            sessionTask replay = runInteractiveSession(input, users, false);
+            runSessionToEnd(replay, input);
+            cout.rdbuf(console);
+            replayed++;
+
+            string actual = capture.str();
+
+            if (options.record && pass == 0)
+            {
+                session.expectedOutput = actual;
+                continue;
+            }
+
+            string expectedLine;
+            string actualLine;
+            int line = findReplayDifference(session.expectedOutput, actual, expectedLine, actualLine);
+
+            if (line == 0)
+                continue;
+
+            mismatches++;
+
+            if (!reported[i])
+            {
+                reported[i] = true;
+                cout << "Session at line " << session.lineNumber << " differs at output line " << line << ":\n"
+                    << "  expected: " << expectedLine << "\n"
+                    << "  actual:   " << actualLine << "\n";
+            }
+        }
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    cout << "Replayed " << replayed << " session" << (replayed == 1 ? "" : "s") << " ("
+        << sessions.size() << " x " << options.repeat << ") in " << fixed << setprecision(1)
+        << seconds * 1000.0 << " ms: " << setprecision(0) << (replayed / max(seconds, 1e-9))
+        << " sessions/s\n";
+
+    if (options.record)
+    {
+        if (!saveReplayTranscript(options.transcriptPath, sessions))
+            return 1;
+
+        cout << "Recorded " << sessions.size() << " session output" << (sessions.size() == 1 ? "" : "s")
+            << " into " << options.transcriptPath << "\n";
+    }
+
+    if (mismatches > 0)
+    {
+        cout << mismatches << " replay" << (mismatches == 1 ? "" : "s") << " did not match.\n";
+        return 1;
+    }
+
+    cout << "All replays matched.\n";
+    return 0;
+}
+
+bool loadReplayTranscript(const string& path, vector<replaySession>& sessions)
+{
+    ifstream inFile(path, ios::binary);
+
+    if (!inFile)
+    {
+        cerr << "Could not open transcript " << path << "\n";
+        return false;
+    }
+
+    enum { BETWEEN, INPUT, OUTPUT } section = BETWEEN;
+    string comments;
+    string line;
+    int lineNumber = 0;
+
+    while (getline(inFile, line))
+    {
+        lineNumber++;
+        string_view marker = line;
+
+        if (!marker.empty() && marker.back() == '\r')
+            marker.remove_suffix(1);
+
+        if (marker == "@input" && section == BETWEEN)
+        {
+            sessions.emplace_back();
+            sessions.back().comments.swap(comments);
+            sessions.back().lineNumber = lineNumber;
+            section = INPUT;
+        }
+        else if (marker == "@output" && section == INPUT)
+            section = OUTPUT;
+        else if (marker == "@end" && section != BETWEEN)
+            section = BETWEEN;
+        else if (section == INPUT)
+            sessions.back().input.append(line).push_back('\n');
+        else if (section == OUTPUT)
+            sessions.back().expectedOutput.append(line).push_back('\n');
+        else if (marker.empty() || marker[0] == '#')
+            comments.append(line).push_back('\n');
+        else
+        {
+            cerr << path << ":" << lineNumber << ": expected @input, a comment or a blank line\n";
+            return false;
+        }
+    }
+
+    if (section != BETWEEN)
+    {
+        cerr << path << ": the last session has no @end\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool saveReplayTranscript(const string& path, const vector<replaySession>& sessions)
+{
+    string text;
+
+    for (const replaySession& session : sessions)
+    {
+        text.append(session.comments).append("@input\n").append(session.input);
+        text.append("@output\n").append(session.expectedOutput);
+
+        if (!session.expectedOutput.empty() && session.expectedOutput.back() != '\n')
+            text.push_back('\n');
+
+        text.append("@end\n");
+    }
+
+    if (!writeReportFile(path, text))
+    {
+        cerr << "Could not write transcript " << path << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+int findReplayDifference(string_view expected, string_view actual, string& expectedLine, string& actualLine)
+{
+    int line = 1;
+
+    while (!expected.empty() || !actual.empty())
+    {
+        size_t expectedEnd = min(expected.find('\n'), expected.size());
+        size_t actualEnd = min(actual.find('\n'), actual.size());
+        string_view expectedText = expected.substr(0, expectedEnd);
+        string_view actualText = actual.substr(0, actualEnd);
+
+        bool bothTimed = expectedText.substr(0, strlen(REPLAY_TIMING_PREFIX)) == REPLAY_TIMING_PREFIX &&
+            actualText.substr(0, strlen(REPLAY_TIMING_PREFIX)) == REPLAY_TIMING_PREFIX;
+
+        if (expected.empty() || actual.empty() || (expectedText != actualText && !bothTimed))
+        {
+            expectedLine = expected.empty() ? "(end of output)" : string(expectedText);
+            actualLine = actual.empty() ? "(end of output)" : string(actualText);
+            return line;
+        }
+
+        expected.remove_prefix(min(expectedEnd + 1, expected.size()));
+        actual.remove_prefix(min(actualEnd + 1, actual.size()));
+        line++;
+    }
+
+    return 0;
+}
+
+
+// --------------------- Journal ---------------------
+bool calorieJournal::open(const string& journalPath)
+{
+    close();
+    file = fopen(journalPath.c_str(), "ab");
+
+    if (file == nullptr)
+        return false;
+
+    path = journalPath;
+    durableOffset = getJournalEndOffset(path);
+    baseOffset = 0;
+
+    // A compacted journal's first record is past offset 0
+    if (FILE* existing = fopen(path.c_str(), "rb"))
+    {
+        char header[JOURNAL_BASE_HEADER_BYTES];
+        if (fread(header, 1, sizeof(header), existing) == sizeof(header) && memcmp(header, JOURNAL_MAGIC, 8) == 0)
+            baseOffset = readLittleEndian(header + 8, 8);
+        fclose(existing);
+    }
+
+    queuedSequence = 0;
+    durableSequence = 0;
+    closing = false;
+    failed = false;
+    committer = thread(&calorieJournal::commitLoop, this);
+    return true;
+}
+
+void calorieJournal::close()
+{
+    if (file == nullptr)
+        return;
+
+    {
+        lock_guard<mutex> guard(lock);
+        closing = true;
+    }
+
+    wake.notify_one();
+    committer.join();
+    fclose(file);
+    file = nullptr;
+}
+
+uint64_t calorieJournal::append(const journalEntry& entry)
+{
+    if (file == nullptr)
+        return 0;
+
+    lock_guard<mutex> guard(lock);
+    appendJournalRecord(queued, entry);
+    COUNT_EVENT(COUNTER_JOURNAL_RECORDS, 1);
+    wake.notify_one();
+    return ++queuedSequence;
+}
+
+bool calorieJournal::waitDurable(uint64_t sequence)
+{
+    if (sequence == 0)
+        return true;
+
+    unique_lock<mutex> guard(lock);
+    synced.wait(guard, [&] { return durableSequence >= sequence || failed; });
+    return durableSequence >= sequence;
+}
+
+bool calorieJournal::hasFailed() const
+{
+    lock_guard<mutex> guard(lock);
+    return failed;
+}
+
+bool calorieJournal::compact(uint64_t offset)
+{
+    lock_guard<mutex> guard(lock);
+
+    // The commit thread is idle while everything queued is synced
+    if (file == nullptr || failed || !queued.empty() || durableSequence != queuedSequence ||
+        offset < baseOffset || offset > durableOffset)
+        return false;
+
+    if (offset == baseOffset)
+        return true;
+
+    // The records after offset go behind a new header; a crash before the
+    //    rename leaves the whole journal, which the snapshot's offset still fits
+    uint64_t headerBytes = (baseOffset > 0) ? JOURNAL_BASE_HEADER_BYTES : 0;
+    string temporaryPath = path + ".tmp";
+    FILE* inFile = fopen(path.c_str(), "rb");
+    FILE* outFile = fopen(temporaryPath.c_str(), "wb");
+    char header[JOURNAL_BASE_HEADER_BYTES];
+    memcpy(header, JOURNAL_MAGIC, 8);
+    writeLittleEndian(header + 8, offset, 8);
+
+    bool written = inFile != nullptr && outFile != nullptr &&
+        seekFileOffset(inFile, headerBytes + (offset - baseOffset)) &&
+        fwrite(header, 1, sizeof(header), outFile) == sizeof(header);
+
+    char buffer[1 << 16];
+    size_t count = 0;
+
+    while (written && (count = fread(buffer, 1, sizeof(buffer), inFile)) > 0)
+        written = fwrite(buffer, 1, count, outFile) == count;
+
+    written = written && !ferror(inFile) && fflush(outFile) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(outFile)) == 0;
+#else
+    written = written && fsync(fileno(outFile)) == 0;
+#endif
+
+    if (inFile != nullptr)
+        fclose(inFile);
+
+    error_code renameError;
+    if (written)
+        filesystem::rename(temporaryPath, path, renameError);
+
+    if (!written || renameError)
+    {
+        if (outFile != nullptr)
+            fclose(outFile);
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    // The open handle follows the renamed file, so appends continue in it
+    fclose(file);
+    file = outFile;
+    baseOffset = offset;
+    return true;
+}
+
+long long calorieJournal::getSyncs() const
+{
+    lock_guard<mutex> guard(lock);
+    return syncs;
+}
+
+void calorieJournal::commitLoop()
+{
+    unique_lock<mutex> guard(lock);
+
+    while (true)
+    {
+        wake.wait(guard, [&] { return !queued.empty() || closing; });
+
+        if (queued.empty())
+            break;
+
+        // Everything appended while the last sync ran goes out in this one
+        writing.swap(queued);
+        uint64_t sequence = queuedSequence;
+        guard.unlock();
+
+        bool written = fwrite(writing.data(), 1, writing.size(), file) == writing.size() && fflush(file) == 0;
+#ifdef _WIN32
+        written = written && _commit(_fileno(file)) == 0;
+#elif defined(__linux__)
+        written = written && fdatasync(fileno(file)) == 0;
+#else
+        written = written && fsync(fileno(file)) == 0;
+#endif
+        uint64_t writtenBytes = writing.size();
+        writing.clear();
+        guard.lock();
+
+        if (written)
+        {
+            durableSequence = sequence;
+            durableOffset += writtenBytes;
+            syncs++;
+            COUNT_EVENT(COUNTER_JOURNAL_SYNCS, 1);
+        }
+        else if (!failed)
+        {
+            failed = true;
+            cerr << "Warning: Unable to write the journal; new entries will not survive a crash\n";
+        }
+
+        synced.notify_all();
+    }
+}
+
+calorieJournal& getJournal()
+{
+    static calorieJournal journal;
+    return journal;
+}
+
+uint64_t getJournalEndOffset(const string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (file == nullptr)
+        return 0;
+
+    char header[JOURNAL_BASE_HEADER_BYTES];
+    bool compacted = fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, JOURNAL_MAGIC, 8) == 0;
+    fclose(file);
+
+    error_code sizeError;
+    uint64_t fileBytes = filesystem::file_size(path, sizeError);
+
+    if (sizeError)
+        return 0;
+
+    return compacted ? readLittleEndian(header + 8, 8) + (fileBytes - JOURNAL_BASE_HEADER_BYTES) : fileBytes;
+}
+
+// Standard CRC-32 (reflected polynomial 0xEDB88320)
+uint32_t calculateCrc32(const char* data, size_t length, uint32_t previous)
+{
+    static const auto table = []
+        {
+            array<uint32_t, 256> values{};
+
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+                values[i] = crc;
+            }
+
+            return values;
+        }();
+
+    uint32_t crc = previous ^ 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void appendJournalRecord(string& out, const journalEntry& entry)
+{
+    // Text past 65535 bytes can't be recorded; no prompt or request accepts that much
+    size_t nameLength = min<size_t>(entry.userName.size(), 0xFFFF);
+    size_t proteinLength = min<size_t>(entry.protein.size(), 0xFFFF);
+    size_t payloadLength = JOURNAL_FIXED_BYTES + nameLength + proteinLength;
+    size_t start = out.size();
+    uint64_t hoursBits;
+
+    memcpy(&hoursBits, &entry.weeklyWorkoutHours, sizeof(hoursBits));
+    out.resize(start + JOURNAL_HEADER_BYTES + JOURNAL_FIXED_BYTES);
+
+    char* fixed = &out[start + JOURNAL_HEADER_BYTES];
+    fixed[0] = static_cast<char>(entry.type);
+    fixed[1] = static_cast<char>(entry.day);
+    fixed[2] = static_cast<char>(entry.goal);
+    writeLittleEndian(fixed + 3, static_cast<uint32_t>(entry.calories), 4);
+    writeLittleEndian(fixed + 7, static_cast<uint32_t>(entry.mealsPerDay), 4);
+    writeLittleEndian(fixed + 11, hoursBits, 8);
+    writeLittleEndian(fixed + 19, nameLength, 2);
+    writeLittleEndian(fixed + 21, proteinLength, 2);
+
+    out.append(entry.userName.data(), nameLength);
+    out.append(entry.protein.data(), proteinLength);
+
+    const char* payload = out.data() + start + JOURNAL_HEADER_BYTES;
+    writeLittleEndian(&out[start], payloadLength, 4);
+    writeLittleEndian(&out[start + 4], calculateCrc32(payload, payloadLength), 4);
+}
+
+bool decodeJournalRecord(const char* data, size_t available, journalEntry& entry, size_t& recordBytes)
+{
+    if (available < JOURNAL_HEADER_BYTES + JOURNAL_FIXED_BYTES)
+        return false;
+
+    uint64_t payloadLength = readLittleEndian(data, 4);
+
+    if (payloadLength < JOURNAL_FIXED_BYTES || payloadLength > available - JOURNAL_HEADER_BYTES)
+        return false;
+
+    const char* payload = data + JOURNAL_HEADER_BYTES;
+
+    if (calculateCrc32(payload, payloadLength) != readLittleEndian(data + 4, 4))
+        return false;
+
+    size_t nameLength = readLittleEndian(payload + 19, 2);
+    size_t proteinLength = readLittleEndian(payload + 21, 2);
+    uint8_t type = static_cast<uint8_t>(payload[0]);
+    uint8_t day = static_cast<uint8_t>(payload[1]);
+    uint8_t goal = static_cast<uint8_t>(payload[2]);
+
+    if (JOURNAL_FIXED_BYTES + nameLength + proteinLength != payloadLength ||
+        type < JOURNAL_PROFILE || type > JOURNAL_WEEK_SAVED || day >= NUMBER_OF_DAYS || goal > MUSCLE_GAIN)
+    {
+        return false;
+    }
+
+    uint64_t hoursBits = readLittleEndian(payload + 11, 8);
+
+    entry.type = static_cast<JournalRecordType>(type);
+    entry.day = day;
+    entry.goal = goal;
+    entry.calories = static_cast<int>(static_cast<uint32_t>(readLittleEndian(payload + 3, 4)));
+    entry.mealsPerDay = static_cast<int>(static_cast<uint32_t>(readLittleEndian(payload + 7, 4)));
+    memcpy(&entry.weeklyWorkoutHours, &hoursBits, sizeof(hoursBits));
+    entry.userName = string_view(payload + JOURNAL_FIXED_BYTES, nameLength);
+    entry.protein = string_view(payload + JOURNAL_FIXED_BYTES + nameLength, proteinLength);
+
+    recordBytes = JOURNAL_HEADER_BYTES + payloadLength;
+    return true;
+}
+
+bool readJournal(const string& path, const function<void(const journalEntry&)>& apply, journalRecovery& recovery,
+    uint64_t startOffset)
+{
+    mappedFile file;
+
+    if (!file.open(path))
+        return false;
+
+    uint64_t size = file.size();
+    const char* data = (size > 0) ? file.map(0, static_cast<size_t>(size)) : nullptr;
+
+    if (size > 0 && data == nullptr)
+        return false;
+
+    // Records start after the header in a compacted journal
+    uint64_t firstRecord = 0;
+    uint64_t baseOffset = 0;
+
+    if (size >= JOURNAL_BASE_HEADER_BYTES && memcmp(data, JOURNAL_MAGIC, 8) == 0)
+    {
+        firstRecord = JOURNAL_BASE_HEADER_BYTES;
+        baseOffset = readLittleEndian(data + 8, 8);
+    }
+
+    // A journal that doesn't reach the snapshot's offset was started after it
+    bool reachesStart = startOffset >= baseOffset && startOffset - baseOffset <= size - firstRecord;
+    uint64_t offset = reachesStart ? firstRecord + (startOffset - baseOffset) : firstRecord;
+    size_t recordBytes = 0;
+    journalEntry entry;
+
+    while (offset < size && decodeJournalRecord(data + offset, static_cast<size_t>(size - offset), entry, recordBytes))
+    {
+        apply(entry);
+        offset += recordBytes;
+        recovery.records++;
+    }
+
+    recovery.validBytes = offset;
+    recovery.discardedBytes = size - offset;
+    return true;
+}
+
+journalRecovery recoverJournal(const string& path, sessionStore& users, const trackerSnapshot* snapshot)
+{
+    journalRecovery recovery;
+    unordered_map<string, unique_ptr<nutritionTracker>> recovered;
+    string userName;
+
+    bool found = readJournal(path, [&](const journalEntry& entry)
+        {
+            userName.assign(entry.userName.data(), entry.userName.size());
+            unique_ptr<nutritionTracker>& tracker = recovered[userName];
+
+            // A profile starts the user over, as a new session does
+            if (entry.type == JOURNAL_PROFILE)
+                tracker = make_unique<nutritionTracker>();
+            else if (!tracker && snapshot != nullptr)
+            {
+                tracker = make_unique<nutritionTracker>();
+                if (!snapshot->load(entry.userName, *tracker))
+                    tracker.reset();
+            }
+
+            if (tracker)
+                tracker->applyJournalEntry(entry);
+        }, recovery, (snapshot != nullptr) ? snapshot->getJournalBytes() : 0);
+
+    if (!found)
+        return recovery;
+
+    for (auto& user : recovered)
+    {
+        if (!user.second)
+            continue;
+
+        user.second->calculateMacros();
+        user.second->fillSessionsFromCalories();
+        users.store(user.first, move(user.second));
+        recovery.users++;
+    }
+
+    // New records must follow the last intact one, not the torn bytes after it
+    if (recovery.discardedBytes > 0)
+    {
+        error_code ignored;
+        filesystem::resize_file(path, recovery.validBytes, ignored);
+    }
+
+    return recovery;
+}
+
+size_t unfinishedSessions::load(const string& path)
+{
+    journalRecovery recovery;
+    string userName;
+    lock_guard<mutex> guard(lock);
+
+    bool found = readJournal(path, [&](const journalEntry& entry)
+        {
+            userName.assign(entry.userName.data(), entry.userName.size());
+
+            switch (entry.type)
+            {
+            case JOURNAL_PROFILE:
+            {
+                // A profile starts the user over, as a new session does
+                unfinishedSession& session = sessions[userName];
+                session = unfinishedSession();
+                session.protein.assign(entry.protein.data(), entry.protein.size());
+                session.dailyCalories = entry.calories;
+                session.mealsPerDay = entry.mealsPerDay;
+                session.weeklyWorkoutHours = entry.weeklyWorkoutHours;
+                session.goal = static_cast<GoalType>(entry.goal);
+                break;
+            }
+
+            case JOURNAL_LOG_DAY:
+            {
+                auto session = sessions.find(userName);
+                if (session != sessions.end())
+                {
+                    session->second.dailyCaloriesLog[entry.day] = entry.calories;
+                    session->second.loggedDays = entry.day + 1;
+                }
+                break;
+            }
+
+            case JOURNAL_WEEK_SAVED:
+                sessions.erase(userName);
+                break;
+
+            default:
+                break;   // Edits only follow a saved week
+            }
+        }, recovery);
+
+    // New records must follow the last intact one, not the torn bytes after it
+    if (found && recovery.discardedBytes > 0)
+    {
+        error_code ignored;
+        filesystem::resize_file(path, recovery.validBytes, ignored);
+    }
+
+    return sessions.size();
+}
+
+bool unfinishedSessions::take(const string& userName, unfinishedSession& session)
+{
+    lock_guard<mutex> guard(lock);
+    auto found = sessions.find(userName);
+
+    if (found == sessions.end())
+        return false;
+
+    session = move(found->second);
+    sessions.erase(found);
+    return true;
+}
+
+void unfinishedSessions::rewriteJournal(const string& path) const
+{
+    lock_guard<mutex> guard(lock);
+    remove(path.c_str());
+
+    if (sessions.empty())
+        return;
+
+    calorieJournal journal;
+    if (!journal.open(path))
+        return;
+
+    for (const auto& user : sessions)
+    {
+        const unfinishedSession& session = user.second;
+        journalEntry entry;
+        entry.goal = static_cast<uint8_t>(session.goal);
+        entry.calories = session.dailyCalories;
+        entry.mealsPerDay = session.mealsPerDay;
+        entry.weeklyWorkoutHours = session.weeklyWorkoutHours;
+        entry.userName = user.first;
+        entry.protein = session.protein;
+        journal.append(entry);
+
+        entry.type = JOURNAL_LOG_DAY;
+        entry.protein = string_view();
+
+        for (int day = 0; day < session.loggedDays; day++)
+        {
+            entry.day = static_cast<uint8_t>(day);
+            entry.calories = session.dailyCaloriesLog[day];
+            journal.append(entry);
+        }
     }
 
-    clearInputStream();   // Clear newline left in the buffer
-    return value;
+    journal.close();
+}
+
+unfinishedSessions& getUnfinishedSessions()
+{
+    static unfinishedSessions sessions;
+    return sessions;
 }
 
-double nutritionTracker::getValidatedDoubleInput(string requestInput)
+// Writers append JOURNAL_BENCH_BURST records, then wait for them to be
+//    synced, like the server answering one round of pipelined requests
+benchmarkResult runJournalStress(const string& path, int threadCount)
 {
-    double value;
+    remove(path.c_str());
 
-    cout << requestInput;
-    cin >> value;
-    cout << endl;
+    calorieJournal journal;
+    journal.open(path);
 
-    // Loop continues until the user enters a valid nonnegative double
-    while (cin.fail() || value < 0.0)
+    atomic<bool> stop(false);
+    atomic<long long> records(0);
+    vector<thread> threads;
+
+    long long allocationsBefore = getAllocationCount();
+    auto startTime = chrono::steady_clock::now();
+
+    for (int t = 0; t < threadCount; t++)
     {
-        clearInputStream();
-        setConsoleColor(COLOR_ERROR);
-        cout << "That is not a valid answer. Please enter a nonnegative number: ";
-        setConsoleColor(COLOR_DEFAULT);
+        threads.emplace_back([&, t]
+            {
+                string userName = "Lifter " + to_string(t);
+                journalEntry entry;
+                entry.type = JOURNAL_APPEND;
+                entry.userName = userName;
+                long long done = 0;
+
+                while (!stop.load(memory_order_relaxed))
+                {
+                    uint64_t sequence = 0;
+
+                    for (size_t i = 0; i < JOURNAL_BENCH_BURST; i++)
+                    {
+                        entry.calories = 1500 + static_cast<int>((done + i) % 2000);
+                        sequence = journal.append(entry);
+                    }
+
+                    journal.waitDurable(sequence);
+                    done += JOURNAL_BENCH_BURST;
+                }
+
+                records += done;
+            });
+    }
+
+    this_thread::sleep_for(chrono::duration<double>(BENCH_MIN_SECONDS));
+    stop = true;
+
+    for (thread& worker : threads)
+        worker.join();
+
+    journal.close();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    double totalRecords = static_cast<double>(max(1LL, records.load()));
+
+    benchmarkResult result;
+    result.name = "journal " + to_string(threadCount) + " writer" + (threadCount == 1 ? "" : "s");
+    result.dataSize = JOURNAL_BENCH_BURST;
+    result.nsPerOp = seconds * 1e9 / totalRecords;
+    result.itemsPerSecond = totalRecords / seconds;
+    result.allocationsPerOp = getAllocationsPerOp(allocationsBefore, totalRecords);
 
-        cin >> value;
-        cout << endl;
+    printBenchmarkResult(result);
+    cout << "  " << records.load() << " records in " << journal.getSyncs() << " syncs ("
+        << fixed << setprecision(1) << totalRecords / max(1LL, journal.getSyncs()) << " per sync)\n";
+
+    return result;
+}
+
+bool runJournalCrashTests(const string& path)
+{
+    mt19937 random(2530);
+    const string crashPath = path + ".crash";
+    const char* const proteins[] = { "tofu", "tempeh", "lentils", "seitan" };
+
+    // A journal of every record type with names of varied length
+    remove(path.c_str());
+    {
+        calorieJournal journal;
+        journal.open(path);
+
+        string userName;
+        journalEntry entry;
+
+        for (int i = 0; i < JOURNAL_CRASH_RECORDS; i++)
+        {
+            userName.assign(1 + random() % 40, static_cast<char>('a' + i % 26));
+            entry.type = static_cast<JournalRecordType>(JOURNAL_PROFILE + random() % 5);
+            entry.day = static_cast<uint8_t>(random() % NUMBER_OF_DAYS);
+            entry.goal = static_cast<uint8_t>(random() % 3);
+            entry.calories = 1200 + static_cast<int>(random() % 2500);
+            entry.mealsPerDay = 1 + static_cast<int>(random() % 6);
+            entry.weeklyWorkoutHours = (random() % 80) / 10.0;
+            entry.userName = userName;
+            entry.protein = (entry.type == JOURNAL_PROFILE) ? proteins[random() % 4] : "";
+            journal.append(entry);
+        }
     }
 
-    clearInputStream();   // Clear newline left in the buffer
-    return value;
+    // Where each record ends, so the surviving count is known for any crash point
+    vector<uint64_t> recordEnds;
+    journalRecovery reference;
+    readJournal(path, [&](const journalEntry&)
+        {
+            recordEnds.push_back(0);
+        }, reference);
+
+    string full;
+    {
+        ifstream inFile(path, ios::binary);
+        full.assign(istreambuf_iterator<char>(inFile), istreambuf_iterator<char>());
+    }
+
+    size_t offset = 0;
+    for (uint64_t& end : recordEnds)
+    {
+        journalEntry entry;
+        size_t recordBytes = 0;
+        decodeJournalRecord(full.data() + offset, full.size() - offset, entry, recordBytes);
+        offset += recordBytes;
+        end = offset;
+    }
+
+    bool passed = (reference.records == JOURNAL_CRASH_RECORDS && reference.discardedBytes == 0);
+    auto survivingRecords = [&](uint64_t damagedAt)
+        {
+            return static_cast<long long>(upper_bound(recordEnds.begin(), recordEnds.end(), damagedAt) -
+                recordEnds.begin());
+        };
+    auto recoverCopy = [&](const string& bytes)
+        {
+            writeReportFile(crashPath, bytes);
+            journalRecovery recovery;
+            readJournal(crashPath, [](const journalEntry&) {}, recovery);
+            return recovery;
+        };
+
+    // Torn tails: the process died partway through a write
+    for (int trial = 0; trial < JOURNAL_CRASH_TRIALS && passed; trial++)
+    {
+        size_t cut = random() % full.size();
+        journalRecovery recovery = recoverCopy(full.substr(0, cut));
+        long long expected = survivingRecords(cut);
+
+        passed = recovery.records == expected &&
+            recovery.validBytes == (expected > 0 ? recordEnds[expected - 1] : 0);
+    }
+
+    // Flipped bits: the record holding the damage and everything after it are dropped
+    for (int trial = 0; trial < JOURNAL_CRASH_TRIALS && passed; trial++)
+    {
+        string damaged = full;
+        size_t position = random() % damaged.size();
+        damaged[position] = static_cast<char>(damaged[position] ^ (1 << (random() % 8)));
+
+        passed = recoverCopy(damaged).records == survivingRecords(position);
+    }
+
+    // After recovery cuts a torn tail off, new records follow the intact ones
+    if (passed)
+    {
+        size_t cut = recordEnds[JOURNAL_CRASH_RECORDS / 2] + 5;
+        writeReportFile(crashPath, full.substr(0, cut));
+        sessionStore users;
+        recoverJournal(crashPath, users);
+
+        calorieJournal journal;
+        journalEntry entry;
+        entry.userName = "After crash";
+        entry.protein = "tofu";
+        journal.open(crashPath);
+        journal.waitDurable(journal.append(entry));
+        journal.close();
+
+        journalRecovery recovery;
+        readJournal(crashPath, [](const journalEntry&) {}, recovery);
+        passed = (recovery.records == survivingRecords(cut) + 1 && recovery.discardedBytes == 0);
+    }
+
+    long long acknowledged = 0;
+    long long recovered = 0;
+
+#ifdef __linux__
+    // A real crash: SIGKILL a writer mid-stream. Every record it was told
+    //    had been synced must come back.
+    if (passed)
+    {
+        void* shared = mmap(nullptr, sizeof(atomic<long long>), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        atomic<long long>* synced = new (shared) atomic<long long>(0);
+
+        remove(crashPath.c_str());
+        pid_t writer = fork();
+
+        if (writer == 0)
+        {
+            calorieJournal journal;
+            journal.open(crashPath);
+            journalEntry entry;
+            entry.type = JOURNAL_APPEND;
+            entry.userName = "Killed writer";
+
+            for (long long n = 1; ; n++)
+            {
+                entry.calories = static_cast<int>(n % 4000);
+                uint64_t sequence = journal.append(entry);
+
+                if (n % JOURNAL_BENCH_BURST == 0 && journal.waitDurable(sequence))
+                    synced->store(n);
+            }
+        }
+
+        this_thread::sleep_for(chrono::duration<double>(BENCH_MIN_SECONDS));
+        kill(writer, SIGKILL);
+        waitpid(writer, nullptr, 0);
+
+        acknowledged = synced->load();
+        munmap(shared, sizeof(atomic<long long>));
+
+        journalRecovery recovery;
+        readJournal(crashPath, [](const journalEntry&) {}, recovery);
+        recovered = recovery.records;
+        passed = (acknowledged > 0 && recovered >= acknowledged);
+    }
+#endif
+
+    remove(crashPath.c_str());
+
+    cout << "Journal crash injection: " << JOURNAL_CRASH_TRIALS << " torn tails, " << JOURNAL_CRASH_TRIALS
+        << " flipped bits";
+#ifdef __linux__
+    cout << ", killed writer (" << acknowledged << " synced, " << recovered << " recovered)";
+#endif
+    cout << ": " << (passed ? "passed" : "FAILED") << "\n";
+
+    return passed;
 }
 
-GoalType nutritionTracker::getUserGoal()
+
+// --------------------- Snapshot ---------------------
+bool trackerSnapshot::open(const string& path)
 {
-    int goalChoice = 0;
+    if (!file.open(path) || file.size() < SNAPSHOT_HEADER_BYTES)
+        return false;
+
+    uint64_t size = file.size();
+    const char* data = file.map(0, static_cast<size_t>(size));
+
+    if (data == nullptr || memcmp(data, SNAPSHOT_MAGIC, 8) != 0)
+        return false;
+
+    userCount = readLittleEndian(data + 8, 8);
+    tableSlots = readLittleEndian(data + 16, 8);
+    journalBytes = readLittleEndian(data + 24, 8);
+    uint64_t tableOffset = readLittleEndian(data + 32, 8);
+    uint64_t historyOffset = readLittleEndian(data + 40, 8);
+    uint64_t textOffset = readLittleEndian(data + 48, 8);
+
+    // Every area must be where its size says, so lookups never leave the file
+    if (calculateCrc32(data, 56) != readLittleEndian(data + 56, 4) || tableSlots == 0 || (tableSlots & (tableSlots - 1)) != 0 || userCount >= tableSlots ||
+        tableOffset != SNAPSHOT_HEADER_BYTES + userCount * SNAPSHOT_RECORD_BYTES ||
+        historyOffset != tableOffset + 4 * tableSlots || textOffset < historyOffset ||
+        (textOffset - historyOffset) % 4 != 0 || textOffset > size)
+    {
+        userCount = 0;
+        return false;
+    }
 
-    cout << "Select your primary goal:\n"
-        << "  1. Fat loss\n"
-        << "  2. Maintenance\n"
-        << "  3. Muscle gain\n\n";
-    cout << "Enter 1, 2, or 3: ";
-    cin >> goalChoice;
-    cout << endl;
+    records = data + SNAPSHOT_HEADER_BYTES;
+    table = data + tableOffset;
+    historyValues = data + historyOffset;
+    text = data + textOffset;
+    historyCount = (textOffset - historyOffset) / 4;
+    textBytes = size - textOffset;
+    return true;
+}
+
+bool trackerSnapshot::recordFits(const char record[]) const
+{
+    uint64_t textOffset = readLittleEndian(record, 8);
+    uint64_t historyIndex = readLittleEndian(record + 8, 8);
+    uint64_t dayCount = readLittleEndian(record + 16, 4);
+    uint64_t textLength = readLittleEndian(record + 20, 2) + readLittleEndian(record + 22, 2);
+
+    return textOffset <= textBytes && textLength <= textBytes - textOffset &&
+        historyIndex <= historyCount && dayCount <= historyCount - historyIndex &&
+        static_cast<uint8_t>(record[52]) <= MUSCLE_GAIN;
+}
+
+bool trackerSnapshot::recordIntact(const char record[]) const
+{
+    return recordFits(record) &&
+        calculateSnapshotRecordCrc(record, historyValues, text) == readLittleEndian(record + 88, 4);
+}
+
+// Damaged users have no name, so no lookup finds them and they aren't copied
+string_view trackerSnapshot::getName(size_t index) const
+{
+    const char* record = records + index * SNAPSHOT_RECORD_BYTES;
+
+    if (index >= userCount || !recordIntact(record))
+        return string_view();
+
+    return string_view(text + readLittleEndian(record, 8), static_cast<size_t>(readLittleEndian(record + 20, 2)));
+}
+
+bool trackerSnapshot::load(string_view userName, nutritionTracker& tracker) const
+{
+    if (userCount == 0)
+        return false;
 
-    while (cin.fail() || goalChoice < 1 || goalChoice > 3)
+    uint64_t mask = tableSlots - 1;
+    uint64_t slot = hashSnapshotName(userName) & mask;
+
+    // Linear probing; the table is never full, so an empty slot ends the search
+    for (uint64_t probes = 0; probes < tableSlots; probes++, slot = (slot + 1) & mask)
     {
-        clearInputStream();
-        setConsoleColor(COLOR_ERROR);
-        cout << "That is not a valid choice. Please enter 1, 2, or 3: ";
-        setConsoleColor(COLOR_DEFAULT);
+        uint64_t entry = readLittleEndian(table + 4 * slot, 4);
 
-        cin >> goalChoice;
-        cout << endl;
+        if (entry == 0 || entry > userCount)
+            return false;
+
+        if (getName(static_cast<size_t>(entry - 1)) == userName)
+        {
+            tracker.loadSnapshotRecord(records + (entry - 1) * SNAPSHOT_RECORD_BYTES, historyValues, text);
+            return true;
+        }
     }
 
-    clearInputStream();
+    return false;
+}
+
+void trackerSnapshot::appendRecord(size_t index, string& newRecords, string& newHistory, string& newText) const
+{
+    const char* record = records + index * SNAPSHOT_RECORD_BYTES;
+
+    if (index >= userCount || !recordIntact(record))
+        return;
 
-    // Convert user's goal choice to the enum value (0-2)
-    return static_cast<GoalType>(goalChoice - 1);
+    uint64_t textOffset = readLittleEndian(record, 8);
+    uint64_t historyIndex = readLittleEndian(record + 8, 8);
+    size_t dayCount = static_cast<size_t>(readLittleEndian(record + 16, 4));
+    size_t textLength = static_cast<size_t>(readLittleEndian(record + 20, 2) + readLittleEndian(record + 22, 2));
+    size_t start = newRecords.size();
+
+    // Same bytes, with the offsets moved to where the text and history land
+    newRecords.append(record, SNAPSHOT_RECORD_BYTES);
+    writeLittleEndian(&newRecords[start], newText.size(), 8);
+    writeLittleEndian(&newRecords[start + 8], newHistory.size() / 4, 8);
+    newText.append(text + textOffset, textLength);
+    newHistory.append(historyValues + 4 * historyIndex, 4 * dayCount);
+
+    // The offsets changed, so the CRC does too
+    writeLittleEndian(&newRecords[start + 88],
+        calculateSnapshotRecordCrc(&newRecords[start], newHistory.data(), newText.data()), 4);
 }
 
+bool writeTrackerSnapshot(const string& path, const sessionStore& users, const trackerSnapshot* previous,
+    uint64_t journalBytes, size_t& userCount)
+{
+    string records;
+    string historyValues;
+    string text;
+    vector<uint64_t> hashes;
 
-// --------------------- Core Processing ---------------------
-void nutritionTracker::calculateMacros()
+    users.forEach([&](const string& userName, const nutritionTracker& tracker)
+        {
+            tracker.appendSnapshotRecord(records, historyValues, text);
+            hashes.push_back(hashSnapshotName(userName));
+        });
+
+    if (previous != nullptr)
+    {
+        string userName;
+
+        for (size_t i = 0; i < previous->size(); i++)
+        {
+            string_view previousName = previous->getName(i);
+            userName.assign(previousName.data(), previousName.size());
+
+            if (!previousName.empty() && !users.read(userName, [](const nutritionTracker&) {}))
+            {
+                previous->appendRecord(i, records, historyValues, text);
+                hashes.push_back(hashSnapshotName(previousName));
+            }
+        }
+    }
+
+    userCount = hashes.size();
+
+    // At most half full, so probes stay short and always reach an empty slot
+    uint64_t tableSlots = 2;
+    while (tableSlots < 2 * static_cast<uint64_t>(userCount))
+        tableSlots *= 2;
+
+    string table(static_cast<size_t>(4 * tableSlots), '\0');
+    for (size_t i = 0; i < userCount; i++)
+    {
+        uint64_t slot = hashes[i] & (tableSlots - 1);
+        while (readLittleEndian(&table[4 * slot], 4) != 0)
+            slot = (slot + 1) & (tableSlots - 1);
+        writeLittleEndian(&table[4 * slot], i + 1, 4);
+    }
+
+    char header[SNAPSHOT_HEADER_BYTES] = {};
+    uint64_t tableOffset = SNAPSHOT_HEADER_BYTES + records.size();
+    memcpy(header, SNAPSHOT_MAGIC, 8);
+    writeLittleEndian(header + 8, userCount, 8);
+    writeLittleEndian(header + 16, tableSlots, 8);
+    writeLittleEndian(header + 24, journalBytes, 8);
+    writeLittleEndian(header + 32, tableOffset, 8);
+    writeLittleEndian(header + 40, tableOffset + table.size(), 8);
+    writeLittleEndian(header + 48, tableOffset + table.size() + historyValues.size(), 8);
+    writeLittleEndian(header + 56, calculateCrc32(header, 56), 4);
+
+    // A crash mid-write leaves the old snapshot in place
+    string temporaryPath = path + ".tmp";
+    FILE* outFile = fopen(temporaryPath.c_str(), "wb");
+
+    if (outFile == nullptr)
+        return false;
+
+    bool written = fwrite(header, 1, sizeof(header), outFile) == sizeof(header) &&
+        fwrite(records.data(), 1, records.size(), outFile) == records.size() &&
+        fwrite(table.data(), 1, table.size(), outFile) == table.size() &&
+        fwrite(historyValues.data(), 1, historyValues.size(), outFile) == historyValues.size() &&
+        fwrite(text.data(), 1, text.size(), outFile) == text.size() && fflush(outFile) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(outFile)) == 0;
+#else
+    written = written && fsync(fileno(outFile)) == 0;
+#endif
+    written = (fclose(outFile) == 0) && written;
+
+    error_code renameError;
+    if (written)
+        filesystem::rename(temporaryPath, path, renameError);
+
+    if (!written || renameError)
+    {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t calculateSnapshotRecordCrc(const char record[], const char historyValues[], const char text[])
 {
-    // Daily macro grams based on percentage of calories
-    dailyProteinGrams = static_cast<int>((dailyCalories * PROTEIN_PERCENT) /
-        CALORIES_PER_GRAM_PROTEIN);
-    dailyCarbGrams = static_cast<int>((dailyCalories * CARB_PERCENT) /
-        CALORIES_PER_GRAM_CARBS);
-    dailyFatGrams = static_cast<int>((dailyCalories * FAT_PERCENT) /
-        CALORIES_PER_GRAM_FAT);
+    uint64_t textOffset = readLittleEndian(record, 8);
+    uint64_t historyIndex = readLittleEndian(record + 8, 8);
+    size_t dayCount = static_cast<size_t>(readLittleEndian(record + 16, 4));
+    size_t textLength = static_cast<size_t>(readLittleEndian(record + 20, 2) + readLittleEndian(record + 22, 2));
+
+    uint32_t crc = calculateCrc32(record, SNAPSHOT_RECORD_BYTES - 4);
+    crc = calculateCrc32(historyValues + 4 * historyIndex, 4 * dayCount, crc);
+    return calculateCrc32(text + textOffset, textLength, crc);
+}
 
-    // Per meal targets.
-    proteinPerMeal = dailyProteinGrams / mealsPerDay;
-    carbsPerMeal = dailyCarbGrams / mealsPerDay;
-    fatsPerMeal = dailyFatGrams / mealsPerDay;
+uint64_t hashSnapshotName(string_view userName)
+{
+    uint64_t hash = 14695981039346656037ULL;
 
-    // Accumulates weekly macro totals based on daily values
-    weeklyCalories = 0;
-    totalProteinGrams = 0;
-    totalCarbGrams = 0;
-    totalFatGrams = 0;
+    for (char c : userName)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+void restoreServerUsers(const string& snapshotPath, const string& journalPath, serverScratch& scratch)
+{
+    scratch.snapshot = make_unique<trackerSnapshot>();
+
+    if (scratch.snapshot->open(snapshotPath))
+        cout << "Mapped " << scratch.snapshot->size() << " users from " << snapshotPath << "\n";
+    else
+    {
+        error_code ignored;
+        if (filesystem::exists(snapshotPath, ignored))
+            cerr << "Warning: " << snapshotPath << " is damaged; only the journal is replayed\n";
+        scratch.snapshot.reset();
+    }
+
+    journalRecovery recovery = recoverJournal(journalPath, getSessionStore(), scratch.snapshot.get());
+
+    if (recovery.records > 0)
+    {
+        cout << "Recovered " << recovery.users << " user" << (recovery.users == 1 ? "" : "s") << " from "
+            << recovery.records << " records in " << journalPath;
+        if (recovery.discardedBytes > 0)
+            cout << " (dropped a " << recovery.discardedBytes << "-byte torn tail)";
+        cout << "\n";
+    }
+}
+
+void takeServerSnapshot(const string& path, const string& journalPath, serverScratch& scratch, bool stopping)
+{
+    // One writer at a time; a snapshot that comes due meanwhile waits for it
+    finishServerSnapshot(path, journalPath, scratch, stopping);
+
+    auto startTime = chrono::steady_clock::now();
+
+    if (scratch.snapshotWriter != 0 || scratch.changes == scratch.snapshotChanges ||
+        (!stopping && startTime - scratch.lastSnapshot < chrono::seconds(SERVER_SNAPSHOT_SECONDS)))
+        return;
+
+    // A failed write is retried at the next interval
+    scratch.snapshotChanges = scratch.changes;
+    scratch.lastSnapshot = startTime;
+    scratch.snapshotJournalBytes = getJournalEndOffset(journalPath);
+    size_t userCount = 0;
+
+#ifdef __linux__
+    // The child writes from its copy-on-write view of the users, so this loop
+    //    keeps answering. The last snapshot, when stopping, is written here.
+    if (!stopping)
+    {
+        pid_t writer = fork();
+
+        if (writer == 0)
+        {
+            // Closed clients must see EOF now, not when the child exits
+            error_code ignored;
+            for (const auto& descriptor : filesystem::directory_iterator("/proc/self/fd", ignored))
+            {
+                struct stat info;
+                int handle = atoi(descriptor.path().filename().string().c_str());
+                if (handle > 2 && fstat(handle, &info) == 0 && S_ISSOCK(info.st_mode))
+                    close(handle);
+            }
+
+            _exit(writeTrackerSnapshot(path, getSessionStore(), scratch.snapshot.get(),
+                scratch.snapshotJournalBytes, userCount) ? 0 : 1);
+        }
+
+        if (writer > 0)
+        {
+            scratch.snapshotWriter = writer;
+            return;
+        }
+
+        // No child: write it here instead
+    }
+#endif
+
+    useServerSnapshot(path, journalPath, scratch, writeTrackerSnapshot(path, getSessionStore(),
+        scratch.snapshot.get(), scratch.snapshotJournalBytes, userCount));
+}
+
+void finishServerSnapshot(const string& path, const string& journalPath, serverScratch& scratch, bool stopping)
+{
+#ifdef __linux__
+    if (scratch.snapshotWriter == 0)
+        return;
+
+    int status = 0;
+    pid_t finished = waitpid(scratch.snapshotWriter, &status, stopping ? 0 : WNOHANG);
+
+    if (finished == 0)
+        return;
 
-    for (int day = 1; day <= NUMBER_OF_DAYS; ++day)
+    scratch.snapshotWriter = 0;
+    useServerSnapshot(path, journalPath, scratch, finished > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+#else
+    (void)path;
+    (void)journalPath;
+    (void)scratch;
+    (void)stopping;
+#endif
+}
+
+void useServerSnapshot(const string& path, const string& journalPath, serverScratch& scratch, bool written)
+{
+    if (!written)
+    {
+        cerr << "Warning: Unable to write snapshot " << path << "\n";
+        scratch.snapshotChanges = -1;
+        return;
+    }
+
+    // The snapshot holds every record before its offset, so the journal
+    //    only has to keep the ones after it
+    calorieJournal& journal = getJournal();
+    if (journal.isOpen() && !journal.hasFailed() && !journal.compact(scratch.snapshotJournalBytes))
+        cerr << "Warning: Unable to compact " << journalPath << "; it keeps records the snapshot holds\n";
+
+    // Serve untouched users from the new file; the old mapping goes with the old object
+    scratch.snapshot = make_unique<trackerSnapshot>();
+    if (!scratch.snapshot->open(path))
+        scratch.snapshot.reset();
+
+    size_t userCount = scratch.snapshot ? scratch.snapshot->size() : 0;
+    cout << "Snapshot of " << userCount << " users written to " << path << " in " << fixed << setprecision(1)
+        << chrono::duration<double, milli>(chrono::steady_clock::now() - scratch.lastSnapshot).count() << " ms\n";
+    cout.flush();
+}
+
+// STORE_BENCH_USERS users restart from a journal of their profiles and
+//    weeks, then from a snapshot of the same users. Each time runs until the
+//    first request (one user's summary) can be answered.
+void runRestartBenchmark(vector<benchmarkResult>& results)
+{
+    const string journalPath = "bench_restart.journal";
+    const string snapshotPath = "bench_restart.snapshot";
+    mt19937 random(2530);
+
+    remove(journalPath.c_str());
+    {
+        calorieJournal journal;
+        journal.open(journalPath);
+
+        string userName;
+        journalEntry entry;
+
+        for (size_t i = 0; i < STORE_BENCH_USERS; i++)
+        {
+            userName = "Lifter " + to_string(i);
+            entry.type = JOURNAL_PROFILE;
+            entry.userName = userName;
+            entry.protein = "tofu";
+            entry.calories = 1500 + static_cast<int>(random() % 2000);
+            entry.mealsPerDay = 2 + static_cast<int>(random() % 5);
+            entry.weeklyWorkoutHours = (random() % 80) / 10.0;
+            entry.goal = static_cast<uint8_t>(random() % 3);
+            journal.append(entry);
+
+            entry.type = JOURNAL_LOG_DAY;
+            entry.protein = string_view();
+
+            for (int day = 0; day < NUMBER_OF_DAYS; day++)
+            {
+                entry.day = static_cast<uint8_t>(day);
+                entry.calories = 1200 + static_cast<int>(random() % 2500);
+                journal.append(entry);
+            }
+        }
+    }
+
+    const string firstUser = "Lifter " + to_string(STORE_BENCH_USERS / 2);
+    long long sink = 0;
+    auto answerFirstRequest = [&](sessionStore& users, const trackerSnapshot* snapshot)
+        {
+            if (!users.read(firstUser, [&](const nutritionTracker& tracker) { sink += tracker.getHistory().size(); }) &&
+                snapshot != nullptr)
+            {
+                unique_ptr<nutritionTracker> tracker = make_unique<nutritionTracker>();
+                if (snapshot->load(firstUser, *tracker))
+                {
+                    sink += tracker->getHistory().size();
+                    users.store(firstUser, move(tracker));
+                }
+            }
+        };
+
+    // Cold: every user is rebuilt from the journal before anything is answered
+    sessionStore coldUsers;
+    auto startTime = chrono::steady_clock::now();
+    recoverJournal(journalPath, coldUsers);
+    answerFirstRequest(coldUsers, nullptr);
+    double coldSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    error_code sizeError;
+    uint64_t journalBytes = filesystem::file_size(journalPath, sizeError);
+    size_t userCount = 0;
+
+    startTime = chrono::steady_clock::now();
+    writeTrackerSnapshot(snapshotPath, coldUsers, nullptr, sizeError ? 0 : journalBytes, userCount);
+    double writeSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    // Warm: map the snapshot, replay the (empty) journal tail, answer
+    sessionStore warmUsers;
+    startTime = chrono::steady_clock::now();
+    {
+        trackerSnapshot snapshot;
+        snapshot.open(snapshotPath);
+        recoverJournal(journalPath, warmUsers, &snapshot);
+        answerFirstRequest(warmUsers, &snapshot);
+    }
+    double warmSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    for (int warm = 0; warm < 2; warm++)
+    {
+        double seconds = warm ? warmSeconds : coldSeconds;
+
+        benchmarkResult result;
+        result.name = warm ? "restart from snapshot" : "restart from journal";
+        result.dataSize = STORE_BENCH_USERS;
+        result.nsPerOp = seconds * 1e9;   // One restart
+        result.itemsPerSecond = STORE_BENCH_USERS / seconds;
+        result.allocationsPerOp = 0.0;
+        printBenchmarkResult(result);
+        results.push_back(result);
+    }
+
+    cout << "Time to first request after restart (" << STORE_BENCH_USERS << " users): " << fixed
+        << setprecision(1) << coldSeconds * 1000.0 << " ms replaying the journal, " << setprecision(3)
+        << warmSeconds * 1000.0 << " ms from the snapshot\n"
+        << "Snapshot of " << userCount << " users written in " << setprecision(1) << writeSeconds * 1000.0
+        << " ms (" << filesystem::file_size(snapshotPath, sizeError) << " bytes, checksum " << sink << ")\n";
+
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+}
+
+
+// --------------------- Load Generator ---------------------
+int runLoadGenerator(const loadgenOptions& options)
+{
+    int workers = static_cast<int>(min<long long>(options.concurrency, options.sessions));
+    sessionLatencies latencies;
+
+    cout << "Simulating " << options.sessions << " sessions with " << workers << " worker"
+        << (workers == 1 ? "" : "s") << " (seed " << options.seed << ")...\n";
+    cout.flush();
+
+    auto startTime = chrono::steady_clock::now();
+
+    if (workers == 1)
+        runLoadgenWorker(options, 0, latencies);
+    else
     {
-        totalProteinGrams += dailyProteinGrams;
-        totalCarbGrams += dailyCarbGrams;
-        totalFatGrams += dailyFatGrams;
+#ifdef __linux__
+        vector<pid_t> children;
+        vector<FILE*> results;
+
+        for (int worker = 0; worker < workers; worker++)
+        {
+            int ends[2];
+
+            if (pipe(ends) != 0)
+            {
+                cerr << "Error: Unable to create a pipe: " << strerror(errno) << "\n";
+                break;
+            }
+
+            pid_t child = fork();
+
+            if (child == 0)
+            {
+                close(ends[0]);
+                sessionLatencies workerLatencies;
+                runLoadgenWorker(options, worker, workerLatencies);
+
+                // Per stage: sample count, then the samples
+                FILE* out = fdopen(ends[1], "wb");
+                for (const vector<long long>& samples : workerLatencies.samples)
+                {
+                    uint64_t count = samples.size();
+                    fwrite(&count, sizeof(count), 1, out);
+                    fwrite(samples.data(), sizeof(long long), samples.size(), out);
+                }
+                fclose(out);
+                _exit(0);
+            }
+
+            close(ends[1]);
+
+            if (child < 0)
+            {
+                close(ends[0]);
+                cerr << "Error: Unable to start a worker: " << strerror(errno) << "\n";
+                break;
+            }
+
+            children.push_back(child);
+            results.push_back(fdopen(ends[0], "rb"));
+        }
+
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            for (vector<long long>& samples : latencies.samples)
+            {
+                uint64_t count = 0;
+
+                if (fread(&count, sizeof(count), 1, results[i]) != 1)
+                    break;
+
+                size_t start = samples.size();
+                samples.resize(start + static_cast<size_t>(count));
+                samples.resize(start + fread(samples.data() + start, sizeof(long long), samples.size() - start,
+                    results[i]));
+            }
+
+            fclose(results[i]);
+            waitpid(children[i], nullptr, 0);
+        }
+
+        if (static_cast<int>(children.size()) != workers)
+            return 1;
+#else
+        cerr << "Error: --concurrency above 1 needs Linux (fork)\n";
+        return 1;
+#endif
     }
-}
 
-void nutritionTracker::fillDailyCaloriesArray()
-{
-    cout << "Now let's log your actual calories for each day this week.\n";
-    cout << "(Enter a positive number for each day.)\n\n";
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    long long sessions = static_cast<long long>(latencies.samples[STAGE_USER_INPUT].size());
+    long long operations = 0;
 
-    int caloriesDayTotal = 0;
+    for (const vector<long long>& samples : latencies.samples)
+        operations += static_cast<long long>(samples.size());
 
-    for (int day = 0; day < NUMBER_OF_DAYS; ++day)
-    {
-        cout << "Enter your total calories for day " << (day + 1) << ": ";
-        cin >> caloriesDayTotal;
+    ofstream outFile(options.resultsPath);
 
-        // Repeat until the user enters a valid answer
-        while (cin.fail() || caloriesDayTotal < 0)
-        {
-            clearInputStream();
-            setConsoleColor(COLOR_ERROR);
-            cout << "Please enter a positive number for the day " << (day + 1) << ": ";
-            setConsoleColor(COLOR_DEFAULT);
+    if (!outFile)
+    {
+        cerr << "Error: Unable to open " << options.resultsPath << "\n";
+        return 1;
+    }
 
-            cin >> caloriesDayTotal;
-        }
+    cout << left << setw(50) << setfill('.') << "Sessions completed: " << right << sessions << "\n"
+        << fixed << setprecision(1)
+        << left << setw(50) << "Sessions per second: " << right << sessions / seconds << "\n"
+        << left << setw(50) << "Operations per second: " << right << operations / seconds << "\n"
+        << setfill(' ') << "\n"
+        << left << setw(24) << "Operation" << right << setw(9) << "Calls" << setw(10) << "p50 (us)"
+        << setw(10) << "p95 (us)" << setw(10) << "p99 (us)" << setw(11) << "p999 (us)" << setw(11) << "Max (us)" << "\n";
 
-        clearInputStream();
-        dailyCaloriesLog[day] = caloriesDayTotal;
-    }
+    outFile << fixed << setprecision(3)
+        << "{\n  \"sessions\": " << sessions << ", \"concurrency\": " << workers << ", \"seed\": " << options.seed
+        << ",\n  \"seconds\": " << seconds << ", \"sessions_per_s\": " << sessions / seconds
+        << ", \"operations_per_s\": " << operations / seconds << ",\n  \"operations\": [";
 
-    // Compute actual weekly calorie total from the array
-    weeklyCalories = 0;
+    bool first = true;
 
-    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
     {
-        weeklyCalories += dailyCaloriesLog[i];
+        vector<long long>& samples = latencies.samples[stage];
+
+        if (samples.empty())
+            continue;
+
+        sort(samples.begin(), samples.end());
+        auto percentile = [&](double fraction)
+            {
+                size_t index = static_cast<size_t>(fraction * (samples.size() - 1));
+                return samples[index] / 1e3;
+            };
+
+        double totalNs = 0.0;
+        for (long long sample : samples)
+            totalNs += static_cast<double>(sample);
+
+        const char* name = getStageName(static_cast<TrackerStage>(stage));
+
+        cout << left << setw(24) << name << right << setw(9) << samples.size() << setprecision(1)
+            << setw(10) << percentile(0.50) << setw(10) << percentile(0.95) << setw(10) << percentile(0.99)
+            << setw(11) << percentile(0.999) << setw(11) << samples.back() / 1e3 << "\n";
+
+        outFile << (first ? "\n" : ",\n") << setprecision(3)
+            << "    {\"name\": \"" << name << "\", \"calls\": " << samples.size()
+            << ", \"mean_us\": " << totalNs / samples.size() / 1e3
+            << ", \"p50_us\": " << percentile(0.50)
+            << ", \"p95_us\": " << percentile(0.95)
+            << ", \"p99_us\": " << percentile(0.99)
+            << ", \"p999_us\": " << percentile(0.999)
+            << ", \"max_us\": " << samples.back() / 1e3 << "}";
+        first = false;
     }
 
-    cout << "Thank you! Your weekly calorie log has been recorded.\n\n";
+    outFile << "\n  ]\n}\n";
+    cout << "\nResults written to " << options.resultsPath << "\n";
+    return 0;
 }
 
-void nutritionTracker::fillSessionsFromCalories()
+string makeLoadgenSession(unsigned seed, long long sessionIndex)
 {
-    string dayNames[NUMBER_OF_DAYS] = { "Day 1", "Day 2", "Day 3", "Day 4",
-            "Day 5", "Day 6", "Day 7" };
+    const char* const proteins[] = { "tofu", "tempeh", "lentils", "seitan", "chickpeas", "edamame" };
+    const int mixSize = static_cast<int>(sizeof(LOADGEN_MENU_MIX) / sizeof(LOADGEN_MENU_MIX[0]));
+    mt19937 random(seed ^ static_cast<unsigned>(sessionIndex * 2654435761ULL));
+    string answers;
+
+    // Profile, with the hours written the way a person would (one decimal)
+    answers += "Load user " + to_string(sessionIndex) + "\n";
+    answers += proteins[random() % 6];
+    answers += "\n" + to_string(1500 + random() % 2000) + "\n" + to_string(2 + random() % 5) + "\n";
+    answers += to_string(random() % 15) + "." + to_string(random() % 10) + "\n";
+    answers += to_string(1 + random() % 3) + "\n";
 
-    for (int i = 0; i < NUMBER_OF_DAYS; i++)
-    {
-        weeklySessions[i].date = dayNames[i];
-        weeklySessions[i].calories = dailyCaloriesLog[i];
+    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+        answers += to_string(1200 + random() % 2500) + "\n";
 
-        weeklySessions[i].protein = dailyProteinGrams;
-        weeklySessions[i].carbs = dailyCarbGrams;
-        weeklySessions[i].fats = dailyFatGrams;
+    int choices = LOADGEN_MIN_MENU_CHOICES +
+        static_cast<int>(random() % (LOADGEN_MAX_MENU_CHOICES - LOADGEN_MIN_MENU_CHOICES + 1));
 
-        // True if the user did not exceed their calorie target
-        weeklySessions[i].metCalorieGoal = (dailyCaloriesLog[i] <= dailyCalories);
+    for (int i = 0; i < choices; i++)
+    {
+        int menuChoice = LOADGEN_MENU_MIX[random() % mixSize];
+        answers += to_string(menuChoice) + "\n";
+
+        if (menuChoice == 8)
+        {
+            // Both ends inside the week just logged
+            int firstDay = 1 + static_cast<int>(random() % NUMBER_OF_DAYS);
+            int lastDay = firstDay + static_cast<int>(random() % (NUMBER_OF_DAYS - firstDay + 1));
+            answers += to_string(firstDay) + "\n" + to_string(lastDay) + "\n";
+        }
+        else if (menuChoice == 11 && random() % 2 == 0)
+            answers += "1\n" + to_string(1 + random() % NUMBER_OF_DAYS) + "\n" + to_string(1200 + random() % 2500) + "\n";
+        else if (menuChoice == 11)
+            answers += "2\n" + to_string(2 + random() % 5) + "\n";
     }
+
+    answers += to_string(MENU_EXIT) + "\n";
+    return answers;
 }
 
-// New function to fill 2D arrray added to program
-void nutritionTracker::fillMacrosPerMeal2D()
+void runLoadgenWorker(const loadgenOptions& options, int worker, sessionLatencies& latencies)
 {
-    for (int day = 0; day < NUMBER_OF_DAYS; day++)
+    isConsoleCaptured();   // Remember the real console before redirecting cout
+    streambuf* console = cout.rdbuf();
+    ostringstream capture;
+    sessionStore users;    // Every simulated user stays active, as with menu option 7
+    string answers;
+
+    for (long long session = worker; session < options.sessions; session += options.concurrency)
     {
-        macrosPerMeal2D[0][day] = proteinPerMeal;
-        macrosPerMeal2D[1][day] = carbsPerMeal;
-        macrosPerMeal2D[2][day] = fatsPerMeal;
+        answers = makeLoadgenSession(options.seed, session);
+        sessionInput input(answers);
+
+        capture.str("");
+        cout.rdbuf(capture.rdbuf());
+        sessionTask simulated = runInteractiveSession(input, users, false, &latencies);
+        runSessionToEnd(simulated, input);
+        cout.rdbuf(console);
     }
 }
 
 
-// --------------------- Helpers ---------------------
-double nutritionTracker::calculateAverageCalories() const
+// --------------------- Session Multiplexer ---------------------
+sessionMultiplexer::sessionMultiplexer(sessionStore& sessionUsers)
+    : users(sessionUsers)
 {
-    return calculateAverageFromArray(dailyCaloriesLog, NUMBER_OF_DAYS);
+    isConsoleCaptured();   // Remember the real console before redirecting cout
 }
 
-double nutritionTracker::calculateAverageFromArray(const int values[], int size) const
+int sessionMultiplexer::open()
 {
-    int sum = 0;
-
-    for (int i = 0; i < size; i++)
-        sum += values[i];
-
-    return static_cast<double>(sum) / size;
+    int id = nextSession++;
+    unique_ptr<multiplexedSession> session = make_unique<multiplexedSession>();
+    multiplexedSession& opened = *session;
+
+    // Menu sessions don't touch <name>_sessions.bin, report.txt or perf_stats.txt:
+    //    many people share the server, and its one thread must not wait on files
+    opened.format.copyfmt(cout);
+    opened.task = runInteractiveSession(opened.input, users, false, nullptr, false);
+    sessions.emplace(id, move(session));
+
+    run(opened, true);
+    return id;
 }
 
-int nutritionTracker::findHighestCalories() const
+void sessionMultiplexer::feed(int session, string_view typed)
 {
-    int highest = dailyCaloriesLog[0];
+    auto found = sessions.find(session);
 
-    for (int day = 0; day < NUMBER_OF_DAYS; ++day)
-    {
-        if (dailyCaloriesLog[day] > highest)
-            highest = dailyCaloriesLog[day];
-    }
-    return highest;
-}
+    if (found == sessions.end())
+        return;
 
-void nutritionTracker::evaluateMealFrequency(int mealsPerWeek)  const
-{
-    if (mealsPerWeek >= MEALS_PER_WEEK_MEDIUM &&
-        mealsPerWeek <= MEALS_PER_WEEK_HIGH &&
-        weeklyWorkoutHours >= ACTIVITY_HIGH)
-    {
-        cout << "Excellent meal frequency for muscle recovery! Try the smoothie below!\n\n";
-    }
-    else if (mealsPerWeek < MEALS_PER_WEEK_MEDIUM &&
-        weeklyWorkoutHours >= ACTIVITY_MEDIUM)
-    {
-        cout << "Consider eating more often to support your training. Try the smoothie below!\n\n";
-    }
-    else if (mealsPerWeek > MEALS_PER_WEEK_HIGH)
-    {
-        cout << "You might be eating more than necessary  ensure portion sizes are balanced. Try the smoothie below!\n\n";
-    }
-    else
-    {
-        cout << "Your meal frequency seems appropriate for your activity level. Try the smoothie below!\n\n";
-    }
+    found->second->input.feed(typed);
+    run(*found->second, false);
 }
 
-void nutritionTracker::evaluateNutrition() const
+void sessionMultiplexer::finish(int session)
 {
-    if (weeklyWorkoutHours >= ACTIVITY_HIGH && dailyCalories >= CAL_HIGH)
-        cout << "Your intake is sufficient for a high activity week. Keep it up!\n\n";
-    else if (weeklyWorkoutHours >= ACTIVITY_MEDIUM && dailyCalories >= CAL_MEDIUM)
-        cout << "Your intake is decent for your activity level, but you could increase protein slightly.\n\n";
-    else if (weeklyWorkoutHours < ACTIVITY_MEDIUM && dailyCalories < CAL_LOW)
-        cout << "You might be under fueling. Consider adding extra calories per day.\n\n";
-    else if (weeklyWorkoutHours < ACTIVITY_MEDIUM && dailyCalories > CAL_EXCESS)
-        cout << "You may be eating more than your activity requires. Consider slightly reducing calories per day.\n\n";
-    else
-        cout << "Your calorie intake seems balanced for your activity level.\n\n";
+    auto found = sessions.find(session);
 
-    // Additional guidance based on goal(enum used in switch)
-    switch (goal)
-    {
-    case FAT_LOSS:
-        cout << "Goal: Fat loss\n";
-        cout << "Aim for a small, sustainable calorie deficit and prioritize protein.\n\n";
-        break;
-    case MAINTENANCE:
-        cout << "Goal: Maintenance\n";
-        cout << "Keep your calorie intake steady and focus on consistency.\n\n";
-        break;
-    case MUSCLE_GAIN:
-        cout << "Goal: Muscle gain\n";
-        cout << "Make sure you're in a slight calorie surplus and hitting your protein target.\n\n";
-        break;
-    default:
-        break;
-    }
-}
+    if (found == sessions.end())
+        return;
 
+    found->second->input.finish();
+    run(*found->second, false);
+}
 
-// --------------------- Display / Output ---------------------
-void nutritionTracker::displayIntroBanner()
+void sessionMultiplexer::takeOutput(int session, string& output)
 {
-    setConsoleColor(COLOR_HEADER);
-    printSectionBreakLine();
+    auto found = sessions.find(session);
 
-    cout << left << setw(5) << " "
-        << " Welcome to the Vegetarian Nutrition for Weightlifters Program! "
-        << right << setw(5) << " " << "\n";
+    if (found == sessions.end())
+        return;
 
-    printSectionBreakLine();
-    cout << "\nLet's learn more about you!\n\n";
+    stringbuf& printed = found->second->output;
+    output.append(printed.view());
+    printed.str(string());
+}
 
-    setConsoleColor(COLOR_DEFAULT);
+bool sessionMultiplexer::isDone(int session) const
+{
+    auto found = sessions.find(session);
+    return found == sessions.end() || found->second->task.done();
 }
 
-void nutritionTracker::displayMenu() const
+size_t sessionMultiplexer::getUnreadBytes(int session) const
 {
-    setConsoleColor(COLOR_HEADER);
-    printSectionBreakLine();
-    cout << "1. View Daily Macro Targets\n"
-        << "2. Generate Full Nutrition Report\n"
-        << "3. Nutrition Check & Recipe Unlock\n"
-        << "4. View Weekly Calorie Log\n"
-        << "5. View Weekly Nutrition Sessions\n"
-        << "6. View Macros Per Meal (2D Table)\n"   // New menu option
-        << "7. Start a New User Session\n"
-        << "8. Exit Program\n\n";
-    setConsoleColor(COLOR_DEFAULT);
+    auto found = sessions.find(session);
+    return (found == sessions.end()) ? 0 : found->second->input.getUnreadBytes();
 }
 
-void nutritionTracker::displayDailyMacros() const
+void sessionMultiplexer::close(int session)
 {
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    cout << "You chose to view your suggested daily macros!\n\n";
-    setConsoleColor(COLOR_DEFAULT);
+    sessions.erase(session);   // A session still waiting for input is destroyed mid-prompt
+}
 
-    cout << "Here is the information you provided:\n";
-    cout << left << setw(50) << setfill('.') << "Favorite protein source: " << right << favoriteProtein << "\n";
-    cout << left << setw(50) << setfill('.') << "Daily calorie target: " << right << dailyCalories << "\n";
-    cout << left << setw(50) << setfill('.') << "Meals per day: " << right << mealsPerDay << "\n";
-    cout << left << setw(50) << setfill('.') << "Weekly workout hours: " << right << weeklyWorkoutHours << "\n\n";
-
-    cout << "Suggested daily macros:\n";
-    cout << left << setw(50) << setfill('.') << "Protein: " << right << dailyProteinGrams << " grams\n";
-    cout << left << setw(50) << setfill('.') << "Carbs: " << right << dailyCarbGrams << " grams\n";
-    cout << left << setw(50) << setfill('.') << "Fats: " << right << dailyFatGrams << " grams\n\n";
-
-    cout << "Per meal macro targets:\n";
-    cout << left << setw(50) << setfill('.') << "Protein grams per meal: " << right << proteinPerMeal << "\n";
-    cout << left << setw(50) << setfill('.') << "Carbs grams per meal: " << right << carbsPerMeal << "\n";
-    cout << left << setw(50) << setfill('.') << "Fats grams per meal: " << right << fatsPerMeal << "\n";
-    cout << setfill(' ');
+size_t sessionMultiplexer::getBufferBytes() const
+{
+    size_t bytes = 0;
 
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    cout << "Keep fueling with " << favoriteProtein << " to hit " << dailyProteinGrams << " grams of protein daily!\n";
-    cout << "Remember your " << weeklyWorkoutHours << " hours of weightlifting per week...\n";
-    cout << "Keep lifting heavy, " << name << "!\n\n";
-    setConsoleColor(COLOR_DEFAULT);
+    for (const auto& entry : sessions)
+        bytes += entry.second->input.getCapacity() + entry.second->output.view().size();
+
+    return bytes;
 }
- 
-void nutritionTracker::generateReport() const
+
+void sessionMultiplexer::run(multiplexedSession& session, bool starting)
 {
-    // Abosrbed previous previous programming assignment's 
-    //    processReportGeneration function for simplification
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    cout << "You chose to generate a report of your suggested " << "daily and weekly macros!\n";
-    cout << "Open 'report.txt' to view, save, or print it.\n\n";
-    printSectionBreakLine();
-    setConsoleColor(COLOR_DEFAULT);
+    if (session.task.done())
+        return;
 
+    // cout is this session's output, with its own flags, until it waits again
+    consoleFormat.copyfmt(cout);
+    streambuf* console = cout.rdbuf(&session.output);
+    cout.copyfmt(session.format);
 
-    // File writing
-    ofstream outFile("report.txt");
+    if (starting)
+        session.task.start();
+    else
+        session.input.resume();
 
-    if (!outFile)
-    {
-        setConsoleColor(COLOR_ERROR);
-        cout << "Error: Unable to open report.txt\n";
-        setConsoleColor(COLOR_DEFAULT);
-        return;
-    }
+    session.format.copyfmt(cout);
+    cout.copyfmt(consoleFormat);
+    cout.rdbuf(console);
 
-    // Calculate macro calories per day for the report
-    int dailyProteinCalories = dailyProteinGrams * CALORIES_PER_GRAM_PROTEIN;
-    int dailyCarbCalories = dailyCarbGrams * CALORIES_PER_GRAM_CARBS;
-    int dailyFatCalories = dailyFatGrams * CALORIES_PER_GRAM_FAT;
+    // A session that ended with an exception says why, to its user and the server log
+    if (session.task.done())
+    {
+        try
+        {
+            session.task.checkFailure();
+        }
+        catch (const exception& error)
+        {
+            cerr << "Warning: A menu session ended with an error: " << error.what() << "\n";
 
-    // Report header
-    outFile << setfill('*') << setw(CONSOLE_WIDTH) << '*' << "\n";
-    outFile << "Vegetarian Nutrition for Weightlifters Report\n";
-    outFile << setfill('*') << setw(CONSOLE_WIDTH) << '*' << "\n\n";
-
-    outFile << "Information you provided:\n";
-    outFile << left << setw(50) << setfill('.') << "Favorite protein source: " << right << favoriteProtein << "\n";
-    outFile << left << setw(50) << setfill('.') << "Daily calorie target: " << right << dailyCalories << "\n";
-    outFile << left << setw(50) << setfill('.') << "Weekly calorie target: " << right << weeklyCalories << "\n";
-    outFile << left << setw(50) << setfill('.') << "Meals per day: " << right << mealsPerDay << "\n";
-    outFile << fixed << showpoint << setprecision(2);
-    outFile << left << setw(50) << setfill('.') << "Weekly workout hours: " << right << weeklyWorkoutHours << "\n\n";
+            string message = string("\nThis session ended with an error: ") + error.what() + "\n";
+            session.output.sputn(message.data(), static_cast<streamsize>(message.size()));
+        }
+    }
+}
 
-    // Weekly totals
-    outFile << "Suggested weekly macros:\n";
-    outFile << left << setw(50) << setfill('.') << "Protein: " << right << totalProteinGrams << " grams\n";
-    outFile << left << setw(50) << setfill('.') << "Carbs: " << right << totalCarbGrams << " grams\n";
-    outFile << left << setw(50) << setfill('.') << "Fats: " << right << totalFatGrams << " grams\n\n";
 
-    // Daily macros
-    outFile << "Suggested total daily macros:\n";
-    outFile << left << setw(50) << setfill('.') << "Protein: " << right << dailyProteinGrams << " grams (" << dailyProteinCalories << " cal)\n";
-    outFile << left << setw(50) << setfill('.') << "Carbs: " << right << dailyCarbGrams << " grams (" << dailyCarbCalories << " cal)\n";
-    outFile << left << setw(50) << setfill('.') << "Fats: " << right << dailyFatGrams << " grams (" << dailyFatCalories << " cal)\n\n";
+// --------------------- Menu Server ---------------------
+#ifdef __linux__
+// Feeds what the socket has to the connection's menu session and queues what
+//    it prints. Returns false once the peer has hung up or the socket failed.
+bool readMenuInput(serverConnection& connection, sessionMultiplexer& sessions)
+{
+    bool peerOpen = true;
 
-    // Per-meal macros
-    outFile << "Per meal macro targets:\n";
-    outFile << left << setw(50) << setfill('.') << "Protein grams per meal: " << right << proteinPerMeal << "\n";
-    outFile << left << setw(50) << setfill('.') << "Carbs grams per meal: " << right << carbsPerMeal << "\n";
-    outFile << left << setw(50) << setfill('.') << "Fats grams per meal:  " << right << fatsPerMeal << "\n\n";
+    while (connection.output.size() - connection.outputStart < SERVER_MAX_PENDING_OUTPUT && !connection.closing)
+    {
+        connection.input.resize(SERVER_READ_BYTES);
+        ssize_t received = recv(connection.socket, &connection.input[0], SERVER_READ_BYTES, 0);
 
-    outFile << setfill('*') << setw(CONSOLE_WIDTH) << '*' << "\n";
-    outFile << "Keep fueling with " << favoriteProtein << " to hit " << dailyProteinGrams << " grams of protein daily!\n";
-    outFile << "Remember your " << weeklyWorkoutHours << " hours of weightlifting per week...\n";
-    outFile << "Keep lifting heavy, " << name << "!\n\n";
+        if (received == 0)
+        {
+            peerOpen = false;
+            break;
+        }
 
-    outFile.close();
+        if (received < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            peerOpen = (errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+        }
 
-    // Confirm report generation in console using green success message
-    setConsoleColor(COLOR_SUB_HEADING);
-    cout << "Report successfully generated: report.txt\n\n";
-    setConsoleColor(COLOR_DEFAULT);
-}
+        sessions.feed(connection.menuSession, string_view(connection.input.data(), received));
+        sessions.takeOutput(connection.menuSession, connection.output);
+        connection.closing = sessions.isDone(connection.menuSession);
 
-void nutritionTracker::displayWeeklyCalorieLog() const
-{
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    cout << "Your Weekly Calorie Log:\n\n";
-    setConsoleColor(COLOR_DEFAULT);
+        // A line that never ends would grow the session's input without limit
+        if (sessions.getUnreadBytes(connection.menuSession) > SERVER_MAX_LINE)
+        {
+            connection.output += "\nThat line is too long. Closing the connection.\n";
+            connection.closing = true;
+        }
+    }
 
-    if (dailyCaloriesLog[0] == 0)
+    // Hung up mid-session: it ends the way the console does at end of input
+    if (!peerOpen && !sessions.isDone(connection.menuSession))
     {
-        cout << "No calorie data entered yet.\n";
-        return;
+        sessions.finish(connection.menuSession);
+        sessions.takeOutput(connection.menuSession, connection.output);
     }
 
-    cout << left << setw(10) << "Day" << right << setw(19) << "Calories\n";
-    printSectionBreakLine();
+    connection.input.clear();
+    return peerOpen;
+}
+#endif
 
-    for (int day = 0; day < NUMBER_OF_DAYS; ++day)
-    {
-        cout << left << setw(10) << (day + 1) << right << setw(15) << dailyCaloriesLog[day] << endl;
-    }
+int runMenuServer(const string& socketPath)
+{
+#ifdef __linux__
+    int listener = openServerListener(socketPath);
+
+    if (listener < 0)
+        return 1;
+
+    int epollHandle = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN;
+    listenEvent.data.ptr = nullptr;   // nullptr marks the listening socket
+    epoll_ctl(epollHandle, EPOLL_CTL_ADD, listener, &listenEvent);
+
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+
+    // Users saved with menu option 7 stay until the server stops; nothing is journaled
+    sessionStore users;
+    sessionMultiplexer sessions(users);
+    unordered_map<int, unique_ptr<serverConnection>> connections;
+    epoll_event events[SERVER_MAX_EVENTS];
+    long long acceptedCount = 0;
+    size_t peakSessions = 0;
+
+    cout << "Serving menus on " << socketPath << " (Ctrl+C to stop)\n";
+    cout.flush();
+
+    // Sends what is queued, then closes the connection or updates what epoll waits for
+    auto serviceConnection = [&](serverConnection& connection, bool open)
+        {
+            bool flushed = flushServerOutput(connection);
+            bool pending = connection.outputStart < connection.output.size();
 
-    cout << endl << endl;
+            if (!flushed || (!open && !pending) || (connection.closing && !pending))
+            {
+                epoll_ctl(epollHandle, EPOLL_CTL_DEL, connection.socket, nullptr);
+                close(connection.socket);
+                sessions.close(connection.menuSession);
+                connections.erase(connection.socket);
+                return;
+            }
 
-    double averageCalories = calculateAverageCalories();
-    int highestCalories = findHighestCalories();
+            uint32_t wanted = (pending ? EPOLLOUT : 0u) |
+                (open && !connection.closing && connection.output.size() < SERVER_MAX_PENDING_OUTPUT ? EPOLLIN : 0u);
 
-    cout << "Average daily calories this week: " << static_cast<int>(averageCalories) << "\n";
-    cout << "Highest daily calories this week: " << highestCalories << "\n\n";
+            if (wanted != connection.events)
+            {
+                connection.events = wanted;
+                epoll_event clientEvent{};
+                clientEvent.events = wanted;
+                clientEvent.data.ptr = &connection;
+                epoll_ctl(epollHandle, EPOLL_CTL_MOD, connection.socket, &clientEvent);
+            }
+        };
 
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    setConsoleColor(COLOR_DEFAULT);
-    cout << endl;
+    while (!serverStopping)
+    {
+        int ready = epoll_wait(epollHandle, events, SERVER_MAX_EVENTS, -1);
 
-}
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            cerr << "Error: epoll_wait failed: " << strerror(errno) << "\n";
+            break;
+        }
 
-void nutritionTracker::displayWeeklySessions() const
-{
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    cout << "Your Weekly Nutrition Summary:\n\n";
-    setConsoleColor(COLOR_DEFAULT);
+        for (int i = 0; i < ready; i++)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                int client;
+                while ((client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    auto connection = make_unique<serverConnection>();
+                    serverConnection& accepted = *connection;
+                    accepted.socket = client;
+                    accepted.events = EPOLLIN;
+
+                    epoll_event clientEvent{};
+                    clientEvent.events = accepted.events;
+                    clientEvent.data.ptr = &accepted;
+                    epoll_ctl(epollHandle, EPOLL_CTL_ADD, client, &clientEvent);
+
+                    connections.emplace(client, move(connection));
+                    acceptedCount++;
+
+                    // The banner and first prompt go out right away
+                    accepted.menuSession = sessions.open();
+                    sessions.takeOutput(accepted.menuSession, accepted.output);
+                    peakSessions = max(peakSessions, sessions.size());
+                    serviceConnection(accepted, true);
+                }
+                continue;
+            }
 
-    cout << left << setw(10) << "Day"
-        << setw(12) << "Calories"
-        << setw(10) << "Protein"
-        << setw(10) << "Carbs"
-        << setw(10) << "Fats"
-        << setw(15) << "Calorie Goal?\n";
+            serverConnection& connection = *static_cast<serverConnection*>(events[i].data.ptr);
+            bool open = true;
 
-    printSectionBreakLine();
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                open = readMenuInput(connection, sessions);
 
-    for (int i = 0; i < NUMBER_OF_DAYS; i++)
+            serviceConnection(connection, open);
+        }
+    }
+
+    for (auto& entry : connections)
     {
-        cout << left << setw(10) << weeklySessions[i].date
-            << setw(12) << weeklySessions[i].calories
-            << setw(10) << weeklySessions[i].protein
-            << setw(10) << weeklySessions[i].carbs
-            << setw(10) << weeklySessions[i].fats
-            << setw(15) << (weeklySessions[i].metCalorieGoal ? "Yes" : "No")   // If bool is true, returns yes, otherwise returns No
-            << endl;
+        close(entry.first);
+        sessions.close(entry.second->menuSession);
     }
 
-    cout << endl;
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    setConsoleColor(COLOR_DEFAULT);
-    cout << endl;
+    close(epollHandle);
+    close(listener);
+    unlink(socketPath.c_str());
+
+    cout << "\nMenu server stopped: " << acceptedCount << " connections, " << peakSessions
+        << " sessions at once, " << users.size() << " users saved\n";
+    return 0;
+#else
+    cerr << "Error: Menu server mode (" << socketPath << ") needs Linux (epoll)\n";
+    return 1;
+#endif
 }
 
-void nutritionTracker::displayNutritionCheckAndRecipe() const
+
+// --------------------- Multiplexer Benchmark ---------------------
+void runMultiplexBenchmark(vector<benchmarkResult>& results)
 {
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    cout << "Checking your calorie intake vs activity level...\n\n";
-    setConsoleColor(COLOR_DEFAULT);
+    sessionStore users;
+    sessionMultiplexer sessions(users);
+    vector<int> parked;
+    string output;
+    mt19937 random(2530);
 
-    // Calories vs. activity and goal guidance
-    evaluateNutrition();
+    parked.reserve(MULTIPLEX_BENCH_SESSIONS);
 
-    // Calculate meals per week before evaluating meal frequency
-    int mealsPerWeek = mealsPerDay * NUMBER_OF_DAYS;
-    evaluateMealFrequency(mealsPerWeek);
+    long long framesBefore = sessionFrameBytes.load(memory_order_relaxed);
+#ifdef TRACKER_HAS_MALLINFO
+    size_t heapBefore = mallinfo2().uordblks;
+#endif
 
-    // Display recipe
-    displaySmoothieRecipe();
-}
+    // Each session enters its profile and week, then waits at the menu
+    for (size_t i = 0; i < MULTIPLEX_BENCH_SESSIONS; i++)
+    {
+        string answers = "Idle user " + to_string(i) + "\ntofu\n" + to_string(1500 + random() % 2000) + "\n" +
+            to_string(2 + random() % 5) + "\n5.5\n" + to_string(1 + random() % 3) + "\n";
 
-// New function to display menu option 4 (2D array of per meal macros)
-void nutritionTracker::displayMacrosPerMeal2D() const
-{
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    cout << "Per-Meal Macros by Day (grams per meal)\n\n";
-    cout << "All values below represent how your daily macros are\n";
-    cout << "distributed evenly across each meal.\n\n";
-    setConsoleColor(COLOR_DEFAULT);
+        for (int day = 0; day < NUMBER_OF_DAYS; day++)
+            answers += to_string(1200 + random() % 2500) + "\n";
 
-    // ----- Header Row -----
-    cout << left << setw(10) << "Macro";
-    for (int day = 1; day <= NUMBER_OF_DAYS; day++)
-        cout << setw(8) << day;
-    cout << endl;
+        int session = sessions.open();
+        sessions.feed(session, answers);
+        output.clear();
+        sessions.takeOutput(session, output);
+        parked.push_back(session);
+    }
 
-    printSectionBreakLine();
+    double frameBytes = static_cast<double>(sessionFrameBytes.load(memory_order_relaxed) - framesBefore) /
+        MULTIPLEX_BENCH_SESSIONS;
+    double bufferBytes = static_cast<double>(sessions.getBufferBytes()) / MULTIPLEX_BENCH_SESSIONS;
+#ifdef TRACKER_HAS_MALLINFO
+    double heapBytes = static_cast<double>(mallinfo2().uordblks - heapBefore) / MULTIPLEX_BENCH_SESSIONS;
+#endif
 
-    // ----- Protein Row -----
-    cout << left << setw(10) << "Protein";
-    for (int day = 0; day < NUMBER_OF_DAYS; day++)
-        cout << setw(8) << macrosPerMeal2D[0][day];
-    cout << endl;
+    // Wake-up: a menu choice arrives for one idle session, which runs to its next prompt
+    shuffle(parked.begin(), parked.end(), random);
+    vector<long long> wakeNs;
+    wakeNs.reserve(parked.size());
+    long long allocationsBefore = getAllocationCount();
 
-    // ----- Carb Row -----
-    cout << left << setw(10) << "Carbs";
-    for (int day = 0; day < NUMBER_OF_DAYS; day++)
-        cout << setw(8) << macrosPerMeal2D[1][day];
-    cout << endl;
+    for (int session : parked)
+    {
+        auto startTime = chrono::steady_clock::now();
+        sessions.feed(session, "4\n");
+        wakeNs.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startTime).count());
 
-    // ----- Fat Row -----
-    cout << left << setw(10) << "Fats";
-    for (int day = 0; day < NUMBER_OF_DAYS; day++)
-        cout << setw(8) << macrosPerMeal2D[2][day];
-    cout << endl << endl;
+        output.clear();
+        sessions.takeOutput(session, output);
+    }
 
-    // ----- Goal-Based Messaging Using Enum -----
-    switch (goal)
-    {
-    case FAT_LOSS:
-        cout << "Fat Loss Tip: Keep protein consistent at each meal\n";
-        cout << "to support muscle retention while in a calorie deficit.\n";
-        break;
+    double allocationsPerOp = getAllocationsPerOp(allocationsBefore, static_cast<double>(wakeNs.size()));
+    sort(wakeNs.begin(), wakeNs.end());
 
-    case MAINTENANCE:
-        cout << "Maintenance Tip: These balanced macros support steady\n";
-        cout << "energy and recovery throughout the week.\n";
-        break;
+    double totalNs = 0.0;
+    for (long long ns : wakeNs)
+        totalNs += static_cast<double>(ns);
 
-    case MUSCLE_GAIN:
-        cout << "Muscle Gain Tip: Try placing higher-carb meals around\n";
-        cout << "your workouts to support strength and recovery.\n";
-        break;
-    }
+    benchmarkResult result;
+    result.name = "multiplexed session wake-up";
+    result.dataSize = MULTIPLEX_BENCH_SESSIONS;
+    result.nsPerOp = totalNs / wakeNs.size();
+    result.itemsPerSecond = 1e9 / result.nsPerOp;
+    result.allocationsPerOp = allocationsPerOp;
+    printBenchmarkResult(result);
+    results.push_back(result);
 
-    cout << "\nBased on " << mealsPerDay << " meals per day.\n\n";
+    auto percentile = [&](double fraction)
+        {
+            return wakeNs[min(wakeNs.size() - 1, static_cast<size_t>(fraction * wakeNs.size()))] / 1e3;
+        };
+
+    cout << "Idle sessions parked at the menu (" << MULTIPLEX_BENCH_SESSIONS << "): " << fixed << setprecision(0)
+        << frameBytes << " bytes of coroutine frames and " << bufferBytes << " bytes of buffers each";
+#ifdef TRACKER_HAS_MALLINFO
+    cout << ", " << heapBytes << " bytes of heap each in all";
+#endif
+    cout << "\nWake-up to the next prompt (us): p50 " << setprecision(2) << percentile(0.50) << ", p99 "
+        << percentile(0.99) << ", max " << wakeNs.back() / 1e3 << "\n";
+
+    // Closing them mid-prompt must free every frame
+    for (int session : parked)
+        sessions.close(session);
+
+    if (sessionFrameBytes.load(memory_order_relaxed) != framesBefore)
+        cerr << "Warning: closed sessions left " << sessionFrameBytes.load(memory_order_relaxed) - framesBefore
+            << " bytes of coroutine frames\n";
 }
-
-void nutritionTracker::displaySmoothieRecipe() const
-{
-    setConsoleColor(COLOR_RECIPE);
-    cout << "Oatmeal Smoothie Recipe:\n"
-        << "- 1/4 cup rolled oats\n"
-        << "- 2 tbsp cocoa powder\n"
-        << "- 1/4 cup protein powder\n"
-        << "- 1 tbsp maple syrup\n"
-        << "- 1 tbsp chia seeds\n"
-        << "- 1 tbsp peanut butter\n"
-        << "- 3/4 cup almond milk\n\n"
-        << "Blend all ingredients until smooth.\n"
-        << "Protein: 30g | Carbs: 37g | Fat: 13g\n\n";
-    setConsoleColor(COLOR_SUB_HEADING);
-    printSectionBreakLine();
-    setConsoleColor(COLOR_DEFAULT);
-    cout << endl;
-}
\ No newline at end of file